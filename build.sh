@@ -1 +1,25 @@
-gcc -Wall -Wextra -std=c11 -g -I./raylib/include -L./raylib/lib ./src/main.c ./src/block.c -o main -lraylib -lgdi32 -lwinmm
\ No newline at end of file
+gcc -Wall -Wextra -std=c11 -g -I./raylib/include -L./raylib/lib ./src/main.c ./src/game.c ./src/block.c ./src/undo.c ./src/wide.c ./src/plugin.c ./src/save.c ./src/scores.c ./src/metrics.c ./src/fileio.c ./src/input_latency.c -o main -lraylib -lgdi32 -lwinmm -lpthread
+
+# headless tools, posix only
+TOOL_FLAGS="-Wall -Wextra -std=c11 -O2 -g -DRAYMATH_STATIC_INLINE -I./raylib/include -I./src"
+ENGINE_SRC="./src/game.c ./src/block.c ./src/search.c ./src/vecenv.c ./src/parallel.c ./src/replay.c ./src/batch.c ./src/obs.c ./src/shm.c ./src/board_features.c ./src/survive.c ./src/policy.c ./src/survival.c ./src/book.c ./src/retro.c ./src/wide.c ./src/block_gen.c ./src/tournament.c ./src/plugin.c ./src/server.c ./src/spectate.c ./src/save.c ./src/scores.c ./src/metrics.c ./src/fileio.c"
+gcc $TOOL_FLAGS ./src/tools/simulate.c $ENGINE_SRC -o simulate -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/analyze.c $ENGINE_SRC -o analyze -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/bench_vecenv.c $ENGINE_SRC -o bench_vecenv -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/bench_batch.c $ENGINE_SRC -o bench_batch -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/bench_features.c $ENGINE_SRC -o bench_features -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/bench_survive.c $ENGINE_SRC -o bench_survive -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/survival.c $ENGINE_SRC -o survival -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/book_gen.c $ENGINE_SRC -o book_gen -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/retro.c $ENGINE_SRC -o retro -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/tournament.c $ENGINE_SRC -o tournament -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/serve.c $ENGINE_SRC -o serve -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/load_gen.c $ENGINE_SRC -o load_gen -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/spectate.c $ENGINE_SRC -o spectate -lpthread -lm -ldl
+gcc $TOOL_FLAGS ./src/tools/scores.c $ENGINE_SRC -o scores -lpthread -lm -ldl
+
+# python extension over the batched environment, import blockenv
+gcc $TOOL_FLAGS -shared -fPIC $(python3-config --includes) ./src/python/blockenv.c $ENGINE_SRC -o blockenv$(python3-config --extension-suffix) -lpthread -lm -ldl
+
+# example policy plugin, tournament plugin:./greedy_policy.so,random
+gcc $TOOL_FLAGS -shared -fPIC ./src/plugins/greedy_policy.c -o greedy_policy.so
@@ -0,0 +1,493 @@
+#define _GNU_SOURCE
+#include "batch.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "rng.h"
+#include "timing.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+#define KERNEL_MASK_COLS (BLOCK_CELLS_MAX + 1)
+#define PACKED_BLOCKS_N 128
+// init_batch_kernels times every level of a kernel on this many boards,
+// keeping the fastest of the rounds, about 2ms in all
+#define CALIBRATION_BOARDS_N 1024
+#define CALIBRATION_ROUNDS_N 16
+
+// per packed block: legal origins on an empty field, then the offsets of
+// its cells padded with the first one, so every block takes the same
+// amount of shifts. empty blocks have no origins
+static uint64_t kernel_masks[PACKED_BLOCKS_N][KERNEL_MASK_COLS];
+
+typedef void (*PlacementFreeFn)(const Board*, const Board*, uint8_t*, int);
+typedef void (*ClearLinesFn)(Board*, uint8_t*, int);
+typedef void (*GameOverFn)(const Board*, const PackedBlock*, uint8_t*, int);
+
+static PlacementFreeFn placement_free_fn;
+static ClearLinesFn clear_lines_fn;
+static GameOverFn game_over_fn;
+
+// scalar kernels
+
+static void placement_free_scalar(const Board* boards, const Board* placed,
+                                  uint8_t* free_out, int n) {
+    for (int i = 0; i < n; ++i) {
+        free_out[i] = (boards[i] & placed[i]) == 0;
+    }
+}
+
+static void clear_lines_scalar(Board* boards, uint8_t* lines_out, int n) {
+    for (int i = 0; i < n; ++i) {
+        unsigned rows = board_full_rows(boards[i]);
+        unsigned cols = board_full_cols(boards[i]);
+        lines_out[i] = board_popcount(rows) + board_popcount(cols);
+        boards[i] &= ~board_lines_cells(rows, cols);
+    }
+}
+
+static inline Board get_kernel_legal_origins(Board board, PackedBlock block) {
+    const uint64_t* mask = kernel_masks[block & (PACKED_BLOCKS_N - 1)];
+    Board legal = mask[0];
+    for (int k = 1; k < KERNEL_MASK_COLS; ++k) legal &= ~(board >> mask[k]);
+    return legal;
+}
+
+static void game_over_scalar(const Board* boards,
+                             const PackedBlock* held_blocks, uint8_t* over_out,
+                             int n) {
+    for (int i = 0; i < n; ++i) {
+        const PackedBlock* held = &held_blocks[i * HELD_BLOCKS_N];
+        Board legal = 0;
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            legal |= get_kernel_legal_origins(boards[i], held[slot]);
+        }
+        over_out[i] = legal == 0;
+    }
+}
+
+#if BATCH_X86
+
+// avx2 kernels, 4 boards per register
+
+__attribute__((target("avx2"))) static inline __m256i popcount_bytes_avx2(
+    __m256i v) {
+    const __m256i lookup =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_nibbles);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                           _mm256_shuffle_epi8(lookup, hi));
+}
+
+__attribute__((target("avx2"))) static void placement_free_avx2(
+    const Board* boards, const Board* placed, uint8_t* free_out, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(boards + i));
+        __m256i p = _mm256_loadu_si256((const __m256i*)(placed + i));
+        __m256i free = _mm256_cmpeq_epi64(_mm256_and_si256(b, p),
+                                          _mm256_setzero_si256());
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(free));
+        for (int k = 0; k < 4; ++k) free_out[i + k] = (bits >> k) & 1;
+    }
+    placement_free_scalar(boards + i, placed + i, free_out + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void clear_lines_avx2(
+    Board* boards, uint8_t* lines_out, int n) {
+    const __m256i col_0 = _mm256_set1_epi64x(BOARD_COL_0);
+    const __m256i row_0 = _mm256_set1_epi64x(BOARD_ROW_0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(boards + i));
+
+        // same folds as board_full_rows/board_full_cols, left in place
+        __m256i rows = _mm256_and_si256(b, _mm256_srli_epi64(b, 4));
+        rows = _mm256_and_si256(rows, _mm256_srli_epi64(rows, 2));
+        rows = _mm256_and_si256(rows, _mm256_srli_epi64(rows, 1));
+        rows = _mm256_and_si256(rows, col_0);
+        __m256i cols = _mm256_and_si256(b, _mm256_srli_epi64(b, 32));
+        cols = _mm256_and_si256(cols, _mm256_srli_epi64(cols, 16));
+        cols = _mm256_and_si256(cols, _mm256_srli_epi64(cols, 8));
+        cols = _mm256_and_si256(cols, row_0);
+
+        __m256i cells = _mm256_or_si256(rows, _mm256_slli_epi64(rows, 1));
+        cells = _mm256_or_si256(cells, _mm256_slli_epi64(cells, 2));
+        cells = _mm256_or_si256(cells, _mm256_slli_epi64(cells, 4));
+        __m256i col_cells = _mm256_or_si256(cols, _mm256_slli_epi64(cols, 8));
+        col_cells =
+            _mm256_or_si256(col_cells, _mm256_slli_epi64(col_cells, 16));
+        col_cells =
+            _mm256_or_si256(col_cells, _mm256_slli_epi64(col_cells, 32));
+        cells = _mm256_or_si256(cells, col_cells);
+        _mm256_storeu_si256((__m256i*)(boards + i),
+                            _mm256_andnot_si256(cells, b));
+
+        __m256i counts = _mm256_sad_epu8(
+            _mm256_add_epi8(popcount_bytes_avx2(rows),
+                            popcount_bytes_avx2(cols)),
+            _mm256_setzero_si256());
+        uint64_t lines[4];
+        _mm256_storeu_si256((__m256i*)lines, counts);
+        for (int k = 0; k < 4; ++k) lines_out[i + k] = lines[k];
+    }
+    clear_lines_scalar(boards + i, lines_out + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void game_over_avx2(
+    const Board* boards, const PackedBlock* held_blocks, uint8_t* over_out,
+    int n) {
+    const long long* masks = (const long long*)kernel_masks;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(boards + i));
+        const PackedBlock* held = &held_blocks[i * HELD_BLOCKS_N];
+        __m256i any = _mm256_setzero_si256();
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            __m128i rows = _mm_setr_epi32(
+                held[slot] & (PACKED_BLOCKS_N - 1),
+                held[HELD_BLOCKS_N + slot] & (PACKED_BLOCKS_N - 1),
+                held[2 * HELD_BLOCKS_N + slot] & (PACKED_BLOCKS_N - 1),
+                held[3 * HELD_BLOCKS_N + slot] & (PACKED_BLOCKS_N - 1));
+            __m128i idx =
+                _mm_mullo_epi32(rows, _mm_set1_epi32(KERNEL_MASK_COLS));
+            __m256i legal = _mm256_i32gather_epi64(masks, idx, 8);
+            for (int k = 1; k < KERNEL_MASK_COLS; ++k) {
+                __m256i offsets = _mm256_i32gather_epi64(masks + k, idx, 8);
+                legal = _mm256_andnot_si256(_mm256_srlv_epi64(b, offsets),
+                                            legal);
+            }
+            any = _mm256_or_si256(any, legal);
+        }
+        __m256i over = _mm256_cmpeq_epi64(any, _mm256_setzero_si256());
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(over));
+        for (int k = 0; k < 4; ++k) over_out[i + k] = (bits >> k) & 1;
+    }
+    game_over_scalar(boards + i, held_blocks + i * HELD_BLOCKS_N,
+                     over_out + i, n - i);
+}
+
+// avx-512 kernels, 8 boards per register
+
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw")))
+
+AVX512_TARGET static inline __m512i popcount_bytes_avx512(__m512i v) {
+    const __m512i lookup = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low_nibbles = _mm512_set1_epi8(0x0f);
+    __m512i lo = _mm512_and_si512(v, low_nibbles);
+    __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_nibbles);
+    return _mm512_add_epi8(_mm512_shuffle_epi8(lookup, lo),
+                           _mm512_shuffle_epi8(lookup, hi));
+}
+
+AVX512_TARGET static void placement_free_avx512(const Board* boards,
+                                                const Board* placed,
+                                                uint8_t* free_out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i b = _mm512_loadu_si512(boards + i);
+        __m512i p = _mm512_loadu_si512(placed + i);
+        __mmask8 overlap = _mm512_test_epi64_mask(b, p);
+        for (int k = 0; k < 8; ++k) free_out[i + k] = !((overlap >> k) & 1);
+    }
+    placement_free_scalar(boards + i, placed + i, free_out + i, n - i);
+}
+
+AVX512_TARGET static void clear_lines_avx512(Board* boards,
+                                             uint8_t* lines_out, int n) {
+    const __m512i col_0 = _mm512_set1_epi64(BOARD_COL_0);
+    const __m512i row_0 = _mm512_set1_epi64(BOARD_ROW_0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i b = _mm512_loadu_si512(boards + i);
+
+        __m512i rows = _mm512_and_si512(b, _mm512_srli_epi64(b, 4));
+        rows = _mm512_and_si512(rows, _mm512_srli_epi64(rows, 2));
+        rows = _mm512_and_si512(rows, _mm512_srli_epi64(rows, 1));
+        rows = _mm512_and_si512(rows, col_0);
+        __m512i cols = _mm512_and_si512(b, _mm512_srli_epi64(b, 32));
+        cols = _mm512_and_si512(cols, _mm512_srli_epi64(cols, 16));
+        cols = _mm512_and_si512(cols, _mm512_srli_epi64(cols, 8));
+        cols = _mm512_and_si512(cols, row_0);
+
+        __m512i cells = _mm512_or_si512(rows, _mm512_slli_epi64(rows, 1));
+        cells = _mm512_or_si512(cells, _mm512_slli_epi64(cells, 2));
+        cells = _mm512_or_si512(cells, _mm512_slli_epi64(cells, 4));
+        __m512i col_cells = _mm512_or_si512(cols, _mm512_slli_epi64(cols, 8));
+        col_cells =
+            _mm512_or_si512(col_cells, _mm512_slli_epi64(col_cells, 16));
+        col_cells =
+            _mm512_or_si512(col_cells, _mm512_slli_epi64(col_cells, 32));
+        cells = _mm512_or_si512(cells, col_cells);
+        _mm512_storeu_si512(boards + i, _mm512_andnot_si512(cells, b));
+
+        __m512i counts = _mm512_sad_epu8(
+            _mm512_add_epi8(popcount_bytes_avx512(rows),
+                            popcount_bytes_avx512(cols)),
+            _mm512_setzero_si512());
+        _mm_storel_epi64((__m128i*)(lines_out + i),
+                         _mm512_cvtepi64_epi8(counts));
+    }
+    clear_lines_scalar(boards + i, lines_out + i, n - i);
+}
+
+AVX512_TARGET static void game_over_avx512(const Board* boards,
+                                           const PackedBlock* held_blocks,
+                                           uint8_t* over_out, int n) {
+    const long long* masks = (const long long*)kernel_masks;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i b = _mm512_loadu_si512(boards + i);
+        const PackedBlock* held = &held_blocks[i * HELD_BLOCKS_N];
+        __m512i any = _mm512_setzero_si512();
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            int rows[8];
+            for (int k = 0; k < 8; ++k) {
+                rows[k] = (held[k * HELD_BLOCKS_N + slot] &
+                           (PACKED_BLOCKS_N - 1)) *
+                          KERNEL_MASK_COLS;
+            }
+            __m256i idx = _mm256_loadu_si256((const __m256i*)rows);
+            __m512i legal = _mm512_i32gather_epi64(idx, masks, 8);
+            for (int k = 1; k < KERNEL_MASK_COLS; ++k) {
+                __m512i offsets = _mm512_i32gather_epi64(idx, masks + k, 8);
+                legal = _mm512_andnot_si512(_mm512_srlv_epi64(b, offsets),
+                                            legal);
+            }
+            any = _mm512_or_si512(any, legal);
+        }
+        __mmask8 fits = _mm512_test_epi64_mask(any, any);
+        for (int k = 0; k < 8; ++k) over_out[i + k] = !((fits >> k) & 1);
+    }
+    game_over_scalar(boards + i, held_blocks + i * HELD_BLOCKS_N,
+                     over_out + i, n - i);
+}
+
+#endif  // BATCH_X86
+
+static void init_kernel_masks(void) {
+    for (int packed = 0; packed < PACKED_BLOCKS_N; ++packed) {
+        uint64_t* row = kernel_masks[packed];
+        Block block = unpack_block(packed);
+        if (block.item == CELL_ITEM_EMPTY || (int)block.shape >= get_shapes_n()) {
+            for (int k = 0; k < KERNEL_MASK_COLS; ++k) row[k] = 0;
+            continue;
+        }
+        const BlockMask* mask = get_block_mask(&block);
+        row[0] = mask->origins;
+        for (int k = 0; k < BLOCK_CELLS_MAX; ++k) {
+            row[k + 1] = mask->offsets[k < mask->cells_n ? k : 0];
+        }
+    }
+}
+
+static BatchKernels kernels;
+
+static void set_placement_free_fn(BatchKernelLevel level) {
+    switch (level) {
+#if BATCH_X86
+        case BATCH_KERNEL_AVX512:
+            placement_free_fn = placement_free_avx512;
+            break;
+        case BATCH_KERNEL_AVX2:
+            placement_free_fn = placement_free_avx2;
+            break;
+#endif
+        default:
+            level = BATCH_KERNEL_SCALAR;
+            placement_free_fn = placement_free_scalar;
+            break;
+    }
+    kernels.placement_free = level;
+}
+
+static void set_clear_lines_fn(BatchKernelLevel level) {
+    switch (level) {
+#if BATCH_X86
+        case BATCH_KERNEL_AVX512:
+            clear_lines_fn = clear_lines_avx512;
+            break;
+        case BATCH_KERNEL_AVX2:
+            clear_lines_fn = clear_lines_avx2;
+            break;
+#endif
+        default:
+            level = BATCH_KERNEL_SCALAR;
+            clear_lines_fn = clear_lines_scalar;
+            break;
+    }
+    kernels.clear_lines = level;
+}
+
+static void set_game_over_fn(BatchKernelLevel level) {
+    switch (level) {
+#if BATCH_X86
+        case BATCH_KERNEL_AVX512:
+            game_over_fn = game_over_avx512;
+            break;
+        case BATCH_KERNEL_AVX2:
+            game_over_fn = game_over_avx2;
+            break;
+#endif
+        default:
+            level = BATCH_KERNEL_SCALAR;
+            game_over_fn = game_over_scalar;
+            break;
+    }
+    kernels.game_over = level;
+}
+
+static BatchKernelLevel min_level(BatchKernelLevel a, BatchKernelLevel b) {
+    return a < b ? a : b;
+}
+
+typedef struct CalibrationData {
+    Board boards[CALIBRATION_BOARDS_N];
+    Board placed[CALIBRATION_BOARDS_N];
+    Board cleared[CALIBRATION_BOARDS_N];
+    PackedBlock held_blocks[CALIBRATION_BOARDS_N * HELD_BLOCKS_N];
+    uint8_t out[CALIBRATION_BOARDS_N];
+} CalibrationData;
+
+// boards of every density with some full lines, the way bench_batch makes
+// them
+static void init_calibration_data(CalibrationData* data) {
+    Rng rng = make_rng(1);
+    for (int i = 0; i < CALIBRATION_BOARDS_N; ++i) {
+        Board board = 0;
+        int density = rng_range(&rng, 9);
+        for (int cell = 0; cell < FIELD_SIZE * FIELD_SIZE; ++cell) {
+            if (rng_range(&rng, 10) < density) board |= board_cell(cell);
+        }
+        if (rng_range(&rng, 4) == 0) {
+            board |= BOARD_ROW_0 << rng_range(&rng, FIELD_SIZE) * FIELD_SIZE;
+        }
+        data->boards[i] = board;
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            Block block = get_random_block(&rng);
+            data->held_blocks[i * HELD_BLOCKS_N + slot] = pack_block(&block);
+        }
+        Block block = get_random_block(&rng);
+        data->placed[i] = get_block_mask(&block)->cells
+                          << rng_range(&rng, 64 - 18);
+    }
+}
+
+static void run_placement_free(CalibrationData* data) {
+    placement_free_fn(data->boards, data->placed, data->out,
+                      CALIBRATION_BOARDS_N);
+}
+
+static void run_clear_lines(CalibrationData* data) {
+    memcpy(data->cleared, data->boards, sizeof(data->cleared));
+    clear_lines_fn(data->cleared, data->out, CALIBRATION_BOARDS_N);
+}
+
+static void run_game_over(CalibrationData* data) {
+    game_over_fn(data->boards, data->held_blocks, data->out,
+                 CALIBRATION_BOARDS_N);
+}
+
+// sets the kernel to the level it ran fastest at on this cpu, up to
+// max_level. a tie goes to the lower level
+static void set_fastest_fn(void (*set_fn)(BatchKernelLevel level),
+                           void (*run)(CalibrationData* data),
+                           BatchKernelLevel max_level,
+                           CalibrationData* data) {
+    BatchKernelLevel best = BATCH_KERNEL_SCALAR;
+    uint64_t best_time = UINT64_MAX;
+    for (BatchKernelLevel level = BATCH_KERNEL_SCALAR; level <= max_level;
+         ++level) {
+        set_fn(level);
+        run(data);  // warms up the caches
+        uint64_t time = UINT64_MAX;
+        for (int round = 0; round < CALIBRATION_ROUNDS_N; ++round) {
+            uint64_t start = get_time_nanoseconds();
+            run(data);
+            uint64_t elapsed = get_time_nanoseconds() - start;
+            if (elapsed < time) time = elapsed;
+        }
+        if (time < best_time) {
+            best = level;
+            best_time = time;
+        }
+    }
+    set_fn(best);
+}
+
+BatchKernelLevel init_batch_kernels(BatchKernelLevel max_level) {
+    init_kernel_masks();
+
+    BatchKernelLevel level = BATCH_KERNEL_SCALAR;
+#if BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) level = BATCH_KERNEL_AVX2;
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+        level = BATCH_KERNEL_AVX512;
+    }
+#endif
+    level = min_level(level, max_level);
+
+    static CalibrationData data;
+    init_calibration_data(&data);
+    set_fastest_fn(set_placement_free_fn, run_placement_free, level, &data);
+    set_fastest_fn(set_clear_lines_fn, run_clear_lines, level, &data);
+    set_fastest_fn(set_game_over_fn, run_game_over, level, &data);
+    return level;
+}
+
+void set_batch_kernels(BatchKernelLevel level) {
+    set_placement_free_fn(level);
+    set_clear_lines_fn(level);
+    set_game_over_fn(level);
+}
+
+void get_batch_kernels(BatchKernels* kernels_out) { *kernels_out = kernels; }
+
+size_t format_batch_kernels(char* out, size_t size) {
+    int n = snprintf(out, size, "placement %s, clear lines %s, game over %s",
+                     get_batch_kernel_name(kernels.placement_free),
+                     get_batch_kernel_name(kernels.clear_lines),
+                     get_batch_kernel_name(kernels.game_over));
+    return n > 0 ? (size_t)n : 0;
+}
+
+const char* get_batch_kernel_name(BatchKernelLevel level) {
+    switch (level) {
+        case BATCH_KERNEL_SCALAR:
+            return "scalar";
+        case BATCH_KERNEL_AVX2:
+            return "avx2";
+        case BATCH_KERNEL_AVX512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+void batch_placement_free(const Board* boards, const Board* placed,
+                          uint8_t* free_out, int n) {
+    assert(placement_free_fn && "init_batch_kernels wasn't called");
+    placement_free_fn(boards, placed, free_out, n);
+}
+
+void batch_clear_lines(Board* boards, uint8_t* lines_out, int n) {
+    assert(clear_lines_fn && "init_batch_kernels wasn't called");
+    clear_lines_fn(boards, lines_out, n);
+}
+
+void batch_game_over(const Board* boards, const PackedBlock* held_blocks,
+                     uint8_t* over_out, int n) {
+    assert(game_over_fn && "init_batch_kernels wasn't called");
+    game_over_fn(boards, held_blocks, over_out, n);
+}
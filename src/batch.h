@@ -0,0 +1,51 @@
+#if !defined(BATCH_H)
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "block.h"
+
+// the hot board operations of batched simulation, run over many boards in
+// lockstep. the kernels are picked once by init_batch_kernels among the
+// levels the cpu supports, each at the level it runs fastest at on this
+// cpu, with a scalar fallback everywhere.
+
+typedef enum BatchKernelLevel {
+    BATCH_KERNEL_SCALAR,
+    BATCH_KERNEL_AVX2,
+    BATCH_KERNEL_AVX512,
+} BatchKernelLevel;
+
+typedef struct BatchKernels {
+    BatchKernelLevel placement_free;
+    BatchKernelLevel clear_lines;
+    BatchKernelLevel game_over;
+} BatchKernels;
+
+// must be called after init_block_masks and before any batch_ function.
+// times every kernel at each level the cpu supports up to max_level, which
+// takes about 2ms, and keeps the fastest. the levels give the same results,
+// only the speed differs. returns the highest level supported up to
+// max_level
+BatchKernelLevel init_batch_kernels(BatchKernelLevel max_level);
+// every kernel at level, which the cpu must support, to compare them
+void set_batch_kernels(BatchKernelLevel level);
+void get_batch_kernels(BatchKernels* kernels_out);
+const char* get_batch_kernel_name(BatchKernelLevel level);
+// the level of each kernel, in one line
+size_t format_batch_kernels(char* out, size_t size);
+
+// free_out[i] = 1 if placed[i] doesn't overlap boards[i]
+void batch_placement_free(const Board* boards, const Board* placed,
+                          uint8_t* free_out, int n);
+// clears the full rows and columns of every board, lines_out[i] gets the
+// amount of lines cleared
+void batch_clear_lines(Board* boards, uint8_t* lines_out, int n);
+// over_out[i] = 1 if none of the HELD_BLOCKS_N blocks held for boards[i]
+// fits anywhere on it
+void batch_game_over(const Board* boards, const PackedBlock* held_blocks,
+                     uint8_t* over_out, int n);
+
+#endif  // BATCH_H
@@ -0,0 +1,102 @@
+#if !defined(BITBOARD_H)
+#define BITBOARD_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+// one bit per field cell, bit index is the field index (y * FIELD_SIZE + x)
+typedef uint64_t Board;
+
+static_assert(FIELD_SIZE == 8, "bitboards assume an 8x8 field");
+
+#define BOARD_ROW_0 ((Board)0xff)
+#define BOARD_COL_0 ((Board)0x0101010101010101)
+
+static inline Board board_cell(int index) { return (Board)1 << index; }
+
+static inline bool board_test(Board board, int index) {
+    return (board >> index) & 1;
+}
+
+static inline int board_popcount(Board board) {
+    return __builtin_popcountll(board);
+}
+
+// bit r is set if row r is full
+static inline unsigned board_full_rows(Board board) {
+    Board full = board & (board >> 4);
+    full &= full >> 2;
+    full &= full >> 1;
+    full &= BOARD_COL_0;
+    // gathers bit 8 * r into bit 56 + r
+    return (unsigned)((full * 0x0102040810204080ull) >> 56);
+}
+
+// bit c is set if column c is full
+static inline unsigned board_full_cols(Board board) {
+    Board full = board & (board >> 32);
+    full &= full >> 16;
+    full &= full >> 8;
+    return (unsigned)(full & BOARD_ROW_0);
+}
+
+// moves bit i of the byte to bit 8 * i, so byte i of the result is 0 or 1
+static inline uint64_t board_spread_byte(unsigned byte) {
+    uint64_t spread = (uint64_t)(byte & 0x7f) * 0x0002040810204081ull;
+    return (spread & BOARD_COL_0) | (uint64_t)((byte >> 7) & 1) << 56;
+}
+
+// byte i of the result is the amount of bits set in byte i of the board
+static inline uint64_t board_byte_popcounts(Board board) {
+    uint64_t x = board - ((board >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    return (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+}
+
+// swaps x and y of every cell, so rows become columns
+static inline Board board_transpose(Board board) {
+    Board t = 0x0f0f0f0f00000000ull & (board ^ (board << 28));
+    board ^= t ^ (t >> 28);
+    t = 0x3333000033330000ull & (board ^ (board << 14));
+    board ^= t ^ (t >> 14);
+    t = 0x5500550055005500ull & (board ^ (board << 7));
+    board ^= t ^ (t >> 7);
+    return board;
+}
+
+// mirrors every row, x becomes FIELD_SIZE - 1 - x
+static inline Board board_flip_x(Board board) {
+    board = (board >> 1 & 0x5555555555555555ull) |
+            (board & 0x5555555555555555ull) << 1;
+    board = (board >> 2 & 0x3333333333333333ull) |
+            (board & 0x3333333333333333ull) << 2;
+    return (board >> 4 & 0x0f0f0f0f0f0f0f0full) |
+           (board & 0x0f0f0f0f0f0f0f0full) << 4;
+}
+
+// a right angle to the right, the way a block rotation turns its cells
+static inline Board board_rotate(Board board) {
+    return board_flip_x(board_transpose(board));
+}
+
+// field index of the top left corner of the bounding box, board must not
+// be empty
+static inline int board_corner(Board board) {
+    Board cols = board | board >> 32;
+    cols |= cols >> 16;
+    cols |= cols >> 8;
+    return __builtin_ctzll(board) / FIELD_SIZE * FIELD_SIZE +
+           __builtin_ctzll(cols & BOARD_ROW_0);
+}
+
+static inline Board board_lines_cells(unsigned rows, unsigned cols) {
+    // fills the first cell of every full row along the row, and replicates
+    // the column byte into every row
+    return board_spread_byte(rows) * BOARD_ROW_0 |
+           (Board)(cols & 0xff) * BOARD_COL_0;
+}
+
+#endif  // BITBOARD_H
@@ -1,7 +1,10 @@
 #include "block.h"
 
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "constants.h"
 #include "vector_fns.h"
@@ -13,44 +16,36 @@ static const Color field_cell_item_color_lookup[] = {
     [CELL_ITEM_YELLOW] = YELLOW,
 };
 
-static const CellCoords block_shape_cell_coords_lookup[] = {
-    [BLOCK_SHAPE_2x2] = {.len = 4,
-                         .cell_coords =
-                             (Vector2[]){{-1, -1}, {0, 0}, {0, -1}, {-1, 0}}},
-    [BLOCK_SHAPE_3X3] = {.len = 9,
-                         .cell_coords = (Vector2[]){{-1.5, -1.5},
-                                                    {-1.5, -0.5},
-                                                    {-1.5, 0.5},
-                                                    {-0.5, -1.5},
-                                                    {-0.5, -0.5},
-                                                    {-0.5, 0.5},
-                                                    {0.5, -1.5},
-                                                    {0.5, -0.5},
-                                                    {0.5, 0.5}}},
-    [BLOCK_SHAPE_3X2] = {.len = 6,
-                         .cell_coords = (Vector2[]){{-0.5, 0},
-                                                    {-1.5, 0},
-                                                    {0.5, 0},
-                                                    {-0.5, -1},
-                                                    {0.5, -1},
-                                                    {-1.5, -1}}},
-    [BLOCK_SHAPE_L] =
-        {.len = 4,
-         .cell_coords =
-             // ###
-             // #
-         (Vector2[]){{-0.5, -0.5}, {0.5, -0.5}, {-1.5, -0.5}, {-1.5, 0.5}}},
-    [BLOCK_SHAPE_1X4] = {.len = 4,
-                         .cell_coords =
-                             (Vector2[]){
-                                 {-0.5, 0}, {-0.5, -1}, {-0.5, -2}, {-0.5, 1}}},
-    [BLOCK_SHAPE_1X5] = {.len = 5,
-                         .cell_coords = (Vector2[]){{-0.5, -2.5},
-                                                    {-0.5, -1.5},
-                                                    {-0.5, -0.5},
-                                                    {-0.5, 0.5},
-                                                    {-0.5, 1.5}}},
-};
+// the shapes dealt unless SHAPE_SET_ENV names another set, in BlockShape
+// order
+static const char builtin_shape_set[] =
+    "shape 2x2\n##\n##\n"
+    "shape 3x3\n###\n###\n###\n"
+    "shape 3x2\n###\n###\n"
+    "shape L\n###\n#\n"
+    "shape 1x4\n#\n#\n#\n#\n"
+    "shape 1x5\n#\n#\n#\n#\n#\n";
+
+typedef struct ShapeDef {
+    char name[SHAPE_NAME_MAX];
+    int weight;
+    BlockAlignmentType alignment;
+    int cells_n;
+    // cells of rotation 0 around the point the block is held by
+    Vector2 cell_coords[BLOCK_CELLS_MAX];
+} ShapeDef;
+
+static ShapeDef shapes[BLOCK_SHAPES_MAX];
+static int shapes_n;
+static int total_weight;
+static bool uniform_weights;
+// Vose alias table of the weights: column i keeps shape i with a chance of
+// alias_thresholds[i] / 2^32 and is shape alias_shapes[i] otherwise
+static uint64_t alias_thresholds[BLOCK_SHAPES_MAX];
+static uint8_t alias_shapes[BLOCK_SHAPES_MAX];
+
+static BlockMask block_masks[BLOCK_SHAPES_MAX][4];
+static uint64_t shape_set_hash;
 
 Vector2 get_block_cell_coord(const Block* block, int i) {
     CellCoords coords = get_shape_coords(block->shape);
@@ -60,64 +55,37 @@ Vector2 get_block_cell_coord(const Block* block, int i) {
     return Vector2Subtract(rot, (Vector2){0.5, 0.5});
 }
 
-bool placed_block_space_free(const FieldCellItem* field, Vector2 coords,
-                             const Block* block) {
-    CellCoords cell_coords = get_shape_coords(block->shape);
-    for (int i = 0; i < cell_coords.len; ++i) {
-        Vector2 cell_pos = Vector2Add(coords, get_block_cell_coord(block, i));
-        
-        if (!vector_in_field_bounds(cell_pos) ||
-            field[vector_field_index(cell_pos)] != CELL_ITEM_EMPTY) {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool placed_block_fits_in_field(Vector2 coords, const Block* block) {
-    CellCoords cell_coords = get_shape_coords(block->shape);
-    for (int i = 0; i < cell_coords.len; ++i) {
-        Vector2 cell_pos = Vector2Add(coords, get_block_cell_coord(block, i));
-        if (!vector_in_field_bounds(cell_pos)) return false;
-    }
-    return true;
+BlockAlignmentType get_block_alignment(const Block* block) {
+    assert((int)block->shape < shapes_n);
+    return shapes[block->shape].alignment;
 }
 
-BlockAlignmentType get_block_alignment(const Block* block) {
-    switch (block->shape) {
-        case BLOCK_SHAPE_2x2:
-            return BLOCK_ALIGNMENT_TYPE_CORNER;
-        case BLOCK_SHAPE_3X3:
-            return BLOCK_ALIGNMENT_TYPE_MIDDLE;
-        case BLOCK_SHAPE_3X2:
-            return BLOCK_ALIGNMENT_TYPE_EDGE;
-        case BLOCK_SHAPE_L:
-            return BLOCK_ALIGNMENT_TYPE_MIDDLE;
-        case BLOCK_SHAPE_1X4:
-            return BLOCK_ALIGNMENT_TYPE_EDGE;
-        case BLOCK_SHAPE_1X5:
-            return BLOCK_ALIGNMENT_TYPE_MIDDLE;
-        case BLOCK_SHAPES_N:
-    }
-    assert(0 && "unreachable");
-}
-
-Vector2 clamp_block_pos_to_field(Vector2 coords, const Block* block) {
+Vector2 clamp_block_pos_to_sized_field(Vector2 coords, const Block* block,
+                                       int size) {
     CellCoords cell_coords = get_shape_coords(block->shape);
     for (int i = 0; i < cell_coords.len; ++i) {
         Vector2 cell_pos = Vector2Add(coords, get_block_cell_coord(block, i));
         if (cell_pos.x < 0)
             coords.x += -cell_pos.x;
-        else if (cell_pos.x > (FIELD_SIZE - 1))
-            coords.x -= cell_pos.x - (FIELD_SIZE - 1);
+        else if (cell_pos.x > (size - 1))
+            coords.x -= cell_pos.x - (size - 1);
         if (cell_pos.y < 0)
             coords.y += -cell_pos.y;
-        else if (cell_pos.y > (FIELD_SIZE - 1))
-            coords.y -= cell_pos.y - (FIELD_SIZE - 1);
+        else if (cell_pos.y > (size - 1))
+            coords.y -= cell_pos.y - (size - 1);
     }
     return coords;
 }
 
+Vector2 get_block_corner_offset(const Block* block) {
+    CellCoords cell_coords = get_shape_coords(block->shape);
+    Vector2 corner = get_block_cell_coord(block, 0);
+    for (int i = 1; i < cell_coords.len; ++i) {
+        corner = Vector2Min(corner, get_block_cell_coord(block, i));
+    }
+    return corner;
+}
+
 Block make_block(FieldCellItem item, BlockShape shape, int rotation) {
     return (Block){
         .item = item,
@@ -126,10 +94,17 @@ Block make_block(FieldCellItem item, BlockShape shape, int rotation) {
     };
 }
 
-Block get_random_block() {
-    FieldCellItem item = (rand() % CELL_COLORS_N) + 1;
-    BlockShape shape = rand() % BLOCK_SHAPES_N;
-    int rotation = rand() % 4;
+Block get_random_block(Rng* rng) {
+    FieldCellItem item = rng_range(rng, CELL_COLORS_N) + 1;
+    BlockShape shape;
+    if (uniform_weights) {
+        // the same draw as before shapes had weights, so equal weights
+        // keep the deals of a seed
+        shape = rng_range(rng, shapes_n);
+    } else {
+        shape = sample_shape(rng_next(rng));
+    }
+    int rotation = rng_range(rng, 4);
     return (Block){
         .item = item,
         .shape = shape,
@@ -145,12 +120,367 @@ Block get_empty_block() {
     };
 }
 
+// the point a block is held by and rotated around, per axis: the centre of
+// its cells snapped to a cell centre or grid line, preferring the cell
+// centre when both are as close
+static float get_shape_pivot(float center) {
+    float line = roundf(center);
+    float cell_center = floorf(center) + 0.5f;
+    return fabsf(center - cell_center) <= fabsf(center - line) ? cell_center
+                                                              : line;
+}
+
+static bool is_cell_center(float coord) { return coord != floorf(coord); }
+
+// a block whose cells are centred on the pivot in both axes snaps to cell
+// centres, one on grid lines in both to grid corners, and the rest to edges
+static BlockAlignmentType derive_alignment(const ShapeDef* shape) {
+    bool center_x = is_cell_center(shape->cell_coords[0].x);
+    bool center_y = is_cell_center(shape->cell_coords[0].y);
+    if (center_x && center_y) return BLOCK_ALIGNMENT_TYPE_MIDDLE;
+    if (!center_x && !center_y) return BLOCK_ALIGNMENT_TYPE_CORNER;
+    return BLOCK_ALIGNMENT_TYPE_EDGE;
+}
+
+// the weights are scaled by shapes_n so a column holds total_weight, which
+// keeps the construction in integers
+static void build_shape_alias(void) {
+    int64_t scaled[BLOCK_SHAPES_MAX];
+    int small[BLOCK_SHAPES_MAX];
+    int large[BLOCK_SHAPES_MAX];
+    int small_n = 0;
+    int large_n = 0;
+    for (int i = 0; i < shapes_n; ++i) {
+        scaled[i] = (int64_t)shapes[i].weight * shapes_n;
+        alias_shapes[i] = i;
+        if (scaled[i] < total_weight) {
+            small[small_n++] = i;
+        } else {
+            large[large_n++] = i;
+        }
+    }
+    while (small_n > 0 && large_n > 0) {
+        int s = small[--small_n];
+        int l = large[large_n - 1];
+        alias_shapes[s] = l;
+        alias_thresholds[s] = ((uint64_t)scaled[s] << 32) / total_weight;
+        scaled[l] -= total_weight - scaled[s];
+        if (scaled[l] < total_weight) {
+            large_n--;
+            small[small_n++] = l;
+        }
+    }
+    // whatever is left is full up to rounding
+    while (large_n > 0) alias_thresholds[large[--large_n]] = (uint64_t)1 << 32;
+    while (small_n > 0) alias_thresholds[small[--small_n]] = (uint64_t)1 << 32;
+}
+
+BlockShape sample_shape(uint64_t bits) {
+    // the high half picks a column and the bits below it within the
+    // column, so one draw does both without a modulo
+    uint64_t scaled = (bits >> 32) * (uint64_t)shapes_n;
+    int column = scaled >> 32;
+    return (scaled & 0xffffffffu) < alias_thresholds[column]
+               ? column
+               : alias_shapes[column];
+}
+
+static bool shape_set_error(char* error_out, size_t error_size, int line,
+                            const char* message) {
+    snprintf(error_out, error_size, "line %d: %s", line, message);
+    return false;
+}
+
+// the grid rows of a shape have been read into cells, relative to its top
+// left corner
+static bool finish_shape(ShapeDef* shape, const int cells[][2], int line,
+                         char* error_out, size_t error_size) {
+    if (shape->cells_n == 0) {
+        return shape_set_error(error_out, error_size, line,
+                               "shape without cells");
+    }
+    float sum_x = 0;
+    float sum_y = 0;
+    int width = 0;
+    int height = 0;
+    for (int i = 0; i < shape->cells_n; ++i) {
+        sum_x += cells[i][0] + 0.5f;
+        sum_y += cells[i][1] + 0.5f;
+        if (cells[i][0] + 1 > width) width = cells[i][0] + 1;
+        if (cells[i][1] + 1 > height) height = cells[i][1] + 1;
+    }
+    if (width > FIELD_SIZE || height > FIELD_SIZE) {
+        return shape_set_error(error_out, error_size, line,
+                               "shape doesn't fit into the field");
+    }
+    Vector2 pivot = {get_shape_pivot(sum_x / shape->cells_n),
+                     get_shape_pivot(sum_y / shape->cells_n)};
+    for (int i = 0; i < shape->cells_n; ++i) {
+        shape->cell_coords[i] =
+            (Vector2){cells[i][0] - pivot.x, cells[i][1] - pivot.y};
+    }
+    shape->alignment = derive_alignment(shape);
+    return true;
+}
+
+bool parse_shape_set(const char* text, char* error_out, size_t error_size) {
+    ShapeDef parsed[BLOCK_SHAPES_MAX];
+    int parsed_n = 0;
+    int cells[BLOCK_CELLS_MAX][2];
+    int row = 0;
+    int line_n = 0;
+
+    while (*text) {
+        const char* end = strchr(text, '\n');
+        int len = end ? end - text : (int)strlen(text);
+        if (len > 0 && text[len - 1] == '\r') len--;
+        char line[128];
+        if (len >= (int)sizeof(line)) {
+            return shape_set_error(error_out, error_size, line_n + 1,
+                                   "line too long");
+        }
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text = end ? end + 1 : text + strlen(text);
+        line_n++;
+
+        if (len == 0 || strncmp(line, "//", 2) == 0) continue;
+
+        if (strncmp(line, "shape ", 6) == 0) {
+            if (parsed_n > 0 && !finish_shape(&parsed[parsed_n - 1], cells,
+                                              line_n - 1, error_out,
+                                              error_size)) {
+                return false;
+            }
+            if (parsed_n == BLOCK_SHAPES_MAX) {
+                return shape_set_error(error_out, error_size, line_n,
+                                       "too many shapes");
+            }
+            ShapeDef* shape = &parsed[parsed_n++];
+            *shape = (ShapeDef){.weight = 1};
+            const char* p = line + 6;
+            while (*p == ' ') p++;
+            size_t name_len = strcspn(p, " ");
+            if (name_len == 0) {
+                return shape_set_error(error_out, error_size, line_n,
+                                       "expected shape <name> [weight]");
+            }
+            if (name_len >= SHAPE_NAME_MAX) {
+                return shape_set_error(error_out, error_size, line_n,
+                                       "shape name too long");
+            }
+            memcpy(shape->name, p, name_len);
+            shape->name[name_len] = '\0';
+            p += name_len;
+            while (*p == ' ') p++;
+            if (*p) {
+                char* weight_end;
+                long weight = strtol(p, &weight_end, 10);
+                while (*weight_end == ' ') weight_end++;
+                if (weight_end == p || *weight_end) {
+                    return shape_set_error(error_out, error_size, line_n,
+                                           "the weight must be a number");
+                }
+                if (weight < 1 || weight > SHAPE_WEIGHT_MAX) {
+                    char message[64];
+                    snprintf(message, sizeof(message),
+                             "the weight must be from 1 to %d",
+                             SHAPE_WEIGHT_MAX);
+                    return shape_set_error(error_out, error_size, line_n,
+                                           message);
+                }
+                shape->weight = weight;
+            }
+            row = 0;
+            continue;
+        }
+
+        if (parsed_n == 0) {
+            return shape_set_error(error_out, error_size, line_n,
+                                   "cells before the first shape");
+        }
+        ShapeDef* shape = &parsed[parsed_n - 1];
+        for (int x = 0; x < len; ++x) {
+            if (line[x] == '.' || line[x] == ' ') continue;
+            if (line[x] != '#') {
+                return shape_set_error(error_out, error_size, line_n,
+                                       "cells are '#', gaps '.'");
+            }
+            if (shape->cells_n == BLOCK_CELLS_MAX) {
+                return shape_set_error(error_out, error_size, line_n,
+                                       "too many cells");
+            }
+            cells[shape->cells_n][0] = x;
+            cells[shape->cells_n][1] = row;
+            shape->cells_n++;
+        }
+        row++;
+    }
+    if (parsed_n == 0) {
+        return shape_set_error(error_out, error_size, line_n, "no shapes");
+    }
+    if (!finish_shape(&parsed[parsed_n - 1], cells, line_n, error_out,
+                      error_size)) {
+        return false;
+    }
+
+    shapes_n = parsed_n;
+    total_weight = 0;
+    uniform_weights = true;
+    for (int i = 0; i < shapes_n; ++i) {
+        shapes[i] = parsed[i];
+        total_weight += shapes[i].weight;
+        uniform_weights &= shapes[i].weight == shapes[0].weight;
+    }
+    build_shape_alias();
+    return true;
+}
+
+bool load_shape_set(const char* path, char* error_out, size_t error_size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        snprintf(error_out, error_size, "can't open %s", path);
+        return false;
+    }
+    char text[SHAPE_SET_TEXT_MAX + 1];
+    size_t len = fread(text, 1, sizeof(text), file);
+    fclose(file);
+    if (len > SHAPE_SET_TEXT_MAX) {
+        snprintf(error_out, error_size, "%s is too large", path);
+        return false;
+    }
+    text[len] = '\0';
+    return parse_shape_set(text, error_out, error_size);
+}
+
+static void build_block_masks(void) {
+    for (int shape = 0; shape < shapes_n; ++shape) {
+        CellCoords cell_coords = get_shape_coords(shape);
+        assert(cell_coords.len <= BLOCK_CELLS_MAX);
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            Block block = make_block(CELL_ITEM_BLUE, shape, rotation);
+            Vector2 corner = get_block_cell_coord(&block, 0);
+            for (int i = 1; i < cell_coords.len; ++i) {
+                corner = Vector2Min(corner, get_block_cell_coord(&block, i));
+            }
+
+            BlockMask* mask = &block_masks[shape][rotation];
+            *mask = (BlockMask){.cells_n = cell_coords.len};
+            int width = 0;
+            int height = 0;
+            for (int i = 0; i < cell_coords.len; ++i) {
+                Vector2 cell = Vector2Round(Vector2Subtract(
+                    get_block_cell_coord(&block, i), corner));
+                mask->offsets[i] = vector_field_index(cell);
+                mask->cells |= board_cell(mask->offsets[i]);
+                if (cell.x + 1 > width) width = cell.x + 1;
+                if (cell.y + 1 > height) height = cell.y + 1;
+            }
+            for (int y = 0; y + height <= FIELD_SIZE; ++y) {
+                for (int x = 0; x + width <= FIELD_SIZE; ++x) {
+                    mask->origins |= board_cell(y * FIELD_SIZE + x);
+                }
+            }
+            mask->width = width;
+            mask->height = height;
+        }
+    }
+}
+
+static uint64_t hash_word(uint64_t hash, uint64_t word) {
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (word >> i * 8) & 0xff;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// fnv-1a of what the games depend on: the order, cells and weights of the
+// shapes. the names only show in the tools
+static uint64_t hash_shape_set(void) {
+    uint64_t hash = hash_word(0xcbf29ce484222325ull, shapes_n);
+    for (int shape = 0; shape < shapes_n; ++shape) {
+        hash = hash_word(hash, shapes[shape].weight);
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            hash = hash_word(hash, block_masks[shape][rotation].cells);
+        }
+    }
+    return hash;
+}
+
+bool init_block_masks(void) {
+    const char* path = getenv(SHAPE_SET_ENV);
+    char error[256];
+    bool loaded = path && *path
+                      ? load_shape_set(path, error, sizeof(error))
+                      : parse_shape_set(builtin_shape_set, error,
+                                        sizeof(error));
+    if (!loaded) {
+        fprintf(stderr, "bad shape set %s: %s\n", path ? path : "", error);
+        return false;
+    }
+    build_block_masks();
+    shape_set_hash = hash_shape_set();
+    return true;
+}
+
+uint64_t get_shape_set_hash(void) {
+    assert(shape_set_hash && "init_block_masks wasn't called");
+    return shape_set_hash;
+}
+
+int get_shapes_n(void) { return shapes_n; }
+
+const char* get_shape_name(BlockShape shape) {
+    assert((int)shape < shapes_n);
+    return shapes[shape].name;
+}
+
+int get_shape_weight(BlockShape shape) {
+    assert((int)shape < shapes_n);
+    return shapes[shape].weight;
+}
+
+double get_shape_chance(BlockShape shape) {
+    assert((int)shape < shapes_n);
+    return (double)shapes[shape].weight / total_weight;
+}
+
+const BlockMask* get_block_mask(const Block* block) {
+    const BlockMask* mask = &block_masks[block->shape][block->rotation & 3];
+    assert(mask->cells_n > 0 && "init_block_masks wasn't called");
+    return mask;
+}
+
+const BlockMask* get_block_masks(void) {
+    assert(block_masks[0][0].cells_n > 0 && "init_block_masks wasn't called");
+    return &block_masks[0][0];
+}
+
+static_assert(CELL_ITEMS_N <= 4 && BLOCK_SHAPES_MAX <= 8,
+              "blocks must fit into a PackedBlock");
+
+PackedBlock pack_block(const Block* block) {
+    return block->item | block->shape << 2 | (block->rotation & 3) << 5;
+}
+
+Block unpack_block(PackedBlock packed) {
+    return (Block){
+        .item = packed & 3,
+        .shape = (packed >> 2) & 7,
+        .rotation = (packed >> 5) & 3,
+    };
+}
+
 inline Color get_field_cell_color(FieldCellItem item) {
     assert(item >= 0 && item < CELL_ITEMS_N);
     return field_cell_item_color_lookup[item];
 }
 
 CellCoords get_shape_coords(BlockShape shape) {
-    assert(shape >= 0 && shape < BLOCK_SHAPES_N);
-    return block_shape_cell_coords_lookup[shape];
+    assert((int)shape < shapes_n);
+    return (CellCoords){
+        .len = shapes[shape].cells_n,
+        .cell_coords = shapes[shape].cell_coords,
+    };
 }
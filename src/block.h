@@ -3,8 +3,12 @@
 
 #include <raylib.h>
 #include <raymath.h>
+#include <stdbool.h>
+#include <stddef.h>
 
+#include "bitboard.h"
 #include "constants.h"
+#include "rng.h"
 
 typedef struct Block {
     FieldCellItem item;
@@ -12,6 +16,23 @@ typedef struct Block {
     int rotation;  // how many right angle rotations to the right
 } Block;
 
+// a Block squeezed into a byte: item in bits 0-1, shape in bits 2-4 and
+// rotation in bits 5-6
+typedef uint8_t PackedBlock;
+
+#define BLOCK_CELLS_MAX 9
+
+// integer form of a rotated shape, positioned by the top left corner of its
+// cells
+typedef struct BlockMask {
+    Board cells;    // cells with the top left corner at index 0
+    Board origins;  // corners at which the block stays inside the field
+    uint8_t offsets[BLOCK_CELLS_MAX];  // field index offset of every cell
+    uint8_t cells_n;
+    uint8_t width;  // of the bounding box
+    uint8_t height;
+} BlockMask;
+
 typedef enum BlockAlignmentType {
     BLOCK_ALIGNMENT_TYPE_MIDDLE,
     BLOCK_ALIGNMENT_TYPE_CORNER,
@@ -19,14 +40,66 @@ typedef enum BlockAlignmentType {
 } BlockAlignmentType;
 
 Block make_block(FieldCellItem item, BlockShape shape, int rotation);
-Block get_random_block();
+Block get_random_block(Rng* rng);
 Block get_empty_block();
+PackedBlock pack_block(const Block* block);
+Block unpack_block(PackedBlock packed);
 
 Vector2 get_block_cell_coord(const Block* block, int i);
-bool placed_block_space_free(const FieldCellItem* field, Vector2 coords, const Block* block);
-bool placed_block_fits_in_field(Vector2 coords, const Block* block);
+// derived from where the shape's cells sit around the point it's held by
 BlockAlignmentType get_block_alignment(const Block* block);
-Vector2 clamp_block_pos_to_field(Vector2 coords, const Block* block);
+Vector2 clamp_block_pos_to_sized_field(Vector2 coords, const Block* block,
+                                       int size);
+// offset from the block coordinates to the top left corner of its cells
+Vector2 get_block_corner_offset(const Block* block);
+
+// shape set files list the shapes in BlockShape order, each one a line
+//
+//   shape <name> [weight]
+//
+// followed by its rows of rotation 0, '#' for a cell and '.' or ' ' for a
+// gap. a shape is dealt weight times as often as one of weight 1, and
+// lines starting with // are skipped. without a file the builtin set of
+// BlockShape is used, all with weight 1
+#define SHAPE_SET_ENV "RM_SHAPE_SET"
+#define SHAPE_NAME_MAX 16
+#define SHAPE_WEIGHT_MAX 1000000
+#define SHAPE_SET_TEXT_MAX 16384
+
+// replace the current shape set, false with the line and reason in
+// error_out if the text isn't a valid one. init_block_masks has to run
+// again afterwards
+bool parse_shape_set(const char* text, char* error_out, size_t error_size);
+bool load_shape_set(const char* path, char* error_out, size_t error_size);
+
+// loads the shape set file named by SHAPE_SET_ENV, or the builtin set, and
+// compiles it into the masks. must be called once at startup, before any
+// thread uses the shapes. false if the file couldn't be loaded, the reason
+// is printed to stderr
+bool init_block_masks(void);
+// identifies the shape set that was loaded, so files of games played with
+// another one can be told apart and refused
+uint64_t get_shape_set_hash(void);
+const BlockMask* get_block_mask(const Block* block);
+// all get_shapes_n() * 4 masks, index shape * 4 + rotation
+const BlockMask* get_block_masks(void);
+
+int get_shapes_n(void);
+const char* get_shape_name(BlockShape shape);
+int get_shape_weight(BlockShape shape);
+// the chance a dealt block has this shape
+double get_shape_chance(BlockShape shape);
+// a shape drawn by its weight from 64 random bits, in constant time
+BlockShape sample_shape(uint64_t bits);
+
+// corners at which the block can be placed on the occupied field
+static inline Board get_legal_origins(Board occupied, const BlockMask* mask) {
+    Board legal = mask->origins;
+    for (int i = 0; i < mask->cells_n; ++i) {
+        legal &= ~(occupied >> mask->offsets[i]);
+    }
+    return legal;
+}
 
 Color get_field_cell_color(FieldCellItem item);
 CellCoords get_shape_coords(BlockShape shape);
@@ -0,0 +1,70 @@
+#include "block_gen.h"
+
+#include <string.h>
+
+static const char* deal_mode_names[DEAL_MODES_N] = {
+    [DEAL_MODE_RANDOM] = "random",
+    [DEAL_MODE_BAG] = "bag",
+};
+
+bool parse_deal_mode(const char* name, DealMode* mode_out) {
+    for (int mode = 0; mode < DEAL_MODES_N; ++mode) {
+        if (strcmp(name, deal_mode_names[mode]) == 0) {
+            *mode_out = mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* get_deal_mode_name(DealMode mode) {
+    return deal_mode_names[mode];
+}
+
+static void refill_bag(BlockGen* gen) {
+    gen->bag_left = 0;
+    for (int shape = 0; shape < get_shapes_n(); ++shape) {
+        gen->bag[shape] = get_shape_weight(shape);
+        gen->bag_left += gen->bag[shape];
+    }
+}
+
+BlockGen make_block_gen(uint64_t seed, DealMode mode) {
+    BlockGen gen = {.rng = make_rng(seed), .mode = mode};
+    if (mode == DEAL_MODE_BAG) refill_bag(&gen);
+    return gen;
+}
+
+static BlockShape draw_from_bag(BlockGen* gen) {
+    if (gen->bag_left == 0) refill_bag(gen);
+    uint32_t ticket = rng_range(&gen->rng, gen->bag_left);
+    int shape = 0;
+    while (ticket >= gen->bag[shape]) ticket -= gen->bag[shape++];
+    gen->bag[shape]--;
+    gen->bag_left--;
+    return shape;
+}
+
+PackedBlock block_gen_next(BlockGen* gen) {
+    if (gen->mode == DEAL_MODE_RANDOM) {
+        Block block = get_random_block(&gen->rng);
+        return pack_block(&block);
+    }
+    // the same draw order as get_random_block
+    Block block;
+    block.item = rng_range(&gen->rng, CELL_COLORS_N) + 1;
+    block.shape = draw_from_bag(gen);
+    block.rotation = rng_range(&gen->rng, 4);
+    return pack_block(&block);
+}
+
+void block_gen_fill(BlockGen* gen, PackedBlock* blocks_out, size_t blocks_n) {
+    if (gen->mode == DEAL_MODE_RANDOM) {
+        for (size_t i = 0; i < blocks_n; ++i) {
+            Block block = get_random_block(&gen->rng);
+            blocks_out[i] = pack_block(&block);
+        }
+        return;
+    }
+    for (size_t i = 0; i < blocks_n; ++i) blocks_out[i] = block_gen_next(gen);
+}
@@ -0,0 +1,44 @@
+#if !defined(BLOCK_GEN_H)
+#define BLOCK_GEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "block.h"
+#include "constants.h"
+#include "rng.h"
+
+// block streams for simulations that deal from a buffer filled ahead of
+// time instead of drawing every block on the spot.
+//
+// random deals are the blocks get_random_block draws from the same seed, so
+// a game dealt from a stream can still be replayed with make_gamestate.
+// bag deals put weight copies of every shape into a bag and draw from it
+// without putting them back, so each shape turns up once per bag; colors
+// and rotations stay random
+
+typedef enum DealMode {
+    DEAL_MODE_RANDOM,
+    DEAL_MODE_BAG,
+    DEAL_MODES_N,
+} DealMode;
+
+typedef struct BlockGen {
+    Rng rng;
+    DealMode mode;
+    uint32_t bag_left;  // blocks left in the bag
+    uint32_t bag[BLOCK_SHAPES_MAX];  // copies left per shape
+} BlockGen;
+
+// "random" or "bag", false for anything else
+bool parse_deal_mode(const char* name, DealMode* mode_out);
+const char* get_deal_mode_name(DealMode mode);
+
+// init_block_masks must have been called
+BlockGen make_block_gen(uint64_t seed, DealMode mode);
+PackedBlock block_gen_next(BlockGen* gen);
+// the next blocks_n blocks, the same as calling block_gen_next that often
+void block_gen_fill(BlockGen* gen, PackedBlock* blocks_out, size_t blocks_n);
+
+#endif  // BLOCK_GEN_H
@@ -0,0 +1,64 @@
+#include "board_features.h"
+
+#include <string.h>
+
+#include "block.h"
+
+#define NOT_COL_0 (~BOARD_COL_0)
+#define NOT_COL_7 (~(BOARD_COL_0 << (FIELD_SIZE - 1)))
+
+static int count_holes(Board empty) {
+    Board neighbours = ((empty << 1) & NOT_COL_0) |
+                       ((empty >> 1) & NOT_COL_7) | (empty << FIELD_SIZE) |
+                       (empty >> FIELD_SIZE);
+    return board_popcount(empty & ~neighbours);
+}
+
+// tries every height h, byte r of tall holds the columns empty in rows r to
+// r + h - 1. a set bit left after shrinking a row w - 1 times is the start
+// of w empty cells in a row, so an h by w rectangle. widest[h] gets the
+// widest one of height h, 0 if there's none
+static int get_largest_rect(Board empty, uint8_t widest[FIELD_SIZE + 1]) {
+    int largest = 0;
+    Board tall = empty;
+    for (int h = 1; h <= FIELD_SIZE; ++h) {
+        int w = 0;
+        for (Board wide = tall; wide; wide &= (wide >> 1) & NOT_COL_7) ++w;
+        widest[h] = w;
+        if (h * w > largest) largest = h * w;
+        tall = h < FIELD_SIZE ? tall & (empty >> (h * FIELD_SIZE)) : 0;
+    }
+    return largest;
+}
+
+// rectangular blocks are looked up in widest, only the others need their
+// cells shifted over the board
+static int count_fitting(Board occupied, const uint8_t widest[]) {
+    const BlockMask* masks = get_block_masks();
+    int fitting_n = 0;
+    for (int i = 0; i < get_shapes_n() * 4; ++i) {
+        const BlockMask* mask = &masks[i];
+        if (mask->cells_n == mask->width * mask->height) {
+            fitting_n += widest[mask->height] >= mask->width;
+        } else {
+            fitting_n += get_legal_origins(occupied, mask) != 0;
+        }
+    }
+    return fitting_n;
+}
+
+void extract_features(Board occupied, BoardFeatures* out) {
+    Board empty = ~occupied;
+    out->empty_n = board_popcount(empty);
+
+    // one count per byte, byte i is row i on little endian
+    uint64_t rows = board_byte_popcounts(occupied);
+    uint64_t cols = board_byte_popcounts(board_transpose(occupied));
+    memcpy(out->row_fill, &rows, sizeof(rows));
+    memcpy(out->col_fill, &cols, sizeof(cols));
+
+    out->holes_n = count_holes(empty);
+    uint8_t widest[FIELD_SIZE + 1];
+    out->largest_rect = get_largest_rect(empty, widest);
+    out->fitting_n = count_fitting(occupied, widest);
+}
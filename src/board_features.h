@@ -0,0 +1,25 @@
+#if !defined(BOARD_FEATURES_H)
+#define BOARD_FEATURES_H
+
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "constants.h"
+
+// the board features evaluation heuristics work with, all computed from
+// the occupancy board at once
+typedef struct BoardFeatures {
+    uint8_t empty_n;
+    uint8_t row_fill[FIELD_SIZE];  // occupied cells per row
+    uint8_t col_fill[FIELD_SIZE];  // occupied cells per column
+    uint8_t holes_n;  // empty cells without an empty neighbour
+    uint8_t largest_rect;  // cells of the largest empty rectangle
+    // shape and rotation pairs that can be placed somewhere, out of
+    // get_shapes_n() * 4
+    uint8_t fitting_n;
+} BoardFeatures;
+
+// init_block_masks must have been called
+void extract_features(Board occupied, BoardFeatures* out);
+
+#endif  // BOARD_FEATURES_H
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+#include "book.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(BookEntry) == 24, "BookEntry is stored as is");
+static_assert(sizeof(BookHeader) % 8 == 0, "entries must stay aligned");
+
+// shape * 4 + the first rotation with the same cells, so the rotations of
+// the square blocks all share a code
+static uint8_t get_block_code(BlockShape shape, int rotation) {
+    const BlockMask* masks = get_block_masks() + shape * 4;
+    int code_rotation = rotation & 3;
+    for (int r = 0; r < code_rotation; ++r) {
+        if (masks[r].cells == masks[code_rotation].cells) {
+            code_rotation = r;
+            break;
+        }
+    }
+    return shape * 4 + code_rotation;
+}
+
+bool book_key(const GameState* state, BookKey* key_out) {
+    if (state->blocks_placed != 0 || state->combo > 0xff) return false;
+
+    Board occupied = get_occupied_cells(state);
+    for (int rotations = 0; rotations < 4; ++rotations) {
+        BookKey key = {.occupied = occupied, .rotations = rotations};
+        uint8_t codes[HELD_BLOCKS_N];
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            const Block* block = &state->held_blocks[slot];
+            if (block->item == CELL_ITEM_EMPTY) return false;
+            // insertion sort, carrying the slots along
+            int i = slot;
+            uint8_t code = get_block_code(block->shape,
+                                          block->rotation + rotations);
+            for (; i > 0 && codes[i - 1] > code; --i) {
+                codes[i] = codes[i - 1];
+                key.slots[i] = key.slots[i - 1];
+            }
+            codes[i] = code;
+            key.slots[i] = slot;
+        }
+        key.held = (uint32_t)state->combo << 24 | (uint32_t)codes[0] << 16 |
+                   (uint32_t)codes[1] << 8 | codes[2];
+
+        if (rotations == 0 || key.occupied < key_out->occupied ||
+            (key.occupied == key_out->occupied && key.held < key_out->held)) {
+            *key_out = key;
+        }
+        occupied = board_rotate(occupied);
+    }
+    return true;
+}
+
+GameState book_key_state(Board occupied, uint32_t held) {
+    GameState state = make_gamestate(0);
+    for (int i = 0; i < CELL_COLORS_N; ++i) state.field[i] = 0;
+    state.field[0] = occupied;
+    state.combo = held >> 24;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        uint8_t code = held >> (HELD_BLOCKS_N - 1 - slot) * 8;
+        state.held_blocks[slot] =
+            make_block(CELL_ITEM_BLUE, code / 4, code % 4);
+    }
+    return state;
+}
+
+static int compare_positions(Board occupied_a, uint32_t held_a,
+                             Board occupied_b, uint32_t held_b) {
+    if (occupied_a != occupied_b) return occupied_a < occupied_b ? -1 : 1;
+    return (held_a > held_b) - (held_a < held_b);
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const BookEntry* entry_a = a;
+    const BookEntry* entry_b = b;
+    return compare_positions(entry_a->occupied, entry_a->held,
+                             entry_b->occupied, entry_b->held);
+}
+
+uint64_t book_sort_entries(BookEntry* entries, uint64_t entries_n) {
+    if (entries_n == 0) return 0;
+    qsort(entries, entries_n, sizeof(*entries), compare_entries);
+    uint64_t unique_n = 1;
+    for (uint64_t i = 1; i < entries_n; ++i) {
+        if (compare_entries(&entries[i], &entries[unique_n - 1]) != 0) {
+            entries[unique_n++] = entries[i];
+        }
+    }
+    return unique_n;
+}
+
+static bool write_all(int fd, const void* buf, size_t len) {
+    const uint8_t* p = buf;
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written <= 0) return false;
+        p += written;
+        len -= written;
+    }
+    return true;
+}
+
+bool book_write(const char* path, const BookEntry* entries,
+                uint64_t entries_n) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    BookHeader header = {
+        .magic = BOOK_MAGIC,
+        .version = BOOK_VERSION,
+        .entries_n = entries_n,
+        .shape_set_hash = get_shape_set_hash(),
+    };
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, entries, sizeof(*entries) * entries_n);
+    ok &= close(fd) == 0;
+    return ok;
+}
+
+bool book_open(OpeningBook* book, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BookHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    const BookHeader* header = data;
+    bool valid = memcmp(header->magic, BOOK_MAGIC, 4) == 0 &&
+                 header->version == BOOK_VERSION &&
+                 header->shape_set_hash == get_shape_set_hash() &&
+                 header->entries_n <=
+                     (size - sizeof(*header)) / sizeof(BookEntry);
+    if (!valid) {
+        munmap(data, size);
+        return false;
+    }
+
+    *book = (OpeningBook){
+        .data = data,
+        .size = size,
+        .entries_n = header->entries_n,
+        .entries = (const BookEntry*)((const uint8_t*)data + sizeof(*header)),
+    };
+    return true;
+}
+
+void book_close(OpeningBook* book) {
+    if (book->data) munmap((void*)book->data, book->size);
+    *book = (OpeningBook){0};
+}
+
+const BookEntry* book_find(const OpeningBook* book, Board occupied,
+                           uint32_t held) {
+    uint64_t low = 0;
+    uint64_t high = book->entries_n;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        const BookEntry* entry = &book->entries[mid];
+        int order =
+            compare_positions(entry->occupied, entry->held, occupied, held);
+        if (order == 0) return entry;
+        if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+bool book_lookup(const OpeningBook* book, const GameState* state,
+                 Move* moves_out, int* moves_n_out) {
+    BookKey key;
+    if (!book_key(state, &key)) return false;
+    const BookEntry* entry = book_find(book, key.occupied, key.held);
+    if (!entry || entry->moves_n > HELD_BLOCKS_N) return false;
+
+    const BlockMask* masks = get_block_masks();
+    for (int i = 0; i < entry->moves_n; ++i) {
+        Move move = entry->moves[i];
+        if (move.slot >= HELD_BLOCKS_N ||
+            move.cell >= FIELD_SIZE * FIELD_SIZE) {
+            return false;
+        }
+        // the cells the move covers on the canonical field, turned back
+        uint8_t code = key.held >> (HELD_BLOCKS_N - 1 - move.slot) * 8;
+        Board placed = masks[code].cells << move.cell;
+        for (int r = (4 - key.rotations) % 4; r > 0; --r) {
+            placed = board_rotate(placed);
+        }
+
+        int slot = key.slots[move.slot];
+        int cell = board_corner(placed);
+        const BlockMask* mask = get_block_mask(&state->held_blocks[slot]);
+        if (mask->cells << cell != placed) return false;
+        moves_out[i] = (Move){.slot = slot, .cell = cell};
+    }
+    *moves_n_out = entry->moves_n;
+    return true;
+}
@@ -0,0 +1,84 @@
+#if !defined(BOOK_H)
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// opening book: the best line of search_turn for turn starts that come up
+// again and again, generated offline by the book_gen tool.
+//
+// file layout (native byte order):
+//   BookHeader
+//   BookEntry[entries_n], sorted by (occupied, held)
+//
+// positions are stored in a canonical form. the four rotations of a field,
+// with the held blocks rotated along, play the same and share one entry,
+// and the held blocks are sorted, so the slot of a book move is an index
+// into the sorted blocks and its cell is on the rotated field. colors and
+// points don't change the best line and aren't part of the key.
+
+#define BOOK_MAGIC "RMOB"
+// bumped whenever the game rules or the search change
+#define BOOK_VERSION 2
+
+typedef struct BookHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t entries_n;
+    // get_shape_set_hash, the block codes mean nothing under another set
+    uint64_t shape_set_hash;
+} BookHeader;
+
+typedef struct BookEntry {
+    Board occupied;
+    // combo in bits 24-31, the sorted block codes (shape * 4 + rotation) in
+    // bits 16-23, 8-15 and 0-7
+    uint32_t held;
+    uint8_t moves_n;
+    uint8_t reserved[5];
+    Move moves[HELD_BLOCKS_N];
+} BookEntry;
+
+// a turn start in canonical form, and how to get back to the game's own
+typedef struct BookKey {
+    Board occupied;
+    uint32_t held;
+    int rotations;  // right angles the field was turned by
+    uint8_t slots[HELD_BLOCKS_N];  // game slot of every sorted block
+} BookKey;
+
+typedef struct OpeningBook {
+    const uint8_t* data;  // the mapping, NULL for an in memory table
+    size_t size;
+    uint64_t entries_n;
+    const BookEntry* entries;
+} OpeningBook;
+
+// false unless the state is at the start of a turn
+bool book_key(const GameState* state, BookKey* key_out);
+// a state with the key's position in canonical form, moves searched on it
+// are book moves
+GameState book_key_state(Board occupied, uint32_t held);
+
+// sorts the entries and drops repeated positions, returns how many are left
+uint64_t book_sort_entries(BookEntry* entries, uint64_t entries_n);
+// entries must have gone through book_sort_entries
+bool book_write(const char* path, const BookEntry* entries,
+                uint64_t entries_n);
+
+// the book is mapped into memory and never copied
+bool book_open(OpeningBook* book, const char* path);
+void book_close(OpeningBook* book);
+
+// binary search, NULL if the position isn't in the book
+const BookEntry* book_find(const OpeningBook* book, Board occupied,
+                           uint32_t held);
+// the book line for the state's turn, in the game's own slots and cells.
+// moves_out needs room for HELD_BLOCKS_N moves
+bool book_lookup(const OpeningBook* book, const GameState* state,
+                 Move* moves_out, int* moves_n_out);
+
+#endif  // BOOK_H
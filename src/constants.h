@@ -3,7 +3,11 @@
 
 #include <raylib.h>
 
+// the field of the bitboard engine. the gui plays any size from
+// FIELD_SIZE_MIN to FIELD_SIZE_MAX through the wide game, see wide.h
 #define FIELD_SIZE 8
+#define FIELD_SIZE_MIN 4
+#define FIELD_SIZE_MAX 16
 #define FIELD_WIDTH 500
 #define FIELD_HEIGHT 500
 
@@ -11,10 +15,12 @@
 
 #define FIELD_BORDER_THICKNESS 1
 
-#define FIELD_CELL_HEIGHT \
-    ((float)(FIELD_HEIGHT - FIELD_BORDER_THICKNESS * (FIELD_SIZE)) / FIELD_SIZE)
-#define FIELD_CELL_WIDTH \
-    ((float)(FIELD_WIDTH - FIELD_BORDER_THICKNESS * (FIELD_SIZE)) / FIELD_SIZE)
+#define FIELD_CELL_HEIGHT_OF(size) \
+    ((float)(FIELD_HEIGHT - FIELD_BORDER_THICKNESS * (size)) / (size))
+#define FIELD_CELL_WIDTH_OF(size) \
+    ((float)(FIELD_WIDTH - FIELD_BORDER_THICKNESS * (size)) / (size))
+#define FIELD_CELL_HEIGHT FIELD_CELL_HEIGHT_OF(FIELD_SIZE)
+#define FIELD_CELL_WIDTH FIELD_CELL_WIDTH_OF(FIELD_SIZE)
 
 #define BLOCK_CELL_HEIGHT FIELD_CELL_HEIGHT
 #define BLOCK_CELL_WIDTH FIELD_CELL_WIDTH
@@ -32,6 +38,8 @@ typedef enum FieldCellItem {
 } FieldCellItem;
 #define CELL_COLORS_N (CELL_ITEMS_N - 1)
 
+// the builtin shape set, a set loaded at runtime numbers its own shapes
+// from 0 up to BLOCK_SHAPES_MAX
 typedef enum BlockShape {
     BLOCK_SHAPE_2x2,
     BLOCK_SHAPE_3X3,
@@ -42,6 +50,9 @@ typedef enum BlockShape {
     BLOCK_SHAPES_N,  // should be last
 } BlockShape;
 
+// the most shapes a set can have, all of them fit into a PackedBlock
+#define BLOCK_SHAPES_MAX 8
+
 typedef struct CellCoords {
     int len;
     Vector2* cell_coords;
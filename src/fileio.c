@@ -0,0 +1,53 @@
+#define _GNU_SOURCE
+#include "fileio.h"
+
+#if defined(_WIN32)
+#include <io.h>
+// windows.h clashes with raylib, so the one call is declared here
+__declspec(dllimport) int __stdcall MoveFileExA(const char* from,
+                                                const char* to,
+                                                unsigned long flags);
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define MOVEFILE_WRITE_THROUGH 0x8
+
+bool sync_file(FILE* file) { return _commit(_fileno(file)) == 0; }
+bool truncate_file(FILE* file, uint64_t size) {
+    return _chsize_s(_fileno(file), (long long)size) == 0;
+}
+// rename doesn't replace an existing file on windows
+bool replace_file(const char* from, const char* to) {
+    return MoveFileExA(from, to,
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+#else
+#include <unistd.h>
+
+bool sync_file(FILE* file) { return fsync(fileno(file)) == 0; }
+bool truncate_file(FILE* file, uint64_t size) {
+    return ftruncate(fileno(file), (off_t)size) == 0;
+}
+bool replace_file(const char* from, const char* to) {
+    return rename(from, to) == 0;
+}
+#endif
+
+bool get_temp_path(const char* path, char* out, size_t size) {
+    int n = snprintf(out, size, "%s.tmp", path);
+    return n >= 0 && (size_t)n < size;
+}
+
+bool write_file_atomic(const char* path, const void* data, size_t size) {
+    char temp_path[FILEIO_PATH_MAX + 8];
+    if (!get_temp_path(path, temp_path, sizeof(temp_path))) return false;
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) return false;
+    // the data has to be on disk before the rename makes it the file
+    bool ok = fwrite(data, 1, size, file) == size && fflush(file) == 0 &&
+              sync_file(file);
+    ok &= fclose(file) == 0;
+    if (!ok || !replace_file(temp_path, path)) {
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
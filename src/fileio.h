@@ -0,0 +1,27 @@
+#if !defined(FILEIO_H)
+#define FILEIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// the few file operations that files surviving a crash need, on posix and
+// on windows. a new version of a file is written next to it under its
+// temporary path, synced, and then replaces it whole.
+
+#define FILEIO_PATH_MAX 512
+
+// the temporary path of path in out, false if it doesn't fit
+bool get_temp_path(const char* path, char* out, size_t size);
+// puts what the os holds of the file on the disk, the stdio buffer has to
+// be flushed first
+bool sync_file(FILE* file);
+bool truncate_file(FILE* file, uint64_t size);
+// renames from to to, over the file at to if there is one
+bool replace_file(const char* from, const char* to);
+// writes the file at path, which is always either the old file or the new
+// one, never a mix of them
+bool write_file_atomic(const char* path, const void* data, size_t size);
+
+#endif  // FILEIO_H
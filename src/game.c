@@ -0,0 +1,183 @@
+#include "game.h"
+
+#include "block.h"
+#include "constants.h"
+
+void get_random_deal(Rng* rng, Block* blocks_out) {
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        blocks_out[i] = get_random_block(rng);
+    }
+}
+
+GameState make_gamestate(uint64_t seed) {
+    GameState state = {
+        .points = 0,
+        .combo = 1,
+        .blocks_placed = 0,
+        .block_selected = 0,
+        .cleared_in_turn = false,
+        .rng = make_rng(seed),
+    };
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        state.field[i] = 0;
+    }
+
+    get_random_deal(&state.rng, state.held_blocks);
+    return state;
+}
+
+FieldCellItem get_field_cell(const GameState* state, int index) {
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        if (board_test(state->field[i], index)) return i + 1;
+    }
+    return CELL_ITEM_EMPTY;
+}
+
+int clear_field(Board* field, int combo, int* lines_cleared_out,
+                Board* cleared_out) {
+    Board occupied = 0;
+    for (int i = 0; i < CELL_COLORS_N; ++i) occupied |= field[i];
+
+    // all full lines are found before any of them is cleared, so crossing
+    // lines both count
+    unsigned rows = board_full_rows(occupied);
+    unsigned cols = board_full_cols(occupied);
+    int lines_cleared = board_popcount(rows) + board_popcount(cols);
+
+    Board cleared = lines_cleared ? board_lines_cells(rows, cols) : 0;
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        if (cleared_out) cleared_out[i] = field[i] & cleared;
+        field[i] &= ~cleared;
+    }
+
+    if (lines_cleared_out) *lines_cleared_out = lines_cleared;
+    return get_clear_points(lines_cleared, combo);
+}
+
+int make_move(GameState* state, Move move, PlacementUndo* undo_out) {
+    const Block* held_block = &state->held_blocks[move.slot];
+    Board placed = get_block_mask(held_block)->cells << move.cell;
+    if (undo_out) {
+        *undo_out = (PlacementUndo){
+            .placed = placed,
+            .turn = {
+                .points = state->points,
+                .combo = state->combo,
+                .block = pack_block(held_block),
+                .slot = move.slot,
+                .blocks_placed = state->blocks_placed,
+                .block_selected = state->block_selected,
+                .cleared_in_turn = state->cleared_in_turn,
+            },
+        };
+    }
+    state->blocks_placed++;
+
+    // placing the block into the field
+    state->field[held_block->item - 1] |= placed;
+    state->held_blocks[move.slot] = get_empty_block();
+
+    // field clearing and adding points
+    int lines_cleared;
+    clear_field(state->field, state->combo, &lines_cleared,
+                undo_out ? undo_out->cleared : NULL);
+    score_placement(lines_cleared, FIELD_SIZE, turn_finished(state),
+                    &state->points, &state->combo, &state->cleared_in_turn);
+    return lines_cleared;
+}
+
+void unmake_move(GameState* state, const PlacementUndo* undo) {
+    Block block = undo_turn(&undo->turn, state->held_blocks, &state->rng,
+                            &state->points, &state->combo,
+                            &state->blocks_placed, &state->block_selected,
+                            &state->cleared_in_turn);
+    // the cleared cells can include the placed ones, so those go last
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        state->field[i] |= undo->cleared[i];
+    }
+    state->field[block.item - 1] &= ~undo->placed;
+}
+
+void deal_blocks(GameState* state, const Block* blocks, DealUndo* undo_out) {
+    if (undo_out) {
+        *undo_out = (DealUndo){
+            .rng = state->rng,
+            .cleared_in_turn = state->cleared_in_turn,
+        };
+    }
+    state->blocks_placed = 0;
+    state->cleared_in_turn = false;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        state->held_blocks[i] = blocks[i];
+    }
+}
+
+void deal_random_blocks(GameState* state, DealUndo* undo_out) {
+    Rng rng = state->rng;
+    Block blocks[HELD_BLOCKS_N];
+    get_random_deal(&state->rng, blocks);
+    deal_blocks(state, blocks, undo_out);
+    if (undo_out) undo_out->rng = rng;
+}
+
+void undeal_blocks(GameState* state, const DealUndo* undo) {
+    state->blocks_placed = HELD_BLOCKS_N;
+    state->cleared_in_turn = undo->cleared_in_turn;
+    state->rng = undo->rng;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        state->held_blocks[i] = get_empty_block();
+    }
+}
+
+bool move_is_legal(const GameState* state, Move move) {
+    if (move.slot >= HELD_BLOCKS_N || move.cell >= FIELD_SIZE * FIELD_SIZE) {
+        return false;
+    }
+    const Block* block = &state->held_blocks[move.slot];
+    if (block->item == CELL_ITEM_EMPTY) return false;
+    const BlockMask* mask = get_block_mask(block);
+    return board_test(mask->origins, move.cell) &&
+           !(get_occupied_cells(state) & (mask->cells << move.cell));
+}
+
+int apply_move(GameState* state, Move move, PlacementUndo* undo_out) {
+    if (!move_is_legal(state, move)) return -1;
+    state->block_selected = move.slot;
+    Rng rng = state->rng;
+    int lines_cleared = make_move(state, move, undo_out);
+    if (turn_finished(state)) {
+        deal_random_blocks(state, NULL);
+        if (undo_out) {
+            undo_out->turn.dealt = true;
+            undo_out->turn.rng = rng;
+        }
+    }
+    return lines_cleared;
+}
+
+int get_legal_moves(const GameState* state, Move* moves_out) {
+    Board occupied = get_occupied_cells(state);
+    int moves_n = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        const Block* block = &state->held_blocks[slot];
+        if (block->item == CELL_ITEM_EMPTY) continue;
+        Board legal = get_legal_origins(occupied, get_block_mask(block));
+        for (; legal; legal &= legal - 1) {
+            moves_out[moves_n++] = (Move){
+                .slot = slot,
+                .cell = __builtin_ctzll(legal),
+            };
+        }
+    }
+    return moves_n;
+}
+
+bool is_game_over(const GameState* state) {
+    Board occupied = get_occupied_cells(state);
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        const Block* block = &state->held_blocks[slot];
+        if (block->item == CELL_ITEM_EMPTY) continue;
+        if (get_legal_origins(occupied, get_block_mask(block))) return false;
+    }
+    return true;
+}
@@ -0,0 +1,163 @@
+#if !defined(GAME_H)
+#define GAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "block.h"
+#include "constants.h"
+#include "rng.h"
+
+#define MAX_MOVES_N (HELD_BLOCKS_N * FIELD_SIZE * FIELD_SIZE)
+
+typedef struct GameState {
+    Board field[CELL_COLORS_N];  // cells of each color, indexed by item - 1
+    int points;
+    int combo;
+    int blocks_placed;
+    int block_selected;
+    Block held_blocks[HELD_BLOCKS_N];
+    bool cleared_in_turn;
+    Rng rng;
+} GameState;
+
+// a placement of one of the held blocks, independent of the mouse snapping
+// done by the gui
+typedef struct Move {
+    uint8_t slot;  // index into held_blocks
+    uint8_t cell;  // field index of the top left corner of the placed block
+} Move;
+
+// what a placement changed outside the field, the same for every field
+// size. PlacementUndo and the gui's WidePlacementUndo both end with it and
+// take it back with undo_turn
+typedef struct TurnUndo {
+    int32_t points;
+    int32_t combo;
+    PackedBlock block;  // the placed block
+    uint8_t slot;
+    uint8_t blocks_placed;
+    uint8_t block_selected;
+    bool cleared_in_turn;
+    // set when the placement also dealt new blocks, see apply_move
+    bool dealt;
+    Rng rng;  // state before the deal
+} TurnUndo;
+
+// what a placement changed, enough to take it back without keeping a copy of
+// the whole GameState around
+typedef struct PlacementUndo {
+    Board placed;
+    // cleared cells per color, the colors are needed to put them back
+    Board cleared[CELL_COLORS_N];
+    TurnUndo turn;
+} PlacementUndo;
+
+typedef struct DealUndo {
+    Rng rng;
+    bool cleared_in_turn;
+} DealUndo;
+
+// the blocks of one deal, drawn the way every game draws them
+void get_random_deal(Rng* rng, Block* blocks_out);
+GameState make_gamestate(uint64_t seed);
+
+static inline Board get_occupied_cells(const GameState* state) {
+    Board occupied = 0;
+    for (int i = 0; i < CELL_COLORS_N; ++i) occupied |= state->field[i];
+    return occupied;
+}
+
+FieldCellItem get_field_cell(const GameState* state, int index);
+
+// the scoring and combo rules, shared with the batched environment
+
+// a line is worth as many points as it has cells
+static inline int get_sized_clear_points(int lines_cleared, int combo,
+                                         int size) {
+    int points_earned = lines_cleared * size;
+    return points_earned * lines_cleared * combo;
+}
+
+static inline int get_clear_points(int lines_cleared, int combo) {
+    return get_sized_clear_points(lines_cleared, combo, FIELD_SIZE);
+}
+
+// the combo grows with every clearing placement and drops back to 1 after a
+// turn without any clear
+static inline int get_next_combo(int combo, bool cleared, bool cleared_in_turn,
+                                 bool turn_done) {
+    if (cleared) return combo + 1;
+    if (!cleared_in_turn && turn_done) return 1;
+    return combo;
+}
+
+// the points and combo after a placement cleared lines_cleared lines of a
+// field of size, the one place both GameState and the gui's WideState
+// score with. returns the points earned
+static inline int score_placement(int lines_cleared, int size, bool turn_done,
+                                  int* points, int* combo,
+                                  bool* cleared_in_turn) {
+    int points_earned = get_sized_clear_points(lines_cleared, *combo, size);
+    bool cleared = points_earned > 0;
+    *combo = get_next_combo(*combo, cleared, *cleared_in_turn, turn_done);
+    *cleared_in_turn |= cleared;
+    *points += points_earned;
+    return points_earned;
+}
+
+// puts back the held blocks, the counters and, if the placement dealt, the
+// rng. returns the placed block, whose cells the caller takes off the field
+static inline Block undo_turn(const TurnUndo* undo, Block* held_blocks,
+                              Rng* rng, int* points, int* combo,
+                              int* blocks_placed, int* block_selected,
+                              bool* cleared_in_turn) {
+    Block block = unpack_block(undo->block);
+    if (undo->dealt) {
+        // every slot was used up by the end of the turn
+        for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+            held_blocks[i] = get_empty_block();
+        }
+        *rng = undo->rng;
+    }
+    held_blocks[undo->slot] = block;
+    *points = undo->points;
+    *combo = undo->combo;
+    *blocks_placed = undo->blocks_placed;
+    *block_selected = undo->block_selected;
+    *cleared_in_turn = undo->cleared_in_turn;
+    return block;
+}
+
+// clears full rows and columns, returns the amount of points earned. the
+// cleared cells of every color are written to cleared_out if it isn't NULL
+int clear_field(Board* field, int combo, int* lines_cleared_out,
+                Board* cleared_out);
+// make_move and unmake_move place and take back a held block in place,
+// for search. the caller must pass a legal move. they never deal new blocks:
+// once the last held block is placed turn_finished is true and the chance
+// step, deal_random_blocks or deal_blocks, has to be done explicitly.
+// undo_out may be NULL for make_move and the deal functions
+int make_move(GameState* state, Move move, PlacementUndo* undo_out);
+void unmake_move(GameState* state, const PlacementUndo* undo);
+
+static inline bool turn_finished(const GameState* state) {
+    return state->blocks_placed == HELD_BLOCKS_N;
+}
+
+void deal_random_blocks(GameState* state, DealUndo* undo_out);
+void deal_blocks(GameState* state, const Block* blocks, DealUndo* undo_out);
+void undeal_blocks(GameState* state, const DealUndo* undo);
+
+bool move_is_legal(const GameState* state, Move move);
+// the full game rules: places a held block and deals new blocks at the end
+// of a turn. returns the amount of lines cleared, or -1 and leaves the
+// state untouched if the move is illegal. the undo record covers both steps
+// and is taken back with unmake_move
+int apply_move(GameState* state, Move move, PlacementUndo* undo_out);
+int get_legal_moves(const GameState* state, Move* moves_out);
+// only meaningful right after a deal, when every slot has a block
+bool is_game_over(const GameState* state);
+
+#endif  // GAME_H
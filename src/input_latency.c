@@ -0,0 +1,68 @@
+#include "input_latency.h"
+
+#include <stdio.h>
+
+// weight of the latest frame in the smoothed build time
+#define BUILD_TIME_WEIGHT 0.1
+
+void input_latency_init(InputLatency* latency, double now) {
+    *latency = (InputLatency){
+        .poll_time = now,
+        .previous_poll_time = now,
+        .swap_time = now,
+    };
+}
+
+void input_latency_polled(InputLatency* latency, double now) {
+    latency->previous_poll_time = latency->poll_time;
+    latency->poll_time = now;
+    latency->placed = false;
+}
+
+void input_latency_placed(InputLatency* latency) { latency->placed = true; }
+
+void input_latency_built(InputLatency* latency, double now) {
+    // the time blocked in the swap isn't part of it, late polls would
+    // otherwise creep back to right after the swap
+    double build_time = now - latency->poll_time;
+    latency->build_time +=
+        (build_time - latency->build_time) * BUILD_TIME_WEIGHT;
+}
+
+bool input_latency_swapped(InputLatency* latency, double now) {
+    latency->swap_time = now;
+    if (!latency->placed) return false;
+    latency->placed = false;
+
+    double seen = now - latency->poll_time;
+    double worst = now - latency->previous_poll_time;
+    latency_histogram_add(&latency->seen, (uint64_t)(seen * 1e9));
+    latency_histogram_add(&latency->worst, (uint64_t)(worst * 1e9));
+    int bar = (int)(seen * 1e3);
+    if (bar >= INPUT_LATENCY_BARS_N) bar = INPUT_LATENCY_BARS_N - 1;
+    latency->bars[bar]++;
+    latency->last_seen = seen;
+    latency->events_n++;
+    return true;
+}
+
+double get_late_poll_time(const InputLatency* latency, double swap_time,
+                          double frame_period) {
+    double lead = latency->build_time + INPUT_LATENCY_MARGIN;
+    if (lead > frame_period) lead = frame_period;
+    return swap_time + frame_period - lead;
+}
+
+size_t format_input_latency(const InputLatency* latency, char* out,
+                            size_t size) {
+    int n = snprintf(
+        out, size,
+        "%llu placements, click to screen p50 %.1fms p99 %.1fms, "
+        "worst case p50 %.1fms p99 %.1fms",
+        (unsigned long long)latency->events_n,
+        latency_histogram_quantile(&latency->seen, 0.5) * 1e-6,
+        latency_histogram_quantile(&latency->seen, 0.99) * 1e-6,
+        latency_histogram_quantile(&latency->worst, 0.5) * 1e-6,
+        latency_histogram_quantile(&latency->worst, 0.99) * 1e-6);
+    return n > 0 ? (size_t)n : 0;
+}
@@ -0,0 +1,61 @@
+#if !defined(INPUT_LATENCY_H)
+#define INPUT_LATENCY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+// click to screen latency of block placements, from the poll of the input
+// that saw the press to the return of the swap of the first frame showing
+// the placed block. with vsync the swap waits for the display to take the
+// frame, so that is when it's on its way to the screen. raylib only polls
+// once a frame, so the press itself happened somewhere between that poll
+// and the one before, the latency from the poll before is kept too as the
+// worst case.
+//
+// late input sampling moves the poll from right after the last frame was
+// swapped to just before the next one has to be built: the frame period
+// after the last swap, less the time a frame takes to build and a margin.
+// the swap then waits out less of the frame period with the input already
+// sampled, which only pays off when the swap waits for the vsync at all.
+
+#define INPUT_LATENCY_BARS_N 40  // of a millisecond each, for the overlay
+#define INPUT_LATENCY_LOG_EVERY 50
+// kept between the late poll and the time the frame is expected to take
+#define INPUT_LATENCY_MARGIN 0.002
+
+typedef struct InputLatency {
+    // seconds, on the clock of the caller
+    double poll_time;
+    double previous_poll_time;
+    double swap_time;
+    double build_time;  // smoothed, from poll to the swap being called
+    bool placed;  // a press placed a block in the frame being built
+    uint64_t events_n;
+    double last_seen;  // seconds
+    LatencyHistogram seen;   // nanoseconds
+    LatencyHistogram worst;  // nanoseconds
+    uint32_t bars[INPUT_LATENCY_BARS_N];  // of seen, the last gets the rest
+} InputLatency;
+
+void input_latency_init(InputLatency* latency, double now);
+// the input was just polled
+void input_latency_polled(InputLatency* latency, double now);
+// a press seen in the latest poll placed a block
+void input_latency_placed(InputLatency* latency);
+// the frame is built and about to be swapped
+void input_latency_built(InputLatency* latency, double now);
+// the swap of the frame returned. true if it completed a placement, whose
+// latency is then in last_seen
+bool input_latency_swapped(InputLatency* latency, double now);
+// when the input of the next frame should be polled, for late sampling,
+// given when the last frame was swapped onto the screen
+double get_late_poll_time(const InputLatency* latency, double swap_time,
+                          double frame_period);
+// a one line summary
+size_t format_input_latency(const InputLatency* latency, char* out,
+                            size_t size);
+
+#endif  // INPUT_LATENCY_H
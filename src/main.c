@@ -1,40 +1,37 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "block.h"
 #include "constants.h"
+#include "game.h"
+#include "input_latency.h"
+#include "metrics.h"
+#include "plugin.h"
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
+#include "save.h"
+#include "scores.h"
+#include "undo.h"
 #include "vector_fns.h"
-
-typedef struct GameState {
-    FieldCellItem field[FIELD_SIZE * FIELD_SIZE];
-    int points;
-    int combo;
-    int blocks_placed;
-    int block_selected;
-    Block held_blocks[3];
-    bool cleared_in_turn;
-} GameState;
-
-GameState make_gamestate() {
-    GameState state = {
-        .points = 0,
-        .combo = 1,
-        .blocks_placed = 0,
-        .block_selected = 0,
-        .cleared_in_turn = false,
+#include "wide.h"
+
+// the field always covers FIELD_WIDTH x FIELD_HEIGHT pixels, the cells
+// shrink as the size grows
+typedef struct FieldView {
+    int size;
+    Vector2 cell_size;
+} FieldView;
+
+static FieldView make_field_view(int size) {
+    return (FieldView){
+        .size = size,
+        .cell_size = {FIELD_CELL_WIDTH_OF(size), FIELD_CELL_HEIGHT_OF(size)},
     };
-    for (int i = 0; i < FIELD_SIZE * FIELD_SIZE; ++i) {
-        state.field[i] = CELL_ITEM_EMPTY;
-    }
-
-    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
-        state.held_blocks[i] = get_random_block();
-    }
-    return state;
 }
 
 static inline float apply_board_offset(float v) {
@@ -45,35 +42,36 @@ static inline Vector2 apply_board_offset_v(Vector2 v) {
     return (Vector2){apply_board_offset(v.x), apply_board_offset(v.y)};
 }
 
-Vector2 project_mouse_on_board(Vector2 field_pos, Vector2 mouse_pos) {
+Vector2 project_mouse_on_board(const FieldView* view, Vector2 field_pos,
+                               Vector2 mouse_pos) {
     Vector2 norm_mouse_pos = Vector2Subtract(mouse_pos, field_pos);
     Vector2 coords = Vector2Divide(
-        norm_mouse_pos, (Vector2){(FIELD_CELL_WIDTH + FIELD_BORDER_THICKNESS),
-                                  FIELD_CELL_HEIGHT + FIELD_BORDER_THICKNESS});
+        norm_mouse_pos,
+        Vector2AddValue(view->cell_size, FIELD_BORDER_THICKNESS));
 
     return coords;
 }
 
-Vector2 translate_board_coords(Vector2 field_pos, Vector2 coords) {
+Vector2 translate_board_coords(const FieldView* view, Vector2 field_pos,
+                               Vector2 coords) {
     Vector2 additional_offset = Vector2Scale(coords, FIELD_BORDER_THICKNESS);
     return Vector2Add(
         Vector2Add(apply_board_offset_v(field_pos), additional_offset),
-        Vector2Multiply(coords,
-                        (Vector2){FIELD_CELL_WIDTH, FIELD_CELL_HEIGHT}));
+        Vector2Multiply(coords, view->cell_size));
 }
 
-void draw_field_cell(Vector2 pos, Color color, bool transparent) {
+void draw_field_cell(const FieldView* view, Vector2 pos, Color color,
+                     bool transparent) {
     Color mod_color = ColorAlpha(color, transparent ? 0.5f : 1.0f);
 
-    DrawRectangleV(pos, (Vector2){BLOCK_CELL_WIDTH, BLOCK_CELL_HEIGHT},
-                   ColorBrightness(mod_color, -0.225f));
+    DrawRectangleV(pos, view->cell_size, ColorBrightness(mod_color, -0.225f));
 }
 
-void draw_block_cell(Vector2 pos, Color color, bool transparent, float scale) {
+void draw_block_cell(const FieldView* view, Vector2 pos, Color color,
+                     bool transparent, float scale) {
     Color mod_color = ColorAlpha(color, transparent ? 0.5f : 1.0f);
 
-    Vector2 cell_size =
-        Vector2Scale((Vector2){BLOCK_CELL_WIDTH, BLOCK_CELL_HEIGHT}, scale);
+    Vector2 cell_size = Vector2Scale(view->cell_size, scale);
 
     DrawRectangleV(pos, cell_size, ColorBrightness(mod_color, -0.3f));
     DrawRectangleV(
@@ -89,98 +87,51 @@ void draw_block_cell(Vector2 pos, Color color, bool transparent, float scale) {
         ColorBrightness(mod_color, -0.075f));
 }
 
-void draw_block(const Block* block, Vector2 pos, bool transparent,
-                float scale) {
+void draw_block(const FieldView* view, const Block* block, Vector2 pos,
+                bool transparent, float scale) {
     if (block->item == CELL_ITEM_EMPTY) return;
 
+    Vector2 cell_step = Vector2Scale(
+        Vector2AddValue(view->cell_size, FIELD_BORDER_THICKNESS), scale);
     CellCoords cell_coords = get_shape_coords(block->shape);
     for (int i = 0; i < cell_coords.len; ++i) {
         draw_block_cell(
-            Vector2Add(
-                pos,
-                Vector2Multiply(
-                    get_block_cell_coord(block, i),
-                    (Vector2){
-                        (BLOCK_CELL_WIDTH + FIELD_BORDER_THICKNESS) * scale,
-                        (BLOCK_CELL_HEIGHT + FIELD_BORDER_THICKNESS) * scale})),
+            view,
+            Vector2Add(pos,
+                       Vector2Multiply(get_block_cell_coord(block, i),
+                                       cell_step)),
             get_field_cell_color(block->item), transparent, scale);
     }
 }
 
-void draw_field(FieldCellItem* field, int root_x, int root_y) {
+void draw_field(const FieldView* view, const WideState* state, int root_x,
+                int root_y) {
     DrawRectangle(root_x, root_y, FIELD_WIDTH, FIELD_HEIGHT,
                   FIELD_BORDER_COLOR);
-    for (int i = 0; i < FIELD_SIZE * FIELD_SIZE; ++i) {
+    int size = view->size;
+    for (int i = 0; i < size * size; ++i) {
         Vector2 cell_pos = (Vector2){
             apply_board_offset(root_x) +
-                (i % FIELD_SIZE) * (FIELD_CELL_WIDTH + FIELD_BORDER_THICKNESS),
+                (i % size) * (view->cell_size.x + FIELD_BORDER_THICKNESS),
             apply_board_offset(root_y) +
-                (i / FIELD_SIZE) *
-                    (FIELD_CELL_HEIGHT + FIELD_BORDER_THICKNESS)};
-        Color color = get_field_cell_color(field[i]);
-        if (field[i] == CELL_ITEM_EMPTY) {
-            draw_field_cell(cell_pos, color, false);
+                (i / size) * (view->cell_size.y + FIELD_BORDER_THICKNESS)};
+        FieldCellItem item = get_wide_field_cell(state, i);
+        Color color = get_field_cell_color(item);
+        if (item == CELL_ITEM_EMPTY) {
+            draw_field_cell(view, cell_pos, color, false);
         } else {
-            draw_block_cell(cell_pos, color, false, 1.0f);
+            draw_block_cell(view, cell_pos, color, false, 1.0f);
         }
     }
 }
 
-void set_field_row(FieldCellItem* field, int row, FieldCellItem item) {
-    assert(row >= 0 && row < FIELD_SIZE);
-    for (int i = 0; i < FIELD_SIZE; ++i) {
-        field[row * FIELD_SIZE + i] = item;
-    }
-}
-
-void set_field_col(FieldCellItem* field, int col, FieldCellItem item) {
-    assert(col >= 0 && col < FIELD_SIZE);
-    for (int i = 0; i < FIELD_SIZE; ++i) {
-        field[i * FIELD_SIZE + col] = item;
-    }
-}
-
-// returns the amount of points earned
-int clear_field(FieldCellItem* field, int combo) {
-    int lines_cleared = 0;
-    int points_earned = 0;
-
-    for (int i = 0; i < FIELD_SIZE; ++i) {
-        int line_count_x = 0;
-        int line_count_y = 0;
-
-        for (int j = 0; j < FIELD_SIZE; ++j) {
-            if (field[i * FIELD_SIZE + j] != CELL_ITEM_EMPTY) {
-                line_count_x++;
-            }
-        }
-        if (line_count_x == FIELD_SIZE) {
-            set_field_row(field, i, CELL_ITEM_EMPTY);
-            lines_cleared++;
-            points_earned += line_count_x;
-        }
-        for (int j = 0; j < FIELD_SIZE; ++j) {
-            if (field[j * FIELD_SIZE + i] != CELL_ITEM_EMPTY) {
-                line_count_y++;
-            }
-        }
-        if (line_count_y == FIELD_SIZE) {
-            set_field_col(field, i, CELL_ITEM_EMPTY);
-            lines_cleared++;
-            points_earned += line_count_y;
-        }
-        line_count_x = 0;
-        line_count_y = 0;
-    }
-    return points_earned * lines_cleared * combo;
-}
-
 static inline int wrapping_mod(int n, int M) { return ((n % M) + M) % M; }
 
-Vector2 snap_mouse_coords(Vector2 mouse_field_coords, const Block* block) {
+Vector2 snap_mouse_coords(const FieldView* view, Vector2 mouse_field_coords,
+                          const Block* block) {
     Vector2 projected_mouse_coords = Vector2Scale(
-        Vector2SubtractValue(mouse_field_coords, FIELD_SIZE / 2.0f),
-        2.0f / FIELD_SIZE);
+        Vector2SubtractValue(mouse_field_coords, view->size / 2.0f),
+        2.0f / view->size);
 
     BlockAlignmentType alignment_type = get_block_alignment(block);
     Vector2 offset = Vector2Zero();
@@ -191,10 +142,14 @@ Vector2 snap_mouse_coords(Vector2 mouse_field_coords, const Block* block) {
         case BLOCK_ALIGNMENT_TYPE_CORNER:
             // nothing
             break;
-        case BLOCK_ALIGNMENT_TYPE_EDGE:
-            offset = block->rotation % 2 == 0 ? (Vector2){0.5, 0.}
+        case BLOCK_ALIGNMENT_TYPE_EDGE: {
+            // the axis whose cells sit between grid lines snaps to a cell
+            // centre
+            Vector2 cell = get_block_cell_coord(block, 0);
+            offset = roundf(cell.x) != cell.x ? (Vector2){0.5, 0.}
                                               : (Vector2){0., 0.5};
             break;
+        }
     }
     if (projected_mouse_coords.x < 0) offset.x = -offset.x;
     if (projected_mouse_coords.y < 0) offset.y = -offset.y;
@@ -205,90 +160,332 @@ Vector2 snap_mouse_coords(Vector2 mouse_field_coords, const Block* block) {
     return rounded;
 }
 
-void handle_block_placement(GameState* state, Vector2 mouse_coords) {
-    const Block* held_block = &state->held_blocks[state->block_selected];
-    state->blocks_placed++;
+#define TARGET_FPS 60  // when the refresh rate of the monitor is unknown
+// a swap that took longer waited for the vsync, which paced the frame
+#define SWAP_PACED_MIN 0.0005
+
+// frames between two placements of the auto player, slow enough to follow
+#define AUTO_PLAY_FRAMES 20
+
+// the game in progress, restored at startup
+#define SAVE_PATH "rectangle_mangle.sav"
+// changes within this many seconds of each other are saved together
+#define AUTOSAVE_DELAY 0.5
+// every field size has a leaderboard of its own
+#define SCORES_PATH_FORMAT "rectangle_mangle_%d.scores"
+#define SCORES_CAPACITY 10000
+
+// undo_history_apply, with the placement recorded in the metrics
+static int apply_placement(UndoHistory* history, WideState* state,
+                           Move move) {
+    int combo = state->combo;
+    int lines_cleared = undo_history_apply(history, state, move);
+    if (lines_cleared < 0) return lines_cleared;
+    metrics_count(METRIC_PLACEMENTS, 1);
+    metrics_count(METRIC_LINES_CLEARED, lines_cleared);
+    if (combo > 1 && state->combo == 1) {
+        metrics_observe(METRIC_COMBO_LENGTH, combo);
+    }
+    return lines_cleared;
+}
 
-    CellCoords cell_coords = get_shape_coords(held_block->shape);
-    // placing the block into the field
-    for (int i = 0; i < cell_coords.len; ++i) {
-        Vector2 cell_pos =
-            Vector2Add(mouse_coords, get_block_cell_coord(held_block, i));
-        int index = vector_field_index(cell_pos);
-        state->field[index] = held_block->item;
+// one placement of the plugin, false if it can't or won't make one. the
+// plugin only knows the 8x8 field
+static bool auto_play_move(PolicyPlugin* plugin, void* instance,
+                           UndoHistory* history, WideState* state) {
+    GameState narrow;
+    if (!get_narrow_state(state, &narrow)) return false;
+    RmGameView game_view;
+    make_game_view(&narrow, 0, &game_view);
+    if (!game_view_has_moves(&game_view)) return false;
+    RmMove move;
+    policy_plugin_decide(plugin, instance, &game_view, 1, &move);
+    if (apply_placement(history, state,
+                        (Move){.slot = move.slot, .cell = move.cell}) < 0) {
+        atomic_fetch_add(&plugin->illegal_n, 1);
+        return false;
     }
+    return true;
+}
 
-    // field clearing and adding points
-    int points_obtained = clear_field(state->field, state->combo);
+// points, combo and the held block previews at the bottom
+static void draw_hud(const WideState* state, int screen_width, int board_y) {
+    char points_buf[32];
+    sprintf(points_buf, "Points: %d", state->points);
 
-    bool increase_combo = false;
-    if (points_obtained > 0) {
-        state->cleared_in_turn = true;
-        increase_combo = true;
-    }
+    char combo_buf[32];
+    sprintf(combo_buf, "Combo: %d", state->combo);
+
+    DrawText(points_buf, 20, 20, 30, BLACK);
+    DrawText(combo_buf, 20 + 20 + MeasureText(points_buf, 30), 20, 30, BLACK);
 
-    if (increase_combo) {
-        state->combo += 1;
-    } else if (!state->cleared_in_turn && state->blocks_placed == 3) {
-        state->combo = 1;
+    // small block previews on the bottom
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        Vector2 pos = {
+            (screen_width / (HELD_BLOCKS_N + 1)) * (i + 1),
+            board_y + FIELD_HEIGHT + 100,
+        };
+        // the previews keep the 8x8 cell size whatever the field size
+        FieldView preview_view = make_field_view(FIELD_SIZE);
+        draw_block(&preview_view, &state->held_blocks[i], pos, false, 0.5f);
+        if (state->block_selected == i) {
+            int size = 175;
+            Rectangle rec = {
+                .x = pos.x - size / 2,
+                .y = pos.y - size / 2,
+                .height = size,
+                .width = size,
+            };
+            DrawRectangleLinesEx(rec, 6.f, DARKPURPLE);
+        }
     }
+}
 
-    // held blocks handling
-    if (state->blocks_placed == 3) {
-        state->blocks_placed = 0;
-        state->cleared_in_turn = false;
-        for (int i = 0; i < HELD_BLOCKS_N; ++i) {
-            state->held_blocks[i] = get_random_block();
+// the hud only changes with a placement or a new selection, so it's drawn
+// into a layer once and the layer is copied to the screen every frame. the
+// layer has the screen's coordinates, the strips above and below the field
+// are copied
+typedef struct HudLayer {
+    RenderTexture2D target;
+    bool valid;
+    // what the layer was drawn from
+    int points;
+    int combo;
+    PackedBlock held_blocks[HELD_BLOCKS_N];
+    int block_selected;
+    uint64_t rebuilds_n;
+} HudLayer;
+
+static bool hud_layer_is_current(const HudLayer* layer,
+                                 const WideState* state) {
+    if (!layer->valid || layer->points != state->points ||
+        layer->combo != state->combo ||
+        layer->block_selected != state->block_selected) {
+        return false;
+    }
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        if (layer->held_blocks[i] != pack_block(&state->held_blocks[i])) {
+            return false;
         }
-    } else {
-        state->held_blocks[state->block_selected] = get_empty_block();
     }
+    return true;
+}
 
-    state->points += points_obtained;
+static void rebuild_hud_layer(HudLayer* layer, const WideState* state,
+                              int screen_width, int board_y) {
+    BeginTextureMode(layer->target);
+    // opaque, so the text isn't blended twice
+    ClearBackground(RAYWHITE);
+    draw_hud(state, screen_width, board_y);
+    EndTextureMode();
+
+    layer->valid = true;
+    layer->points = state->points;
+    layer->combo = state->combo;
+    layer->block_selected = state->block_selected;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        layer->held_blocks[i] = pack_block(&state->held_blocks[i]);
+    }
+    layer->rebuilds_n++;
 }
 
-bool get_fuzzy_block_placement(const GameState* state, Vector2 location,
-                               Vector2 grid_clamped_location,
-                               Vector2* fuzzy_location_out) {
-    const Block* held_block = &state->held_blocks[state->block_selected];
-
-    int starting_dx = location.x < 4.0f ? -1 : 1;
-    int ddx = location.x < 4.0f ? 1 : -1;
-
-    int starting_dy = location.y < 4.0f ? -1 : 1;
-    int ddy = location.y < 4.0f ? 1 : -1;
-
-    for (int dx = starting_dx; abs(dx - starting_dx) < 3; dx += ddx) {
-        for (int dy = starting_dy; abs(dy - starting_dy) < 3; dy += ddy) {
-            Vector2 new_location =
-                Vector2Add(grid_clamped_location, (Vector2){dx, dy});
-            if (vector_in_field_bounds(new_location) &&
-                placed_block_space_free(state->field, new_location,
-                                        held_block)) {
-                *fuzzy_location_out = new_location;
-                return true;
-            }
-        }
+static void draw_hud_layer(const HudLayer* layer, int screen_width,
+                           int screen_height, int board_y) {
+    Rectangle strips[] = {
+        {0, 0, screen_width, board_y},
+        {0, board_y + FIELD_HEIGHT, screen_width,
+         screen_height - board_y - FIELD_HEIGHT},
+    };
+    for (int i = 0; i < 2; ++i) {
+        // render textures are upside down
+        Rectangle source = {
+            .x = strips[i].x,
+            .y = screen_height - strips[i].y - strips[i].height,
+            .width = strips[i].width,
+            .height = -strips[i].height,
+        };
+        DrawTextureRec(layer->target.texture, source,
+                       (Vector2){strips[i].x, strips[i].y}, WHITE);
+    }
+}
+
+// the latency of the placements so far and a bar of each millisecond
+static void draw_latency_overlay(const InputLatency* latency, bool late_input,
+                                 bool hud_caching, int x, int y) {
+    char summary[256];
+    format_input_latency(latency, summary, sizeof(summary));
+    DrawText(summary, x, y, 10, DARKGRAY);
+    DrawText(TextFormat("frames built in %.2fms, late input sampling %s (L), "
+                        "hud layer %s (H)",
+                        latency->build_time * 1e3, late_input ? "on" : "off",
+                        hud_caching ? "on" : "off"),
+             x, y + 14, 10, DARKGRAY);
+
+    const int bar_width = 4;
+    const int bars_height = 40;
+    uint32_t max_count = 1;
+    for (int i = 0; i < INPUT_LATENCY_BARS_N; ++i) {
+        if (latency->bars[i] > max_count) max_count = latency->bars[i];
+    }
+    int bars_y = y + 28;
+    for (int i = 0; i < INPUT_LATENCY_BARS_N; ++i) {
+        int height =
+            (int)((uint64_t)latency->bars[i] * bars_height / max_count);
+        DrawRectangle(x + i * bar_width, bars_y + bars_height - height,
+                      bar_width - 1, height, DARKPURPLE);
     }
-    return false;
+    DrawText(TextFormat("0-%dms", INPUT_LATENCY_BARS_N),
+             x + INPUT_LATENCY_BARS_N * bar_width + 6,
+             bars_y + bars_height - 10, 10, DARKGRAY);
 }
 
-int main(void) {
+int main(int argc, char** argv) {
     const int screenWidth = 800;
     const int screenHeight = 800;
 
-    InitWindow(screenWidth, screenHeight, "rectangle mangle");
-
-    SetTargetFPS(60);
+    // the field size is picked once, every game of the session uses it.
+    // without one the saved game picks it
+    int field_size = argc > 1 ? atoi(argv[1]) : 0;
+    if (argc > 1 &&
+        (field_size < FIELD_SIZE_MIN || field_size > FIELD_SIZE_MAX)) {
+        fprintf(stderr, "field size must be from %d to %d\n", FIELD_SIZE_MIN,
+                FIELD_SIZE_MAX);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+    init_wide_geometries();
+
+    // the game left off last time, unless it was on another field size
+    WideState saved_state;
+    uint64_t saved_seed;
+    bool restored =
+        load_save(SAVE_PATH, &saved_state, &saved_seed) &&
+        (field_size == 0 || saved_state.geometry->size == field_size);
+    if (field_size == 0) {
+        field_size = restored ? saved_state.geometry->size : FIELD_SIZE;
+    }
+    FieldView view = make_field_view(field_size);
+
+    // an optional plugin:<path>[:<args>] plays when A is pressed
+    PolicyPlugin plugin = {0};
+    void* plugin_instance = NULL;
+    if (argc > 2) {
+        char error[256];
+        if (!policy_plugin_open(&plugin, argv[2], error, sizeof(error))) {
+            fprintf(stderr, "%s\n", error);
+            return 1;
+        }
+        plugin_instance = policy_plugin_create(&plugin, (uint64_t)time(NULL));
+        if (!plugin_instance) {
+            fprintf(stderr, "%s failed to start\n", plugin.path);
+            return 1;
+        }
+        if (field_size != FIELD_SIZE) {
+            fprintf(stderr, "auto play needs the %dx%d field\n", FIELD_SIZE,
+                    FIELD_SIZE);
+        }
+    }
+    bool auto_playing = false;
+    int auto_play_frame = 0;
 
-    GameState state = make_gamestate();
+    // the swap waits for the display, so the latencies run to the screen
+    // and late input sampling has slack to take
+    SetConfigFlags(FLAG_VSYNC_HINT);
+    InitWindow(screenWidth, screenHeight, "rectangle mangle");
+    // frames are swapped and paced here rather than by EndDrawing, so the
+    // time of the swap can be taken and the input polled late. EndDrawing
+    // polls right after its swap, and polling twice loses the presses of
+    // the first poll, so it isn't called at all: the bundled raylib isn't
+    // built with SUPPORT_CUSTOM_FRAME_CONTROL, under which EndDrawing leaves
+    // the swap and the poll to the caller. without it GetFrameTime and
+    // GetFPS don't advance and there's no gif recording, F12 screenshots
+    // are taken below instead
+    int refresh_rate = GetMonitorRefreshRate(GetCurrentMonitor());
+    double frame_period = 1.0 / (refresh_rate > 0 ? refresh_rate : TARGET_FPS);
+
+    Rng seed_rng = make_rng((uint64_t)time(NULL));
+    uint64_t game_seed = restored ? saved_seed : rng_next(&seed_rng);
+    WideState state =
+        restored ? saved_state : make_wide_state(field_size, game_seed);
+    UndoHistory history;
+    undo_history_clear(&history);
+
+    Autosaver autosaver;
+    bool autosaving = autosaver_start(&autosaver, SAVE_PATH, AUTOSAVE_DELAY);
+    if (!autosaving) fprintf(stderr, "failed to start autosaving\n");
+    // the bytes last handed to the autosaver, an unchanged game isn't
+    // saved again
+    uint8_t save_data[SAVE_SIZE_MAX];
+    uint8_t saved_data[SAVE_SIZE_MAX];
+    size_t saved_size = encode_save(&state, game_seed, saved_data);
+
+    static ScoreStore scores;
+    bool scoring = scores_open(
+        &scores, TextFormat(SCORES_PATH_FORMAT, field_size), SCORES_CAPACITY);
+    if (!scoring) fprintf(stderr, "failed to open the leaderboard\n");
+    // a finished game is put on disk off the render thread
+    ScoresFlusher scores_flusher;
+    bool flushing =
+        scoring && scores_flusher_start(&scores_flusher, &scores);
+    // a game is finished once, when it's first over. a game saved over was
+    // already scored before it was saved. 0 if it didn't make the
+    // leaderboard
+    bool game_finished = restored && wide_is_game_over(&state);
+    uint64_t game_rank = 0;
+    if (!restored) metrics_count(METRIC_GAMES_STARTED, 1);
+
+    MetricsExporter metrics_exporter;
+    bool exporting = metrics_exporter_start_from_env(&metrics_exporter);
+
+    // L switches to late input sampling, F3 shows the latencies
+    static InputLatency input_latency;
+    input_latency_init(&input_latency, GetTime());
+    bool late_input = false;
+    bool show_latency = false;
+    double swap_time = GetTime();
+    double frame_start = swap_time;
+    bool swap_paced = false;
+    int screenshots_n = 0;
+
+    // H draws the hud every frame instead, to compare
+    HudLayer hud_layer = {.target = LoadRenderTexture(screenWidth,
+                                                      screenHeight)};
+    bool hud_caching = IsRenderTextureValid(hud_layer.target);
 
     int board_x = 150;
     int board_y = 65;
 
     while (!WindowShouldClose()) {
+        // right after the swap, as EndDrawing does, or as late as the next
+        // frame can still be built in time for the vsync. without a vsync
+        // the swap returns right away and the frames are paced here
+        double poll_time =
+            late_input  ? get_late_poll_time(&input_latency, swap_time,
+                                             frame_period)
+            : swap_paced ? swap_time
+                         : frame_start + frame_period;
+        double wait = poll_time - GetTime();
+        if (wait > 0) WaitTime(wait);
+        frame_start = GetTime();
+        PollInputEvents();
+        input_latency_polled(&input_latency, frame_start);
+
         Vector2 mouse_field_coords = project_mouse_on_board(
-            (Vector2){board_x, board_y}, GetMousePosition());
+            &view, (Vector2){board_x, board_y}, GetMousePosition());
+
+        bool ctrl_down =
+            IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+        bool shift_down =
+            IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+        if (ctrl_down && IsKeyPressed(KEY_Z)) {
+            if (shift_down) {
+                undo_history_redo(&history, &state);
+            } else {
+                undo_history_undo(&history, &state);
+            }
+        } else if (ctrl_down && IsKeyPressed(KEY_Y)) {
+            undo_history_redo(&history, &state);
+        }
 
         float wheel = GetMouseWheelMove();
         int block_delta = (int)wheel;
@@ -304,97 +501,193 @@ int main(void) {
         }
 
         if (IsKeyPressed(KEY_R)) {
-            state = make_gamestate();
+            game_seed = rng_next(&seed_rng);
+            state = make_wide_state(field_size, game_seed);
+            undo_history_clear(&history);
+            game_finished = false;
+            game_rank = 0;
+            metrics_count(METRIC_GAMES_STARTED, 1);
+        }
+
+        if (IsKeyPressed(KEY_L)) late_input = !late_input;
+        if (IsKeyPressed(KEY_F3)) show_latency = !show_latency;
+        if (IsKeyPressed(KEY_H)) {
+            hud_caching =
+                !hud_caching && IsRenderTextureValid(hud_layer.target);
+            hud_layer.valid = false;
+        }
+
+        if (plugin_instance && IsKeyPressed(KEY_A)) {
+            auto_playing = !auto_playing && field_size == FIELD_SIZE;
+            auto_play_frame = 0;
+        }
+        if (auto_playing && ++auto_play_frame >= AUTO_PLAY_FRAMES) {
+            auto_play_frame = 0;
+            auto_playing =
+                auto_play_move(&plugin, plugin_instance, &history, &state);
         }
 
         Block held_block = state.held_blocks[state.block_selected];
 
         if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) &&
-            vector_in_field_bounds(mouse_field_coords) &&
+            vector_in_sized_field_bounds(mouse_field_coords, field_size) &&
             held_block.item != CELL_ITEM_EMPTY) {
-            Vector2 clamped_mouse_coords = clamp_block_pos_to_field(
-                snap_mouse_coords(mouse_field_coords, &held_block),
-                &held_block);
+            Vector2 clamped_mouse_coords = clamp_block_pos_to_sized_field(
+                snap_mouse_coords(&view, mouse_field_coords, &held_block),
+                &held_block, field_size);
             Vector2 fuzzy_placement;
-            if (placed_block_space_free(state.field, clamped_mouse_coords,
-                                        &held_block)) {
-                handle_block_placement(&state, clamped_mouse_coords);
-            } else if (get_fuzzy_block_placement(&state, mouse_field_coords,
-                                                 clamped_mouse_coords,
-                                                 &fuzzy_placement)) {
-                handle_block_placement(&state, fuzzy_placement);
+            int placed = -1;
+            if (wide_block_space_free(&state, clamped_mouse_coords,
+                                      &held_block)) {
+                placed = apply_placement(
+                    &history, &state,
+                    get_wide_move(&state, &held_block, state.block_selected,
+                                  clamped_mouse_coords));
+            } else if (get_wide_fuzzy_block_placement(
+                           &state, mouse_field_coords, clamped_mouse_coords,
+                           &fuzzy_placement)) {
+                placed = apply_placement(
+                    &history, &state,
+                    get_wide_move(&state, &held_block, state.block_selected,
+                                  fuzzy_placement));
+                metrics_count(METRIC_FUZZY_PLACEMENTS, 1);
+            }
+            if (placed >= 0) input_latency_placed(&input_latency);
+        }
+
+        bool game_over = wide_is_game_over(&state);
+        if (game_over && !game_finished) {
+            game_finished = true;
+            metrics_count(METRIC_GAMES_FINISHED, 1);
+            if (scoring) {
+                game_rank = scores_add(&scores, state.points, game_seed,
+                                       SCORES_NO_REPLAY, (int64_t)time(NULL));
+                if (flushing) scores_flusher_request(&scores_flusher);
             }
         }
 
-        char points_buf[32];
-        sprintf(points_buf, "Points: %d", state.points);
+        size_t save_size = encode_save(&state, game_seed, save_data);
+        if (autosaving && (save_size != saved_size ||
+                           memcmp(save_data, saved_data, save_size) != 0)) {
+            autosaver_submit(&autosaver, save_data, save_size);
+            memcpy(saved_data, save_data, save_size);
+            saved_size = save_size;
+        }
 
-        char combo_buf[32];
-        sprintf(combo_buf, "Combo: %d", state.combo);
+        if (hud_caching && !hud_layer_is_current(&hud_layer, &state)) {
+            rebuild_hud_layer(&hud_layer, &state, screenWidth, board_y);
+        }
 
         BeginDrawing();
 
         ClearBackground(RAYWHITE);
-        draw_field(state.field, board_x, board_y);
+        draw_field(&view, &state, board_x, board_y);
 
-        DrawText(points_buf, 20, 20, 30, BLACK);
-        DrawText(combo_buf, 20 + 20 + MeasureText(points_buf, 30), 20, 30,
-                 BLACK);
-
-        // small block previews on the bottom
-        for (int i = 0; i < HELD_BLOCKS_N; ++i) {
-            Vector2 pos = {
-                (screenWidth / (HELD_BLOCKS_N + 1)) * (i + 1),
-                board_y + FIELD_CELL_HEIGHT * FIELD_SIZE + 100,
-            };
-            draw_block(&state.held_blocks[i], pos, false, 0.5f);
-            if (state.block_selected == i) {
-                int size = 175;
-                Rectangle rec = {
-                    .x = pos.x - size / 2,
-                    .y = pos.y - size / 2,
-                    .height = size,
-                    .width = size,
-                };
-                DrawRectangleLinesEx(rec, 6.f, DARKPURPLE);
-            }
+        if (hud_caching) {
+            draw_hud_layer(&hud_layer, screenWidth, screenHeight, board_y);
+        } else {
+            draw_hud(&state, screenWidth, board_y);
+        }
+        if (auto_playing) {
+            DrawText(TextFormat("auto: %s", plugin.api->name), 20, 60, 20,
+                     DARKPURPLE);
+        }
+        ScoreRecord best;
+        if (scoring && scores_read_top(&scores, &best, 1) == 1) {
+            const char* best_text = TextFormat("Best: %d", best.score);
+            DrawText(best_text, screenWidth - 20 - MeasureText(best_text, 20),
+                     28, 20, DARKGRAY);
+        }
+        if (game_over && game_rank > 0) {
+            const char* rank_text =
+                TextFormat("Game over, #%llu", (unsigned long long)game_rank);
+            DrawText(rank_text, screenWidth - 20 - MeasureText(rank_text, 20),
+                     52, 20, DARKPURPLE);
         }
 
         // held block
-        if (vector_in_field_bounds(mouse_field_coords)) {
-            Vector2 clamped_coords_no_snap =
-                clamp_block_pos_to_field(mouse_field_coords, &held_block);
-
-            Vector2 clamped_coords_snap = clamp_block_pos_to_field(
-                snap_mouse_coords(mouse_field_coords, &held_block),
-                &held_block);
+        if (vector_in_sized_field_bounds(mouse_field_coords, field_size)) {
+            Vector2 board_pos = {board_x, board_y};
+            Vector2 clamped_coords_no_snap = clamp_block_pos_to_sized_field(
+                mouse_field_coords, &held_block, field_size);
+
+            Vector2 clamped_coords_snap = clamp_block_pos_to_sized_field(
+                snap_mouse_coords(&view, mouse_field_coords, &held_block),
+                &held_block, field_size);
             Vector2 fuzzy_coords;
             // the transparent preview of where the block will end up
-            if (placed_block_space_free(state.field, clamped_coords_snap,
-                                        &held_block)) {
-                draw_block(&held_block,
-                           translate_board_coords((Vector2){board_x, board_y},
-                                                  (clamped_coords_snap)),
+            if (wide_block_space_free(&state, clamped_coords_snap,
+                                      &held_block)) {
+                draw_block(&view, &held_block,
+                           translate_board_coords(&view, board_pos,
+                                                  clamped_coords_snap),
                            true, 1.0f);
-            } else if (get_fuzzy_block_placement(&state, mouse_field_coords,
-                                                 clamped_coords_snap,
-                                                 &fuzzy_coords)) {
-                draw_block(&held_block,
-                           translate_board_coords((Vector2){board_x, board_y},
-                                                  (fuzzy_coords)),
+            } else if (get_wide_fuzzy_block_placement(
+                           &state, mouse_field_coords, clamped_coords_snap,
+                           &fuzzy_coords)) {
+                draw_block(&view, &held_block,
+                           translate_board_coords(&view, board_pos,
+                                                  fuzzy_coords),
                            true, 1.0f);
             }
 
             // the non transparent block the player is holding with their mouse
-            draw_block(&held_block,
-                       translate_board_coords((Vector2){board_x, board_y},
-                                              (clamped_coords_no_snap)),
+            draw_block(&view, &held_block,
+                       translate_board_coords(&view, board_pos,
+                                              clamped_coords_no_snap),
                        false, 1.0f);
         }
 
-        EndDrawing();
+        if (show_latency) {
+            draw_latency_overlay(&input_latency, late_input, hud_caching,
+                                 20, screenHeight - 80);
+        }
+
+        // everything is drawn before the build is timed
+        rlDrawRenderBatchActive();
+        if (IsKeyPressed(KEY_F12)) {
+            TakeScreenshot(TextFormat("screenshot%03i.png", screenshots_n++));
+        }
+        double built_time = GetTime();
+        input_latency_built(&input_latency, built_time);
+        SwapScreenBuffer();
+        double previous_swap_time = swap_time;
+        swap_time = GetTime();
+        swap_paced = swap_time - built_time > SWAP_PACED_MIN;
+        metrics_observe(METRIC_FRAME_TIME,
+                        (uint64_t)((swap_time - previous_swap_time) * 1e9));
+        if (input_latency_swapped(&input_latency, swap_time)) {
+            metrics_observe(METRIC_INPUT_LATENCY,
+                            (uint64_t)(input_latency.last_seen * 1e9));
+            if (input_latency.events_n % INPUT_LATENCY_LOG_EVERY == 0) {
+                char summary[256];
+                format_input_latency(&input_latency, summary,
+                                     sizeof(summary));
+                printf("%s\n", summary);
+            }
+        }
     }
 
+    if (IsRenderTextureValid(hud_layer.target)) {
+        UnloadRenderTexture(hud_layer.target);
+    }
     CloseWindow();
+    // the last changes are written before the process goes
+    if (autosaving) autosaver_stop(&autosaver);
+    if (flushing) scores_flusher_stop(&scores_flusher);
+    if (scoring) scores_close(&scores);
+    if (exporting) metrics_exporter_stop(&metrics_exporter);
+    if (input_latency.events_n > 0) {
+        char summary[256];
+        format_input_latency(&input_latency, summary, sizeof(summary));
+        printf("%s\n", summary);
+    }
+    if (plugin_instance) {
+        char stats[512];
+        format_plugin_stats(&plugin, stats, sizeof(stats));
+        printf("%s\n", stats);
+        policy_plugin_destroy(&plugin, plugin_instance);
+        policy_plugin_close(&plugin);
+    }
     return 0;
 }
\ No newline at end of file
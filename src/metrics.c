@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include "metrics.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fileio.h"
+
+#define METRICS_PREFIX "rectangle_mangle_"
+
+typedef struct CounterInfo {
+    const char* name;
+    const char* help;
+} CounterInfo;
+
+typedef struct HistogramInfo {
+    const char* name;
+    const char* help;
+    double scale;  // from the recorded unit to the exported one
+    // the buckets exported, the ones below are folded into the first
+    int first_bucket;
+    int last_bucket;
+} HistogramInfo;
+
+static const CounterInfo COUNTER_INFOS[METRIC_COUNTERS_N] = {
+    [METRIC_GAMES_STARTED] = {"games_started_total", "Games started."},
+    [METRIC_GAMES_FINISHED] = {"games_finished_total",
+                               "Games that ran out of moves."},
+    [METRIC_PLACEMENTS] = {"placements_total", "Blocks placed."},
+    [METRIC_FUZZY_PLACEMENTS] = {"fuzzy_placements_total",
+                                 "Blocks placed next to where they were "
+                                 "dropped."},
+    [METRIC_LINES_CLEARED] = {"lines_cleared_total",
+                              "Rows and columns cleared."},
+    [METRIC_REQUESTS] = {"requests_total", "Server requests answered."},
+};
+
+static const HistogramInfo HISTOGRAM_INFOS[METRIC_HISTOGRAMS_N] = {
+    [METRIC_COMBO_LENGTH] = {"combo_length", "Combos when they broke.", 1.0,
+                             1, 8},
+    // about 1ms to 1s
+    [METRIC_FRAME_TIME] = {"frame_time_seconds", "Time between frames.",
+                           1e-9, 20, 30},
+    // about 1us to 1s
+    [METRIC_REQUEST_LATENCY] = {"request_latency_seconds",
+                                "Server requests from read to reply.", 1e-9,
+                                10, 30},
+    // about 250us to 250ms
+    [METRIC_INPUT_LATENCY] = {"input_latency_seconds",
+                              "Placements from the poll that saw the click "
+                              "to the frame that shows them.",
+                              1e-9, 18, 28},
+};
+
+// the last one is shared by the threads that came too late for their own
+static MetricsShard shards[METRICS_SHARDS_MAX + 1] = {
+    [METRICS_SHARDS_MAX] = {.shared = true},
+};
+static _Atomic int shards_claimed = 0;
+
+_Thread_local MetricsShard* metrics_shard = NULL;
+
+MetricsShard* metrics_claim_shard(void) {
+    int index = atomic_fetch_add(&shards_claimed, 1);
+    if (index > METRICS_SHARDS_MAX) index = METRICS_SHARDS_MAX;
+    metrics_shard = &shards[index];
+    return metrics_shard;
+}
+
+void get_metrics_snapshot(MetricsSnapshot* snapshot) {
+    *snapshot = (MetricsSnapshot){0};
+    int shards_n = atomic_load(&shards_claimed);
+    if (shards_n > METRICS_SHARDS_MAX + 1) shards_n = METRICS_SHARDS_MAX + 1;
+    for (int s = 0; s < shards_n; ++s) {
+        MetricsShard* shard = &shards[s];
+        for (int i = 0; i < METRIC_COUNTERS_N; ++i) {
+            snapshot->counters[i] += atomic_load_explicit(
+                &shard->counters[i], memory_order_relaxed);
+        }
+        for (int i = 0; i < METRIC_HISTOGRAMS_N; ++i) {
+            for (int b = 0; b < METRICS_BUCKETS_N; ++b) {
+                uint64_t n = atomic_load_explicit(
+                    &shard->histograms[i].buckets[b], memory_order_relaxed);
+                snapshot->histograms[i].buckets[b] += n;
+                snapshot->histograms[i].count += n;
+            }
+            snapshot->histograms[i].sum += atomic_load_explicit(
+                &shard->histograms[i].sum, memory_order_relaxed);
+        }
+    }
+}
+
+size_t format_metrics(const MetricsSnapshot* snapshot, char* out,
+                      size_t size) {
+    size_t n = 0;
+#define APPEND(...)                                                        \
+    do {                                                                   \
+        int written = snprintf(out + n, n < size ? size - n : 0,          \
+                               __VA_ARGS__);                               \
+        if (written > 0) n += written;                                     \
+    } while (0)
+
+    for (int i = 0; i < METRIC_COUNTERS_N; ++i) {
+        const CounterInfo* info = &COUNTER_INFOS[i];
+        APPEND("# HELP " METRICS_PREFIX "%s %s\n", info->name, info->help);
+        APPEND("# TYPE " METRICS_PREFIX "%s counter\n", info->name);
+        APPEND(METRICS_PREFIX "%s %llu\n", info->name,
+               (unsigned long long)snapshot->counters[i]);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAMS_N; ++i) {
+        const HistogramInfo* info = &HISTOGRAM_INFOS[i];
+        APPEND("# HELP " METRICS_PREFIX "%s %s\n", info->name, info->help);
+        APPEND("# TYPE " METRICS_PREFIX "%s histogram\n", info->name);
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= info->last_bucket; ++b) {
+            cumulative += snapshot->histograms[i].buckets[b];
+            if (b < info->first_bucket) continue;
+            // the largest value of the bucket
+            APPEND(METRICS_PREFIX "%s_bucket{le=\"%.9g\"} %llu\n", info->name,
+                   (ldexp(1.0, b) - 1) * info->scale,
+                   (unsigned long long)cumulative);
+        }
+        APPEND(METRICS_PREFIX "%s_bucket{le=\"+Inf\"} %llu\n", info->name,
+               (unsigned long long)snapshot->histograms[i].count);
+        APPEND(METRICS_PREFIX "%s_sum %.9g\n", info->name,
+               snapshot->histograms[i].sum * info->scale);
+        APPEND(METRICS_PREFIX "%s_count %llu\n", info->name,
+               (unsigned long long)snapshot->histograms[i].count);
+    }
+#undef APPEND
+    return n;
+}
+
+static bool export_metrics(MetricsExporter* exporter, char* text) {
+    MetricsSnapshot snapshot;
+    get_metrics_snapshot(&snapshot);
+    size_t size = format_metrics(&snapshot, text, METRICS_TEXT_MAX);
+    return size < METRICS_TEXT_MAX &&
+           write_file_atomic(exporter->path, text, size);
+}
+
+static void* metrics_exporter_main(void* arg) {
+    MetricsExporter* exporter = arg;
+    char* text = malloc(METRICS_TEXT_MAX);
+    pthread_mutex_lock(&exporter->mutex);
+    for (;;) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        int64_t nanoseconds =
+            deadline.tv_nsec + (int64_t)(exporter->interval * 1e9);
+        deadline.tv_sec += nanoseconds / 1000000000;
+        deadline.tv_nsec = nanoseconds % 1000000000;
+        while (!exporter->stopping &&
+               pthread_cond_timedwait(&exporter->changed, &exporter->mutex,
+                                      &deadline) != ETIMEDOUT) {
+        }
+        bool stopping = exporter->stopping;
+
+        pthread_mutex_unlock(&exporter->mutex);
+        bool ok = text && export_metrics(exporter, text);
+        pthread_mutex_lock(&exporter->mutex);
+        exporter->writes_n += ok;
+        exporter->failures_n += !ok;
+        if (stopping) break;
+    }
+    pthread_mutex_unlock(&exporter->mutex);
+    free(text);
+    return NULL;
+}
+
+bool metrics_exporter_start(MetricsExporter* exporter, const char* path,
+                            double interval) {
+    *exporter = (MetricsExporter){.interval = interval};
+    if (strlen(path) >= sizeof(exporter->path)) return false;
+    strcpy(exporter->path, path);
+    pthread_mutex_init(&exporter->mutex, NULL);
+    pthread_cond_init(&exporter->changed, NULL);
+    if (pthread_create(&exporter->thread, NULL, metrics_exporter_main,
+                       exporter) != 0) {
+        pthread_mutex_destroy(&exporter->mutex);
+        pthread_cond_destroy(&exporter->changed);
+        return false;
+    }
+    return true;
+}
+
+bool metrics_exporter_start_from_env(MetricsExporter* exporter) {
+    const char* path = getenv(METRICS_FILE_ENV);
+    if (!path || !*path) return false;
+    if (!metrics_exporter_start(exporter, path, METRICS_INTERVAL)) {
+        fprintf(stderr, "failed to export metrics to %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+void metrics_exporter_stop(MetricsExporter* exporter) {
+    pthread_mutex_lock(&exporter->mutex);
+    exporter->stopping = true;
+    pthread_cond_signal(&exporter->changed);
+    pthread_mutex_unlock(&exporter->mutex);
+    pthread_join(exporter->thread, NULL);
+    pthread_mutex_destroy(&exporter->mutex);
+    pthread_cond_destroy(&exporter->changed);
+}
@@ -0,0 +1,136 @@
+#if !defined(METRICS_H)
+#define METRICS_H
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fileio.h"
+
+// process wide counters and histograms for operations. every thread records
+// into a shard of its own, padded to whole cache lines, with plain loads and
+// stores, so recording is a thread local lookup and an add with no lock and
+// no shared cache line. reading sums the shards, a value may lag behind by
+// the adds in flight but is never torn.
+//
+// the exporter thread writes them in the prometheus text format to a file
+// every so often, for the node exporter's textfile collector or anything
+// else that scrapes files. the file is replaced whole, never seen half
+// written.
+
+// names the file the programs export their metrics to, nothing is exported
+// without it
+#define METRICS_FILE_ENV "RM_METRICS_FILE"
+#define METRICS_INTERVAL 1.0  // seconds between exports
+
+// threads past this many share one more shard, with atomic adds
+#define METRICS_SHARDS_MAX 64
+// a value v lands in bucket 64 - clz(v), so bucket b holds [2^(b-1), 2^b)
+#define METRICS_BUCKETS_N 65
+#define METRICS_TEXT_MAX 32768
+
+typedef enum MetricCounter {
+    METRIC_GAMES_STARTED,
+    METRIC_GAMES_FINISHED,
+    METRIC_PLACEMENTS,
+    METRIC_FUZZY_PLACEMENTS,  // placed where get_fuzzy_block_placement said
+    METRIC_LINES_CLEARED,
+    METRIC_REQUESTS,
+    METRIC_COUNTERS_N,
+} MetricCounter;
+
+typedef enum MetricHistogram {
+    METRIC_COMBO_LENGTH,     // a combo when it breaks
+    METRIC_FRAME_TIME,       // nanoseconds
+    METRIC_REQUEST_LATENCY,  // nanoseconds, from read to reply
+    METRIC_INPUT_LATENCY,    // nanoseconds, from click to screen
+    METRIC_HISTOGRAMS_N,
+} MetricHistogram;
+
+typedef struct MetricsShard {
+    alignas(64) _Atomic uint64_t counters[METRIC_COUNTERS_N];
+    struct {
+        _Atomic uint64_t buckets[METRICS_BUCKETS_N];
+        _Atomic uint64_t sum;
+    } histograms[METRIC_HISTOGRAMS_N];
+    bool shared;  // the overflow shard, added to atomically
+} MetricsShard;
+
+extern _Thread_local MetricsShard* metrics_shard;
+// claims a shard for the calling thread
+MetricsShard* metrics_claim_shard(void);
+
+static inline MetricsShard* get_metrics_shard(void) {
+    MetricsShard* shard = metrics_shard;
+    return shard ? shard : metrics_claim_shard();
+}
+
+// only the owner writes a shard, so a load and a store make the add
+static inline void metrics_add(MetricsShard* shard, _Atomic uint64_t* value,
+                               uint64_t n) {
+    if (shard->shared) {
+        atomic_fetch_add_explicit(value, n, memory_order_relaxed);
+    } else {
+        atomic_store_explicit(
+            value, atomic_load_explicit(value, memory_order_relaxed) + n,
+            memory_order_relaxed);
+    }
+}
+
+static inline void metrics_count(MetricCounter counter, uint64_t n) {
+    MetricsShard* shard = get_metrics_shard();
+    metrics_add(shard, &shard->counters[counter], n);
+}
+
+// n observations of the same value
+static inline void metrics_observe_n(MetricHistogram histogram,
+                                     uint64_t value, uint64_t n) {
+    MetricsShard* shard = get_metrics_shard();
+    int bucket = value ? 64 - __builtin_clzll(value) : 0;
+    metrics_add(shard, &shard->histograms[histogram].buckets[bucket], n);
+    metrics_add(shard, &shard->histograms[histogram].sum, value * n);
+}
+
+static inline void metrics_observe(MetricHistogram histogram,
+                                   uint64_t value) {
+    metrics_observe_n(histogram, value, 1);
+}
+
+typedef struct MetricsSnapshot {
+    uint64_t counters[METRIC_COUNTERS_N];
+    struct {
+        uint64_t buckets[METRICS_BUCKETS_N];
+        uint64_t sum;
+        uint64_t count;
+    } histograms[METRIC_HISTOGRAMS_N];
+} MetricsSnapshot;
+
+// sums of every shard
+void get_metrics_snapshot(MetricsSnapshot* snapshot);
+// the prometheus text of a snapshot, returns its length
+size_t format_metrics(const MetricsSnapshot* snapshot, char* out,
+                      size_t size);
+
+typedef struct MetricsExporter {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    char path[FILEIO_PATH_MAX];
+    double interval;  // seconds
+    bool stopping;
+    uint64_t writes_n;
+    uint64_t failures_n;
+} MetricsExporter;
+
+bool metrics_exporter_start(MetricsExporter* exporter, const char* path,
+                            double interval);
+// starts exporting to the file named by METRICS_FILE_ENV, false if it isn't
+// set or the exporter couldn't start
+bool metrics_exporter_start_from_env(MetricsExporter* exporter);
+// writes the metrics once more and joins the thread
+void metrics_exporter_stop(MetricsExporter* exporter);
+
+#endif  // METRICS_H
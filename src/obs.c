@@ -0,0 +1,96 @@
+#include "obs.h"
+
+#include <string.h>
+
+ObsLayout make_obs_layout(unsigned sections) {
+    ObsLayout layout = {
+        .sections = sections,
+        .occupancy = -1,
+        .colors = -1,
+        .held_planes = -1,
+        .legal = -1,
+        .held_codes = -1,
+    };
+    size_t size = 0;
+    if (sections & OBS_OCCUPANCY) {
+        layout.occupancy = size;
+        size += OBS_PLANE_SIZE;
+    }
+    if (sections & OBS_COLORS) {
+        layout.colors = size;
+        size += CELL_COLORS_N * OBS_PLANE_SIZE;
+    }
+    if (sections & OBS_HELD_PLANES) {
+        layout.held_planes = size;
+        size += HELD_BLOCKS_N * OBS_HELD_PLANES_N * OBS_PLANE_SIZE;
+    }
+    if (sections & OBS_LEGAL) {
+        layout.legal = size;
+        size += HELD_BLOCKS_N * OBS_PLANE_SIZE;
+    }
+    if (sections & OBS_HELD_CODES) {
+        layout.held_codes = size;
+        size += HELD_BLOCKS_N;
+    }
+    layout.size = size;
+    return layout;
+}
+
+void obs_write_plane(Board board, uint8_t* out) {
+    // one row of cells at a time, byte i of a spread row is cell i
+    for (int row = 0; row < FIELD_SIZE; ++row) {
+        uint64_t cells = board_spread_byte(board >> (row * FIELD_SIZE));
+        memcpy(out + row * FIELD_SIZE, &cells, sizeof(cells));
+    }
+}
+
+void obs_write(const ObsLayout* layout, Board occupied, const Board* colors,
+               const PackedBlock* held_blocks, uint8_t* out) {
+    if (layout->occupancy >= 0) {
+        obs_write_plane(occupied, out + layout->occupancy);
+    }
+    if (layout->colors >= 0) {
+        for (int i = 0; i < CELL_COLORS_N; ++i) {
+            obs_write_plane(colors[i],
+                            out + layout->colors + i * OBS_PLANE_SIZE);
+        }
+    }
+
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        Block block = unpack_block(held_blocks[slot]);
+        bool held = block.item != CELL_ITEM_EMPTY;
+
+        if (layout->held_planes >= 0) {
+            uint8_t* planes = out + layout->held_planes +
+                              slot * OBS_HELD_PLANES_N * OBS_PLANE_SIZE;
+            memset(planes, 0, OBS_HELD_PLANES_N * OBS_PLANE_SIZE);
+            if (held) {
+                memset(planes + block.shape * OBS_PLANE_SIZE, 1,
+                       OBS_PLANE_SIZE);
+                memset(planes + (BLOCK_SHAPES_MAX + block.rotation) *
+                                    OBS_PLANE_SIZE,
+                       1, OBS_PLANE_SIZE);
+            }
+        }
+        if (layout->legal >= 0) {
+            Board legal =
+                held ? get_legal_origins(occupied, get_block_mask(&block)) : 0;
+            obs_write_plane(legal,
+                            out + layout->legal + slot * OBS_PLANE_SIZE);
+        }
+        if (layout->held_codes >= 0) {
+            out[layout->held_codes + slot] =
+                held ? block.shape * 4 + block.rotation + 1 : 0;
+        }
+    }
+}
+
+void obs_write_gamestate(const ObsLayout* layout, const GameState* state,
+                         uint8_t* out) {
+    PackedBlock held_blocks[HELD_BLOCKS_N];
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        held_blocks[slot] = pack_block(&state->held_blocks[slot]);
+    }
+    obs_write(layout, get_occupied_cells(state), state->field, held_blocks,
+              out);
+}
@@ -0,0 +1,59 @@
+#if !defined(OBS_H)
+#define OBS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "block.h"
+#include "constants.h"
+#include "game.h"
+
+// observation tensors written straight into caller owned memory, one byte
+// per value. a plane is FIELD_SIZE * FIELD_SIZE bytes in field index order.
+// the sections asked for follow each other in the order of ObsSection.
+
+typedef enum ObsSection {
+    // 1 plane, occupied cells
+    OBS_OCCUPANCY = 1 << 0,
+    // CELL_COLORS_N planes, the cells of each color
+    OBS_COLORS = 1 << 1,
+    // per held slot OBS_HELD_PLANES_N planes, one for each of the
+    // BLOCK_SHAPES_MAX shapes a set can have then one per rotation, the
+    // ones of the held block filled with 1
+    OBS_HELD_PLANES = 1 << 2,
+    // per held slot 1 plane, the legal top left corners of its block
+    OBS_LEGAL = 1 << 3,
+    // HELD_BLOCKS_N bytes, 0 for an empty slot, otherwise
+    // shape * 4 + rotation + 1
+    OBS_HELD_CODES = 1 << 4,
+} ObsSection;
+
+#define OBS_PLANE_SIZE (FIELD_SIZE * FIELD_SIZE)
+#define OBS_HELD_PLANES_N (BLOCK_SHAPES_MAX + 4)
+
+typedef struct ObsLayout {
+    unsigned sections;  // ObsSection flags
+    // byte offset of every section within a game's observation, -1 if the
+    // section is left out
+    ptrdiff_t occupancy;
+    ptrdiff_t colors;
+    ptrdiff_t held_planes;
+    ptrdiff_t legal;
+    ptrdiff_t held_codes;
+    size_t size;  // bytes per game
+} ObsLayout;
+
+ObsLayout make_obs_layout(unsigned sections);
+
+// OBS_PLANE_SIZE bytes, 1 for the cells set on the board
+void obs_write_plane(Board board, uint8_t* out);
+
+// writes one game's observation to out, layout->size bytes. colors holds
+// CELL_COLORS_N boards and is only read for OBS_COLORS
+void obs_write(const ObsLayout* layout, Board occupied, const Board* colors,
+               const PackedBlock* held_blocks, uint8_t* out);
+void obs_write_gamestate(const ObsLayout* layout, const GameState* state,
+                         uint8_t* out);
+
+#endif  // OBS_H
@@ -0,0 +1,95 @@
+#define _GNU_SOURCE
+#include "parallel.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the workers wait for all of them to start, so a failed start runs nothing
+typedef struct ParallelStart {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    bool started;
+    bool cancelled;
+} ParallelStart;
+
+typedef struct ParallelTask {
+    ParallelFn fn;
+    void* ctx;
+    int thread_index;
+    int threads_n;
+    ParallelStart* start;
+} ParallelTask;
+
+static void* parallel_thread_main(void* arg) {
+    ParallelTask* task = arg;
+    ParallelStart* start = task->start;
+    pthread_mutex_lock(&start->mutex);
+    while (!start->started && !start->cancelled) {
+        pthread_cond_wait(&start->changed, &start->mutex);
+    }
+    bool cancelled = start->cancelled;
+    pthread_mutex_unlock(&start->mutex);
+    if (!cancelled) task->fn(task->ctx, task->thread_index, task->threads_n);
+    return NULL;
+}
+
+int parallel_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+bool parallel_run(int threads_n, ParallelFn fn, void* ctx) {
+    assert(threads_n > 0);
+    if (threads_n == 1) {
+        fn(ctx, 0, 1);
+        return true;
+    }
+
+    pthread_t* threads = malloc(sizeof(*threads) * threads_n);
+    ParallelTask* tasks = malloc(sizeof(*tasks) * threads_n);
+    if (!threads || !tasks) {
+        free(tasks);
+        free(threads);
+        return false;
+    }
+
+    ParallelStart start = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .changed = PTHREAD_COND_INITIALIZER,
+    };
+    for (int i = 0; i < threads_n; ++i) {
+        tasks[i] = (ParallelTask){
+            .fn = fn,
+            .ctx = ctx,
+            .thread_index = i,
+            .threads_n = threads_n,
+            .start = &start,
+        };
+    }
+    // the calling thread does the work of thread 0
+    int started_n = 1;
+    while (started_n < threads_n &&
+           pthread_create(&threads[started_n], NULL, parallel_thread_main,
+                          &tasks[started_n]) == 0) {
+        started_n++;
+    }
+    bool ok = started_n == threads_n;
+
+    pthread_mutex_lock(&start.mutex);
+    start.started = ok;
+    start.cancelled = !ok;
+    pthread_cond_broadcast(&start.changed);
+    pthread_mutex_unlock(&start.mutex);
+    if (ok) fn(ctx, 0, threads_n);
+    for (int i = 1; i < started_n; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&start.mutex);
+    pthread_cond_destroy(&start.changed);
+    free(tasks);
+    free(threads);
+    return ok;
+}
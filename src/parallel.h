@@ -0,0 +1,14 @@
+#if !defined(PARALLEL_H)
+#define PARALLEL_H
+
+#include <stdbool.h>
+
+// runs fn on threads_n threads and waits for all of them to finish
+typedef void (*ParallelFn)(void* ctx, int thread_index, int threads_n);
+
+int parallel_default_threads(void);
+// false if the threads couldn't be allocated or started, fn then didn't run
+// at all, so the caller can still run it on its own as fn(ctx, 0, 1)
+bool parallel_run(int threads_n, ParallelFn fn, void* ctx);
+
+#endif  // PARALLEL_H
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+#include "plugin.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timing.h"
+
+#if defined(_WIN32)
+// windows.h clashes with raylib, so the three calls are declared here
+__declspec(dllimport) void* __stdcall LoadLibraryA(const char* path);
+__declspec(dllimport) void* __stdcall GetProcAddress(void* library,
+                                                     const char* name);
+__declspec(dllimport) int __stdcall FreeLibrary(void* library);
+
+static void* open_library(const char* path) { return LoadLibraryA(path); }
+static void* find_symbol(void* library, const char* name) {
+    return GetProcAddress(library, name);
+}
+static void close_library(void* library) { FreeLibrary(library); }
+static const char* library_error(void) { return "LoadLibrary failed"; }
+#else
+#include <dlfcn.h>
+
+static void* open_library(const char* path) {
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+}
+static void* find_symbol(void* library, const char* name) {
+    return dlsym(library, name);
+}
+static void close_library(void* library) { dlclose(library); }
+static const char* library_error(void) {
+    const char* error = dlerror();
+    return error ? error : "unknown error";
+}
+#endif
+
+static_assert(RM_FIELD_SIZE == FIELD_SIZE && RM_COLORS_N == CELL_COLORS_N &&
+                  RM_HELD_BLOCKS_N == HELD_BLOCKS_N,
+              "the plugin ABI must match the engine");
+static_assert(sizeof(RmGameView) == 104, "RmGameView changed its layout");
+
+bool is_plugin_spec(const char* spec) {
+    return strncmp(spec, PLUGIN_SPEC_PREFIX, strlen(PLUGIN_SPEC_PREFIX)) == 0;
+}
+
+bool policy_plugin_open(PolicyPlugin* plugin, const char* spec,
+                        char* error_out, size_t error_size) {
+    *plugin = (PolicyPlugin){0};
+    if (!is_plugin_spec(spec)) {
+        snprintf(error_out, error_size, "%s isn't a plugin", spec);
+        return false;
+    }
+    const char* path = spec + strlen(PLUGIN_SPEC_PREFIX);
+    const char* args = strchr(path, ':');
+    size_t path_len = args ? (size_t)(args - path) : strlen(path);
+    if (path_len == 0 || path_len >= PLUGIN_PATH_MAX ||
+        (args && strlen(args + 1) >= PLUGIN_PATH_MAX)) {
+        snprintf(error_out, error_size, "bad plugin spec %s", spec);
+        return false;
+    }
+    memcpy(plugin->path, path, path_len);
+    if (args) strcpy(plugin->args, args + 1);
+
+    plugin->library = open_library(plugin->path);
+    if (!plugin->library) {
+        snprintf(error_out, error_size, "%s", library_error());
+        return false;
+    }
+    RmPolicyEntryFn entry =
+        (RmPolicyEntryFn)find_symbol(plugin->library, RM_POLICY_ENTRY);
+    plugin->api = entry ? entry() : NULL;
+    if (!plugin->api) {
+        snprintf(error_out, error_size, "%s doesn't export %s", plugin->path,
+                 RM_POLICY_ENTRY);
+    } else if (plugin->api->abi_version != RM_POLICY_ABI_VERSION ||
+               plugin->api->view_size != sizeof(RmGameView)) {
+        snprintf(error_out, error_size,
+                 "%s was built for ABI version %u, this is version %d",
+                 plugin->path, plugin->api->abi_version,
+                 RM_POLICY_ABI_VERSION);
+    } else if (!plugin->api->create || !plugin->api->destroy ||
+               !plugin->api->decide) {
+        snprintf(error_out, error_size, "%s is missing functions",
+                 plugin->path);
+    } else {
+        return true;
+    }
+    policy_plugin_close(plugin);
+    return false;
+}
+
+void policy_plugin_close(PolicyPlugin* plugin) {
+    if (plugin->library) close_library(plugin->library);
+    plugin->library = NULL;
+    plugin->api = NULL;
+}
+
+void* policy_plugin_create(const PolicyPlugin* plugin, uint64_t seed) {
+    return plugin->api->create(plugin->args, seed);
+}
+
+void policy_plugin_destroy(const PolicyPlugin* plugin, void* instance) {
+    if (instance) plugin->api->destroy(instance);
+}
+
+void make_game_view(const GameState* state, uint64_t game_id,
+                    RmGameView* view_out) {
+    Board occupied = get_occupied_cells(state);
+    *view_out = (RmGameView){
+        .occupied = occupied,
+        .game_id = game_id,
+        .points = state->points,
+        .combo = state->combo,
+        .blocks_placed = state->blocks_placed,
+    };
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        view_out->colors[color] = state->field[color];
+    }
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        const Block* block = &state->held_blocks[slot];
+        if (block->item == CELL_ITEM_EMPTY) continue;
+        const BlockMask* mask = get_block_mask(block);
+        view_out->block_cells[slot] = mask->cells;
+        view_out->legal[slot] = get_legal_origins(occupied, mask);
+        view_out->block_codes[slot] = block->shape * 4 + block->rotation + 1;
+    }
+}
+
+bool game_view_has_moves(const RmGameView* view) {
+    return (view->legal[0] | view->legal[1] | view->legal[2]) != 0;
+}
+
+void policy_plugin_decide(PolicyPlugin* plugin, void* instance,
+                          const RmGameView* views, uint32_t games_n,
+                          RmMove* moves_out) {
+    double start = get_time_seconds();
+    plugin->api->decide(instance, views, games_n, moves_out);
+    uint64_t nanoseconds = (get_time_seconds() - start) * 1e9;
+    atomic_fetch_add(&plugin->calls_n, 1);
+    atomic_fetch_add(&plugin->decisions_n, games_n);
+    atomic_fetch_add(&plugin->nanoseconds, nanoseconds);
+}
+
+bool policy_plugin_play(PolicyPlugin* plugin, void* instance,
+                        GameState* states, const uint64_t* game_ids,
+                        uint32_t games_n, PluginMoveFn on_move, void* ctx) {
+    RmGameView* views = malloc(sizeof(*views) * games_n);
+    RmMove* moves = malloc(sizeof(*moves) * games_n);
+    uint32_t* going = malloc(sizeof(*going) * games_n);
+    if (!views || !moves || !going) {
+        free(views);
+        free(moves);
+        free(going);
+        return false;
+    }
+
+    uint32_t going_n = 0;
+    for (uint32_t i = 0; i < games_n; ++i) going[going_n++] = i;
+    while (going_n > 0) {
+        // the views of the games that can still place a block, packed
+        uint32_t views_n = 0;
+        for (uint32_t k = 0; k < going_n; ++k) {
+            uint32_t i = going[k];
+            make_game_view(&states[i], game_ids[i], &views[views_n]);
+            if (game_view_has_moves(&views[views_n])) going[views_n++] = i;
+        }
+        going_n = views_n;
+        if (going_n == 0) break;
+
+        policy_plugin_decide(plugin, instance, views, going_n, moves);
+        uint32_t still_n = 0;
+        for (uint32_t k = 0; k < going_n; ++k) {
+            uint32_t i = going[k];
+            Move move = {.slot = moves[k].slot, .cell = moves[k].cell};
+            if (apply_move(&states[i], move, NULL) < 0) {
+                atomic_fetch_add(&plugin->illegal_n, 1);
+                continue;
+            }
+            if (on_move) on_move(ctx, i, move);
+            going[still_n++] = i;
+        }
+        going_n = still_n;
+    }
+
+    free(views);
+    free(moves);
+    free(going);
+    return true;
+}
+
+void format_plugin_stats(const PolicyPlugin* plugin, char* out,
+                         size_t out_size) {
+    uint64_t calls_n = atomic_load(&plugin->calls_n);
+    uint64_t decisions_n = atomic_load(&plugin->decisions_n);
+    uint64_t nanoseconds = atomic_load(&plugin->nanoseconds);
+    snprintf(out, out_size,
+             "%s (%s): %llu calls, %.1f games/call, %.1f ns/decision, "
+             "%llu illegal",
+             plugin->api ? plugin->api->name : "?", plugin->path,
+             (unsigned long long)calls_n,
+             calls_n ? (double)decisions_n / calls_n : 0.0,
+             decisions_n ? (double)nanoseconds / decisions_n : 0.0,
+             (unsigned long long)atomic_load(&plugin->illegal_n));
+}
@@ -0,0 +1,68 @@
+#if !defined(PLUGIN_H)
+#define PLUGIN_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "policy_abi.h"
+
+// the host side of policy plugins: loading them, turning games into views,
+// timing the calls and playing whole games in lockstep so every decide call
+// carries a batch of games
+
+// spelling of a plugin policy on the command line, "plugin:<path>" with
+// optional ":<args>" after it
+#define PLUGIN_SPEC_PREFIX "plugin:"
+#define PLUGIN_PATH_MAX 512
+
+typedef struct PolicyPlugin {
+    void* library;
+    const RmPolicyApi* api;
+    char path[PLUGIN_PATH_MAX];
+    char args[PLUGIN_PATH_MAX];
+    // timing of the decide calls over every thread
+    _Atomic uint64_t calls_n;
+    _Atomic uint64_t decisions_n;
+    _Atomic uint64_t illegal_n;
+    _Atomic uint64_t nanoseconds;
+} PolicyPlugin;
+
+// called with every move a lockstep game makes, game is its index in the
+// batch
+typedef void (*PluginMoveFn)(void* ctx, uint32_t game, Move move);
+
+// true if spec names a plugin rather than a builtin policy
+bool is_plugin_spec(const char* spec);
+// loads the library of a "plugin:<path>[:<args>]" spec and checks its ABI,
+// false with the reason in error_out
+bool policy_plugin_open(PolicyPlugin* plugin, const char* spec,
+                        char* error_out, size_t error_size);
+void policy_plugin_close(PolicyPlugin* plugin);
+
+// an instance for one thread, NULL if the plugin couldn't make it
+void* policy_plugin_create(const PolicyPlugin* plugin, uint64_t seed);
+void policy_plugin_destroy(const PolicyPlugin* plugin, void* instance);
+
+void make_game_view(const GameState* state, uint64_t game_id,
+                    RmGameView* view_out);
+// true if any held block can be placed
+bool game_view_has_moves(const RmGameView* view);
+// one timed decide call
+void policy_plugin_decide(PolicyPlugin* plugin, void* instance,
+                          const RmGameView* views, uint32_t games_n,
+                          RmMove* moves_out);
+// plays the games to their end, one decide call per round of placements
+// over every game still going. on_move may be NULL. false if it ran out of
+// memory
+bool policy_plugin_play(PolicyPlugin* plugin, void* instance,
+                        GameState* states, const uint64_t* game_ids,
+                        uint32_t games_n, PluginMoveFn on_move, void* ctx);
+
+// a line with the calls, decisions per call and time per decision
+void format_plugin_stats(const PolicyPlugin* plugin, char* out,
+                         size_t out_size);
+
+#endif  // PLUGIN_H
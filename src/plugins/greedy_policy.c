@@ -0,0 +1,83 @@
+// an example policy plugin built against nothing but policy_abi.h: places
+// the block that clears the most lines right away, ties broken at random
+//
+// build: gcc -O2 -shared -fPIC -I./src ./src/plugins/greedy_policy.c
+//            -o greedy_policy.so
+// use:   tournament plugin:./greedy_policy.so,random
+
+#include <stdlib.h>
+
+#include "policy_abi.h"
+
+#define ROW_0 0xffull
+#define COL_0 0x0101010101010101ull
+
+typedef struct GreedyPolicy {
+    uint64_t rng;
+} GreedyPolicy;
+
+// splitmix64
+static uint64_t next_random(GreedyPolicy* policy) {
+    uint64_t z = (policy->rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static int count_full_lines(uint64_t occupied) {
+    int lines_n = 0;
+    for (int i = 0; i < RM_FIELD_SIZE; ++i) {
+        uint64_t row = ROW_0 << (i * RM_FIELD_SIZE);
+        uint64_t col = COL_0 << i;
+        lines_n += (occupied & row) == row;
+        lines_n += (occupied & col) == col;
+    }
+    return lines_n;
+}
+
+static void* greedy_create(const char* args, uint64_t seed) {
+    (void)args;
+    GreedyPolicy* policy = malloc(sizeof(*policy));
+    if (policy) policy->rng = seed;
+    return policy;
+}
+
+static void greedy_destroy(void* policy) { free(policy); }
+
+static void greedy_decide(void* arg, const RmGameView* games,
+                          uint32_t games_n, RmMove* moves_out) {
+    GreedyPolicy* policy = arg;
+    for (uint32_t g = 0; g < games_n; ++g) {
+        const RmGameView* game = &games[g];
+        int best_lines_n = -1;
+        uint32_t ties_n = 0;
+        for (int slot = 0; slot < RM_HELD_BLOCKS_N; ++slot) {
+            for (uint64_t legal = game->legal[slot]; legal;
+                 legal &= legal - 1) {
+                int cell = __builtin_ctzll(legal);
+                int lines_n = count_full_lines(
+                    game->occupied | game->block_cells[slot] << cell);
+                if (lines_n > best_lines_n) {
+                    best_lines_n = lines_n;
+                    ties_n = 0;
+                }
+                // reservoir sampling over the best placements
+                if (lines_n == best_lines_n &&
+                    next_random(policy) % ++ties_n == 0) {
+                    moves_out[g] = (RmMove){.slot = slot, .cell = cell};
+                }
+            }
+        }
+    }
+}
+
+static const RmPolicyApi greedy_api = {
+    .abi_version = RM_POLICY_ABI_VERSION,
+    .view_size = sizeof(RmGameView),
+    .name = "greedy",
+    .create = greedy_create,
+    .destroy = greedy_destroy,
+    .decide = greedy_decide,
+};
+
+const RmPolicyApi* rm_policy_api(void) { return &greedy_api; }
@@ -0,0 +1,53 @@
+#include "policy.h"
+
+#include <string.h>
+
+#include "search.h"
+
+static const OpeningBook* policy_book;
+
+void set_policy_book(const OpeningBook* book) { policy_book = book; }
+
+bool parse_policy(const char* name, PolicyKind* policy_out) {
+    if (strcmp(name, "random") == 0) {
+        *policy_out = POLICY_RANDOM;
+    } else if (strcmp(name, "search") == 0) {
+        *policy_out = POLICY_SEARCH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool play_turn(PolicyKind policy, GameState* state, Rng* rng, Move* moves_out,
+               int* moves_n_out) {
+    // placing the last block deals the next turn, so count them up front
+    int left = HELD_BLOCKS_N - state->blocks_placed;
+    int moves_n = 0;
+    switch (policy) {
+        case POLICY_RANDOM:
+            for (; moves_n < left; ++moves_n) {
+                Move moves[MAX_MOVES_N];
+                int legal_n = get_legal_moves(state, moves);
+                if (legal_n == 0) break;
+                Move move = moves[rng_range(rng, legal_n)];
+                if (moves_out) moves_out[moves_n] = move;
+                apply_move(state, move, NULL);
+            }
+            break;
+        case POLICY_SEARCH: {
+            SearchResult plan;
+            if (!policy_book || !book_lookup(policy_book, state, plan.moves,
+                                             &plan.moves_n)) {
+                search_turn(state, &plan);
+            }
+            for (; moves_n < plan.moves_n; ++moves_n) {
+                if (moves_out) moves_out[moves_n] = plan.moves[moves_n];
+                apply_move(state, plan.moves[moves_n], NULL);
+            }
+            break;
+        }
+    }
+    if (moves_n_out) *moves_n_out = moves_n;
+    return moves_n == left;
+}
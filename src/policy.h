@@ -0,0 +1,29 @@
+#if !defined(POLICY_H)
+#define POLICY_H
+
+#include <stdbool.h>
+
+#include "book.h"
+#include "game.h"
+#include "rng.h"
+
+// the automated players, they play a turn at a time
+typedef enum PolicyKind {
+    POLICY_RANDOM,  // a uniformly random legal move every time
+    POLICY_SEARCH,  // the best line of search_turn
+} PolicyKind;
+
+// name is "random" or "search", false for anything else
+bool parse_policy(const char* name, PolicyKind* policy_out);
+
+// the search policy plays turn starts found in the book straight from it.
+// set once before any thread plays, NULL turns the book off
+void set_policy_book(const OpeningBook* book);
+
+// plays the rest of the current turn. returns false if a block couldn't be
+// placed, the game is over then. moves_out gets the moves made, up to
+// HELD_BLOCKS_N, it may be NULL
+bool play_turn(PolicyKind policy, GameState* state, Rng* rng, Move* moves_out,
+               int* moves_n_out);
+
+#endif  // POLICY_H
@@ -0,0 +1,65 @@
+#if !defined(POLICY_ABI_H)
+#define POLICY_ABI_H
+
+#include <stdint.h>
+
+// the stable interface of policies built as shared libraries outside the
+// engine. a plugin includes only this header and exports
+//
+//   const RmPolicyApi* rm_policy_api(void);
+//
+// the host hands it a batch of games at a time, each as a read-only view
+// with the legal placements worked out, and gets one placement per game
+// back. the layouts below only change together with RM_POLICY_ABI_VERSION
+// and the host refuses plugins built against another version.
+//
+// boards are 64 bit masks of the 8x8 field, bit y * 8 + x.
+
+#define RM_POLICY_ABI_VERSION 1
+#define RM_POLICY_ENTRY "rm_policy_api"
+
+#define RM_FIELD_SIZE 8
+#define RM_HELD_BLOCKS_N 3
+#define RM_COLORS_N 3
+
+typedef struct RmGameView {
+    uint64_t occupied;
+    uint64_t colors[RM_COLORS_N];  // cells of each block color
+    // cells of every held block with its top left corner at bit 0, 0 for
+    // a slot that was already placed
+    uint64_t block_cells[RM_HELD_BLOCKS_N];
+    // top left corners every held block can be placed at
+    uint64_t legal[RM_HELD_BLOCKS_N];
+    uint64_t game_id;  // the same for every call about the same game
+    int32_t points;
+    int32_t combo;
+    // 0 for an empty slot, otherwise shape * 4 + rotation + 1 of the
+    // loaded shape set
+    uint8_t block_codes[RM_HELD_BLOCKS_N];
+    uint8_t blocks_placed;  // this turn
+    uint8_t reserved[4];
+} RmGameView;
+
+typedef struct RmMove {
+    uint8_t slot;
+    uint8_t cell;  // of the top left corner of the block
+} RmMove;
+
+typedef struct RmPolicyApi {
+    uint32_t abi_version;  // RM_POLICY_ABI_VERSION the plugin was built with
+    uint32_t view_size;    // sizeof(RmGameView) the plugin was built with
+    const char* name;
+    // a policy instance, args come from the user and may be empty. the
+    // host makes one per thread, so an instance is never called from two
+    // threads at once. NULL if it can't be made
+    void* (*create)(const char* args, uint64_t seed);
+    void (*destroy)(void* policy);
+    // a placement for each of the games, every game has at least one
+    // legal placement. an illegal placement ends that game
+    void (*decide)(void* policy, const RmGameView* games, uint32_t games_n,
+                   RmMove* moves_out);
+} RmPolicyApi;
+
+typedef const RmPolicyApi* (*RmPolicyEntryFn)(void);
+
+#endif  // POLICY_ABI_H
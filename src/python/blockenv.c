@@ -0,0 +1,403 @@
+// python bindings over the batched environment.
+//
+//   env = blockenv.VecEnv(envs_n, seed=0, obs=blockenv.OBS_DEFAULT,
+//                         deals="random")  # or "bag"
+//   obs = numpy.asarray(env.obs)  # (envs_n, obs size) uint8, no copy
+//   env.reset()
+//   env.step(actions)             # any int32 buffer of envs_n actions
+//
+// obs, legal (mask over actions), rewards, dones and seeds are memoryviews
+// of the engine's own arrays, numpy.asarray wraps them without copying and
+// they stay valid as long as any of them is alive. step and reset release
+// the GIL, so different envs can step on different threads. one env must
+// not be used from two threads at once, that raises RuntimeError.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "vecenv.h"
+
+typedef struct PyVecEnv {
+    PyObject_HEAD
+    VecEnv env;
+    uint8_t* obs;
+    uint8_t* legal;  // VECENV_ACTIONS_N per game
+    float* rewards;
+    uint8_t* dones;
+    atomic_bool busy;
+} PyVecEnv;
+
+// one of the engine's arrays, exported through the buffer protocol. it
+// keeps its env alive
+typedef struct EngineArray {
+    PyObject_HEAD
+    PyVecEnv* owner;
+    void* data;
+    const char* format;
+    Py_ssize_t itemsize;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    int ndim;
+} EngineArray;
+
+static PyTypeObject EngineArrayType;
+
+static void engine_array_dealloc(EngineArray* self) {
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int engine_array_getbuffer(EngineArray* self, Py_buffer* view,
+                                  int flags) {
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->buf = self->data;
+    view->len = self->shape[0] * self->itemsize;
+    if (self->ndim == 2) view->len *= self->shape[1];
+    view->readonly = 0;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs engine_array_buffer = {
+    .bf_getbuffer = (getbufferproc)engine_array_getbuffer,
+};
+
+static PyTypeObject EngineArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "blockenv.EngineArray",
+    .tp_basicsize = sizeof(EngineArray),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)engine_array_dealloc,
+    .tp_as_buffer = &engine_array_buffer,
+};
+
+static PyObject* export_array(PyVecEnv* owner, void* data, const char* format,
+                              Py_ssize_t itemsize, Py_ssize_t rows,
+                              Py_ssize_t cols) {
+    EngineArray* array = PyObject_New(EngineArray, &EngineArrayType);
+    if (!array) return NULL;
+    Py_INCREF(owner);
+    array->owner = owner;
+    array->data = data;
+    array->format = format;
+    array->itemsize = itemsize;
+    array->ndim = cols ? 2 : 1;
+    array->shape[0] = rows;
+    array->shape[1] = cols;
+    array->strides[0] = cols ? cols * itemsize : itemsize;
+    array->strides[1] = itemsize;
+
+    PyObject* view = PyMemoryView_FromObject((PyObject*)array);
+    Py_DECREF(array);
+    return view;
+}
+
+// claims the env for a call that drops the GIL
+static bool acquire_env(PyVecEnv* self) {
+    bool expected = false;
+    if (!atomic_compare_exchange_strong(&self->busy, &expected, true)) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "VecEnv is already in use by another thread");
+        return false;
+    }
+    return true;
+}
+
+static void release_env(PyVecEnv* self) { atomic_store(&self->busy, false); }
+
+// gets a contiguous buffer of envs_n items of the given size
+static bool get_env_buffer(PyVecEnv* self, PyObject* obj, Py_ssize_t itemsize,
+                           const char* name, Py_buffer* view) {
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS) != 0) return false;
+    if (view->itemsize != itemsize ||
+        view->len != (Py_ssize_t)self->env.envs_n * itemsize) {
+        PyErr_Format(PyExc_ValueError,
+                     "%s must hold %d items of %zd bytes", name,
+                     self->env.envs_n, itemsize);
+        PyBuffer_Release(view);
+        return false;
+    }
+    return true;
+}
+
+static void pyvecenv_dealloc(PyVecEnv* self) {
+    vecenv_free(&self->env);
+    PyMem_RawFree(self->obs);
+    PyMem_RawFree(self->legal);
+    PyMem_RawFree(self->rewards);
+    PyMem_RawFree(self->dones);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int pyvecenv_init(PyVecEnv* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"envs_n", "seed", "obs", "deals", NULL};
+    int envs_n;
+    unsigned long long seed = 0;
+    unsigned int sections = VECENV_DEFAULT_OBS;
+    const char* deals = "random";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|KIs", keywords, &envs_n,
+                                     &seed, &sections, &deals)) {
+        return -1;
+    }
+    DealMode deal_mode;
+    if (!parse_deal_mode(deals, &deal_mode)) {
+        PyErr_SetString(PyExc_ValueError, "deals must be random or bag");
+        return -1;
+    }
+    if (self->env.envs_n) {
+        PyErr_SetString(PyExc_RuntimeError, "VecEnv is already initialized");
+        return -1;
+    }
+    if (envs_n < 1) {
+        PyErr_SetString(PyExc_ValueError, "envs_n must be positive");
+        return -1;
+    }
+    if (!vecenv_init(&self->env, envs_n, seed)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    vecenv_set_obs_layout(&self->env, sections);
+    if (deal_mode != DEAL_MODE_RANDOM) {
+        vecenv_set_deal_mode(&self->env, deal_mode);
+        vecenv_reset(&self->env, NULL);
+    }
+
+    self->obs = PyMem_RawCalloc(envs_n, self->env.obs_layout.size);
+    self->legal = PyMem_RawCalloc(envs_n, VECENV_ACTIONS_N);
+    self->rewards = PyMem_RawCalloc(envs_n, sizeof(float));
+    self->dones = PyMem_RawCalloc(envs_n, 1);
+    if ((!self->obs && self->env.obs_layout.size) || !self->legal ||
+        !self->rewards || !self->dones) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    vecenv_observe(&self->env, self->obs);
+    vecenv_legal_mask(&self->env, self->legal);
+    return 0;
+}
+
+PyDoc_STRVAR(reset_doc,
+             "reset(seeds=None)\n\n"
+             "Starts every game over. seeds is an optional buffer of envs_n "
+             "uint64 seeds, otherwise each env takes the next seed of its "
+             "own seed stream.");
+
+static PyObject* pyvecenv_reset(PyVecEnv* self, PyObject* args,
+                                PyObject* kwargs) {
+    static char* keywords[] = {"seeds", NULL};
+    PyObject* seeds_obj = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keywords,
+                                     &seeds_obj)) {
+        return NULL;
+    }
+    Py_buffer seeds = {0};
+    if (seeds_obj != Py_None &&
+        !get_env_buffer(self, seeds_obj, sizeof(uint64_t), "seeds", &seeds)) {
+        return NULL;
+    }
+    if (!acquire_env(self)) {
+        if (seeds.obj) PyBuffer_Release(&seeds);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (seeds.obj) {
+        const uint64_t* values = seeds.buf;
+        for (int i = 0; i < self->env.envs_n; ++i) {
+            vecenv_reset_env(&self->env, i, values[i]);
+        }
+        vecenv_observe(&self->env, self->obs);
+    } else {
+        vecenv_reset(&self->env, self->obs);
+    }
+    vecenv_legal_mask(&self->env, self->legal);
+    Py_END_ALLOW_THREADS
+
+    release_env(self);
+    if (seeds.obj) PyBuffer_Release(&seeds);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(reset_env_doc,
+             "reset_env(i, seed)\n\n"
+             "Starts game i over with the given seed.");
+
+static PyObject* pyvecenv_reset_env(PyVecEnv* self, PyObject* args) {
+    int i;
+    unsigned long long seed;
+    if (!PyArg_ParseTuple(args, "iK", &i, &seed)) return NULL;
+    if (i < 0 || i >= self->env.envs_n) {
+        PyErr_SetString(PyExc_IndexError, "env index out of range");
+        return NULL;
+    }
+    if (!acquire_env(self)) return NULL;
+    vecenv_reset_env(&self->env, i, seed);
+    // the other games observe the same as before
+    vecenv_observe(&self->env, self->obs);
+    vecenv_legal_mask(&self->env, self->legal);
+    release_env(self);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(step_doc,
+             "step(actions)\n\n"
+             "Plays one action in every game, actions is a buffer of envs_n "
+             "int32. Fills obs, legal, rewards and dones in place, finished "
+             "games are reset right away.");
+
+static PyObject* pyvecenv_step(PyVecEnv* self, PyObject* actions_obj) {
+    Py_buffer actions;
+    if (!get_env_buffer(self, actions_obj, sizeof(int32_t), "actions",
+                        &actions)) {
+        return NULL;
+    }
+    if (!acquire_env(self)) {
+        PyBuffer_Release(&actions);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    vecenv_step(&self->env, actions.buf, self->rewards, self->dones,
+                self->obs);
+    vecenv_legal_mask(&self->env, self->legal);
+    Py_END_ALLOW_THREADS
+
+    release_env(self);
+    PyBuffer_Release(&actions);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef pyvecenv_methods[] = {
+    {"reset", (PyCFunction)(void (*)(void))pyvecenv_reset,
+     METH_VARARGS | METH_KEYWORDS, reset_doc},
+    {"reset_env", (PyCFunction)pyvecenv_reset_env, METH_VARARGS,
+     reset_env_doc},
+    {"step", (PyCFunction)pyvecenv_step, METH_O, step_doc},
+    {NULL},
+};
+
+static PyObject* get_obs(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return export_array(self, self->obs, "B", 1, self->env.envs_n,
+                        self->env.obs_layout.size);
+}
+
+static PyObject* get_legal(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return export_array(self, self->legal, "B", 1, self->env.envs_n,
+                        VECENV_ACTIONS_N);
+}
+
+static PyObject* get_rewards(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return export_array(self, self->rewards, "f", sizeof(float),
+                        self->env.envs_n, 0);
+}
+
+static PyObject* get_dones(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return export_array(self, self->dones, "B", 1, self->env.envs_n, 0);
+}
+
+static PyObject* get_seeds(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return export_array(self, self->env.seeds, "Q", sizeof(uint64_t),
+                        self->env.envs_n, 0);
+}
+
+static PyObject* get_points(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return export_array(self, self->env.points, "i", sizeof(int32_t),
+                        self->env.envs_n, 0);
+}
+
+static PyObject* get_envs_n(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return PyLong_FromLong(self->env.envs_n);
+}
+
+static PyObject* get_obs_size(PyVecEnv* self, void* closure) {
+    (void)closure;
+    return PyLong_FromSize_t(self->env.obs_layout.size);
+}
+
+static PyGetSetDef pyvecenv_getset[] = {
+    {"obs", (getter)get_obs, NULL, "observations, (envs_n, obs_size) uint8",
+     NULL},
+    {"legal", (getter)get_legal, NULL,
+     "legal action mask, (envs_n, ACTIONS_N) uint8", NULL},
+    {"rewards", (getter)get_rewards, NULL, "last step's rewards, float32",
+     NULL},
+    {"dones", (getter)get_dones, NULL, "games ended by the last step, uint8",
+     NULL},
+    {"seeds", (getter)get_seeds, NULL, "seed of every current game, uint64",
+     NULL},
+    {"points", (getter)get_points, NULL, "score of every game, int32", NULL},
+    {"envs_n", (getter)get_envs_n, NULL, "amount of games", NULL},
+    {"obs_size", (getter)get_obs_size, NULL, "observation bytes per game",
+     NULL},
+    {NULL},
+};
+
+static PyTypeObject PyVecEnvType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "blockenv.VecEnv",
+    .tp_doc = PyDoc_STR("VecEnv(envs_n, seed=0, obs=OBS_DEFAULT)\n\n"
+                        "Many games stepped together."),
+    .tp_basicsize = sizeof(PyVecEnv),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)pyvecenv_init,
+    .tp_dealloc = (destructor)pyvecenv_dealloc,
+    .tp_methods = pyvecenv_methods,
+    .tp_getset = pyvecenv_getset,
+};
+
+static struct PyModuleDef blockenv_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "blockenv",
+    .m_doc = "Batched block puzzle environment.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_blockenv(void) {
+    if (PyType_Ready(&EngineArrayType) < 0) return NULL;
+    if (PyType_Ready(&PyVecEnvType) < 0) return NULL;
+
+    if (!init_block_masks()) {
+        PyErr_Format(PyExc_ImportError, "bad shape set in %s",
+                     SHAPE_SET_ENV);
+        return NULL;
+    }
+    init_batch_kernels(BATCH_KERNEL_AVX512);
+    char kernels[128];
+    format_batch_kernels(kernels, sizeof(kernels));
+
+    PyObject* module = PyModule_Create(&blockenv_module);
+    if (!module) return NULL;
+    Py_INCREF(&PyVecEnvType);
+    if (PyModule_AddObject(module, "VecEnv", (PyObject*)&PyVecEnvType) < 0) {
+        Py_DECREF(&PyVecEnvType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    PyModule_AddIntConstant(module, "ACTIONS_N", VECENV_ACTIONS_N);
+    PyModule_AddIntConstant(module, "FIELD_SIZE", FIELD_SIZE);
+    PyModule_AddIntConstant(module, "HELD_BLOCKS_N", HELD_BLOCKS_N);
+    PyModule_AddIntConstant(module, "OBS_OCCUPANCY", OBS_OCCUPANCY);
+    PyModule_AddIntConstant(module, "OBS_COLORS", OBS_COLORS);
+    PyModule_AddIntConstant(module, "OBS_HELD_PLANES", OBS_HELD_PLANES);
+    PyModule_AddIntConstant(module, "OBS_LEGAL", OBS_LEGAL);
+    PyModule_AddIntConstant(module, "OBS_HELD_CODES", OBS_HELD_CODES);
+    PyModule_AddIntConstant(module, "OBS_DEFAULT", VECENV_DEFAULT_OBS);
+    PyModule_AddStringConstant(module, "KERNELS", kernels);
+    return module;
+}
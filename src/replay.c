@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+#include "replay.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REPLAY_SEGMENT_BUF_SIZE (1 << 20)
+
+static_assert(sizeof(Move) == 2, "Move is stored as is in the archive");
+static_assert(sizeof(ReplayHeader) % 8 == 0, "index must stay aligned");
+
+struct ReplaySegment {
+    ReplayWriter* writer;
+    ReplaySegment* next;
+
+    uint8_t* buf;
+    size_t buf_len;
+
+    ReplayIndexEntry* entries;
+    size_t entries_n;
+    size_t entries_cap;
+    // entries from here on still hold offsets relative to buf
+    size_t entries_unflushed;
+
+    bool failed;
+};
+
+static bool write_all_at(int fd, const void* buf, size_t len, uint64_t offset) {
+    const uint8_t* p = buf;
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, (off_t)offset);
+        if (written <= 0) return false;
+        p += written;
+        len -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool replay_writer_open(ReplayWriter* writer, const char* path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    writer->fd = fd;
+    atomic_init(&writer->tail, sizeof(ReplayHeader));
+    atomic_init(&writer->segments, NULL);
+    return true;
+}
+
+ReplaySegment* replay_writer_segment(ReplayWriter* writer) {
+    ReplaySegment* segment = calloc(1, sizeof(*segment));
+    if (!segment) return NULL;
+    segment->buf = malloc(REPLAY_SEGMENT_BUF_SIZE);
+    if (!segment->buf) {
+        free(segment);
+        return NULL;
+    }
+    segment->writer = writer;
+
+    ReplaySegment* head = atomic_load(&writer->segments);
+    do {
+        segment->next = head;
+    } while (!atomic_compare_exchange_weak(&writer->segments, &head, segment));
+    return segment;
+}
+
+static bool replay_segment_flush(ReplaySegment* segment) {
+    if (segment->buf_len == 0) return !segment->failed;
+
+    uint64_t base =
+        atomic_fetch_add(&segment->writer->tail, segment->buf_len);
+    if (!write_all_at(segment->writer->fd, segment->buf, segment->buf_len,
+                      base)) {
+        segment->failed = true;
+    }
+    for (size_t i = segment->entries_unflushed; i < segment->entries_n; ++i) {
+        segment->entries[i].offset += base;
+    }
+    segment->entries_unflushed = segment->entries_n;
+    segment->buf_len = 0;
+    return !segment->failed;
+}
+
+bool replay_segment_append(ReplaySegment* segment, uint64_t seed, int score,
+                           const Move* moves, uint32_t moves_n) {
+    size_t len = sizeof(*moves) * moves_n;
+
+    if (segment->entries_n == segment->entries_cap) {
+        size_t cap = segment->entries_cap ? segment->entries_cap * 2 : 1024;
+        ReplayIndexEntry* entries =
+            realloc(segment->entries, sizeof(*entries) * cap);
+        if (!entries) return false;
+        segment->entries = entries;
+        segment->entries_cap = cap;
+    }
+
+    if (segment->buf_len + len > REPLAY_SEGMENT_BUF_SIZE) {
+        if (!replay_segment_flush(segment)) return false;
+    }
+
+    ReplayIndexEntry* entry = &segment->entries[segment->entries_n];
+    *entry = (ReplayIndexEntry){
+        .seed = seed,
+        .score = score,
+        .moves_n = moves_n,
+    };
+
+    if (len > REPLAY_SEGMENT_BUF_SIZE) {
+        // too big to buffer, goes straight to the file
+        entry->offset = atomic_fetch_add(&segment->writer->tail, len);
+        if (!write_all_at(segment->writer->fd, moves, len, entry->offset)) {
+            segment->failed = true;
+            return false;
+        }
+        segment->entries_n++;
+        segment->entries_unflushed = segment->entries_n;
+        return true;
+    }
+
+    entry->offset = segment->buf_len;
+    memcpy(segment->buf + segment->buf_len, moves, len);
+    segment->buf_len += len;
+    segment->entries_n++;
+    return true;
+}
+
+static int compare_entry_offsets(const void* a, const void* b) {
+    uint64_t offset_a = ((const ReplayIndexEntry*)a)->offset;
+    uint64_t offset_b = ((const ReplayIndexEntry*)b)->offset;
+    return (offset_a > offset_b) - (offset_a < offset_b);
+}
+
+bool replay_writer_close(ReplayWriter* writer) {
+    bool ok = true;
+    size_t games_n = 0;
+    ReplaySegment* segments = atomic_exchange(&writer->segments, NULL);
+    for (ReplaySegment* s = segments; s; s = s->next) {
+        ok &= replay_segment_flush(s);
+        games_n += s->entries_n;
+    }
+
+    // merging the segment indices
+    ReplayIndexEntry* index = malloc(sizeof(*index) * (games_n ? games_n : 1));
+    ok &= index != NULL;
+    size_t merged_n = 0;
+    for (ReplaySegment* s = segments; s;) {
+        if (index) {
+            memcpy(index + merged_n, s->entries,
+                   sizeof(*index) * s->entries_n);
+            merged_n += s->entries_n;
+        }
+        ReplaySegment* next = s->next;
+        free(s->entries);
+        free(s->buf);
+        free(s);
+        s = next;
+    }
+
+    if (ok) {
+        qsort(index, games_n, sizeof(*index), compare_entry_offsets);
+
+        uint64_t index_offset = atomic_load(&writer->tail);
+        index_offset = (index_offset + 7) & ~(uint64_t)7;
+        ReplayHeader header = {
+            .magic = REPLAY_MAGIC,
+            .version = REPLAY_VERSION,
+            .games_n = games_n,
+            .index_offset = index_offset,
+            .shape_set_hash = get_shape_set_hash(),
+        };
+        ok &= write_all_at(writer->fd, index, sizeof(*index) * games_n,
+                           index_offset);
+        // the header goes last so a torn archive never looks valid
+        ok &= write_all_at(writer->fd, &header, sizeof(header), 0);
+    }
+    free(index);
+
+    ok &= close(writer->fd) == 0;
+    writer->fd = -1;
+    return ok;
+}
+
+bool replay_archive_open(ReplayArchive* archive, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ReplayHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    const ReplayHeader* header = data;
+    bool valid = memcmp(header->magic, REPLAY_MAGIC, 4) == 0 &&
+                 header->version == REPLAY_VERSION &&
+                 header->shape_set_hash == get_shape_set_hash() &&
+                 header->index_offset % 8 == 0 &&
+                 header->index_offset <= size &&
+                 header->games_n <= (size - header->index_offset) /
+                                        sizeof(ReplayIndexEntry);
+    if (!valid) {
+        munmap(data, size);
+        return false;
+    }
+
+    *archive = (ReplayArchive){
+        .data = data,
+        .size = size,
+        .games_n = header->games_n,
+        .index = (const ReplayIndexEntry*)((const uint8_t*)data +
+                                           header->index_offset),
+    };
+    return true;
+}
+
+void replay_archive_close(ReplayArchive* archive) {
+    if (archive->data) munmap((void*)archive->data, archive->size);
+    *archive = (ReplayArchive){0};
+}
+
+void replay_archive_advise_sequential(const ReplayArchive* archive) {
+    madvise((void*)archive->data, archive->size, MADV_SEQUENTIAL);
+}
+
+const Move* replay_game_moves(const ReplayArchive* archive,
+                              const ReplayIndexEntry* entry) {
+    uint64_t len = (uint64_t)entry->moves_n * sizeof(Move);
+    if (entry->offset < sizeof(ReplayHeader) || entry->offset > archive->size ||
+        len > archive->size - entry->offset) {
+        return NULL;
+    }
+    return (const Move*)(archive->data + entry->offset);
+}
+
+uint64_t replay_filter_by_score(const ReplayArchive* archive, int min_score,
+                                int max_score, uint64_t* games_out,
+                                uint64_t games_cap) {
+    uint64_t matches_n = 0;
+    for (uint64_t i = 0; i < archive->games_n; ++i) {
+        int score = archive->index[i].score;
+        if (score >= min_score && score <= max_score) {
+            if (matches_n < games_cap) games_out[matches_n] = i;
+            matches_n++;
+        }
+    }
+    return matches_n;
+}
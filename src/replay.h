@@ -0,0 +1,89 @@
+#if !defined(REPLAY_H)
+#define REPLAY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// replay archive layout (native byte order):
+//   ReplayHeader
+//   move data of every game, Move[moves_n] each, in no particular order
+//   ReplayIndexEntry[games_n], sorted by offset, at header.index_offset
+//
+// a game is replayed by calling apply_move on make_gamestate(seed) with each
+// of its moves in order, under the shape set it was played with. archives
+// of another shape set are refused.
+
+#define REPLAY_MAGIC "RMRA"
+// bumped whenever the game rules change, old games would replay differently
+#define REPLAY_VERSION 3
+
+typedef struct ReplayHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t games_n;
+    uint64_t index_offset;
+    uint64_t shape_set_hash;  // get_shape_set_hash
+} ReplayHeader;
+
+typedef struct ReplayIndexEntry {
+    uint64_t offset;  // file offset of the game's moves
+    uint64_t seed;
+    int32_t score;
+    uint32_t moves_n;
+} ReplayIndexEntry;
+
+// writing: every thread appends through its own segment, which buffers
+// moves and index entries locally and reserves file space with an atomic
+// add, so appends never take a lock. closing the writer merges the segment
+// indices into the archive index.
+
+typedef struct ReplaySegment ReplaySegment;
+
+typedef struct ReplayWriter {
+    int fd;
+    _Atomic uint64_t tail;
+    _Atomic(ReplaySegment*) segments;
+} ReplayWriter;
+
+bool replay_writer_open(ReplayWriter* writer, const char* path);
+// safe to call from any thread, the segment must then only be used by it
+ReplaySegment* replay_writer_segment(ReplayWriter* writer);
+bool replay_segment_append(ReplaySegment* segment, uint64_t seed, int score,
+                           const Move* moves, uint32_t moves_n);
+// must only be called once all appending threads are done
+bool replay_writer_close(ReplayWriter* writer);
+
+// reading: the archive is mapped into memory and never copied
+
+typedef struct ReplayArchive {
+    const uint8_t* data;
+    size_t size;
+    uint64_t games_n;
+    const ReplayIndexEntry* index;
+} ReplayArchive;
+
+bool replay_archive_open(ReplayArchive* archive, const char* path);
+void replay_archive_close(ReplayArchive* archive);
+// hints the kernel that the archive is about to be streamed front to back
+void replay_archive_advise_sequential(const ReplayArchive* archive);
+
+static inline const ReplayIndexEntry* replay_game(const ReplayArchive* archive,
+                                                  uint64_t game) {
+    return game < archive->games_n ? &archive->index[game] : NULL;
+}
+
+// returns NULL if the entry points outside of the archive
+const Move* replay_game_moves(const ReplayArchive* archive,
+                              const ReplayIndexEntry* entry);
+
+// writes up to games_cap matching game indices to games_out, returns the
+// total amount of games with min_score <= score <= max_score
+uint64_t replay_filter_by_score(const ReplayArchive* archive, int min_score,
+                                int max_score, uint64_t* games_out,
+                                uint64_t games_cap);
+
+#endif  // REPLAY_H
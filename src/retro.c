@@ -0,0 +1,679 @@
+#define _GNU_SOURCE
+#include "retro.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "block.h"
+#include "parallel.h"
+
+#define RETRO_CODES_MAX (BLOCK_SHAPES_MAX * 4)
+#define RETRO_PAIRS_MAX (RETRO_CODES_MAX * (RETRO_CODES_MAX + 1) / 2)
+#define RETRO_DEALS_MAX \
+    (RETRO_CODES_MAX * (RETRO_CODES_MAX + 1) * (RETRO_CODES_MAX + 2) / 6)
+#define RETRO_CHUNK_SLOTS 4096
+// a table is full once this share of its slots is used, the probes get
+// long past it
+#define RETRO_MAX_LOAD 0.85
+// the value tables are sized for the boards found, at most this full
+#define RETRO_VALUE_LOAD 0.7
+// values of the turn starts, the current and the next horizon
+#define RETRO_VALUE_COLUMNS 2
+
+// open addressing table of packed boards, every slot is the key plus one,
+// 0 for empty, followed by a row of float values
+typedef struct RetroTable {
+    uint8_t* slots;
+    size_t stride;
+    uint64_t mask;
+    size_t bytes;
+    bool on_disk;
+    _Atomic uint64_t boards_n;
+} RetroTable;
+
+struct RetroSolver {
+    RetroParams params;
+    unsigned row;  // the cells of one row of the small field
+    // the distinct block masks that are dealt, and the chance of each
+    int codes_n;
+    Board code_cells[RETRO_CODES_MAX];
+    Board code_origins[RETRO_CODES_MAX];
+    double code_chances[RETRO_CODES_MAX];
+    // index of the unordered pair of two codes
+    int pairs[RETRO_CODES_MAX][RETRO_CODES_MAX];
+    int pairs_n;
+    // sorted code triples and the chance of being dealt them in any order
+    int deals_n;
+    uint8_t deals[RETRO_DEALS_MAX][HELD_BLOCKS_N];
+    double deal_chances[RETRO_DEALS_MAX];
+    RetroTable tables[RETRO_PHASES_N];
+    size_t ram_left;
+    int turns_n;
+};
+
+static_assert(HELD_BLOCKS_N == RETRO_PHASES_N,
+              "the passes are written for three blocks a turn");
+
+RetroParams make_retro_params(int size) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    const char* tmp = getenv("TMPDIR");
+    int bits = size * size + 1;
+    return (RetroParams){
+        .size = size,
+        .threads_n = parallel_default_threads(),
+        .table_bits = bits < 26 ? bits : 26,
+        .ram_budget = pages > 0 && page_size > 0
+                          ? (size_t)pages * page_size / 2
+                          : (size_t)1 << 30,
+        .spill_dir = tmp ? tmp : "/tmp",
+    };
+}
+
+static uint64_t pack_board(const RetroSolver* solver, Board board) {
+    int size = solver->params.size;
+    uint64_t packed = 0;
+    for (int y = 0; y < size; ++y) {
+        packed |= (board >> y * FIELD_SIZE & solver->row) << y * size;
+    }
+    return packed;
+}
+
+static Board unpack_board(const RetroSolver* solver, uint64_t packed) {
+    int size = solver->params.size;
+    Board board = 0;
+    for (int y = 0; y < size; ++y) {
+        board |= (packed >> y * size & solver->row) << y * FIELD_SIZE;
+    }
+    return board;
+}
+
+// clear_field on the small field
+static Board clear_lines(const RetroSolver* solver, Board board) {
+    int size = solver->params.size;
+    Board cleared = 0;
+    Board cols = solver->row;
+    for (int y = 0; y < size; ++y) {
+        Board row = board >> y * FIELD_SIZE & solver->row;
+        if (row == solver->row) cleared |= row << y * FIELD_SIZE;
+        cols &= row;
+    }
+    for (int y = 0; y < size; ++y) cleared |= cols << y * FIELD_SIZE;
+    return board & ~cleared;
+}
+
+static uint64_t hash_key(uint64_t key) {
+    key ^= key >> 31;
+    key *= 0x9e3779b97f4a7c15ull;
+    return key ^ key >> 29;
+}
+
+static _Atomic uint64_t* slot_key(const RetroTable* table, uint64_t slot) {
+    return (_Atomic uint64_t*)(table->slots + slot * table->stride);
+}
+
+static float* slot_values(const RetroTable* table, uint64_t slot) {
+    return (float*)(table->slots + slot * table->stride + sizeof(uint64_t));
+}
+
+static bool table_init(RetroSolver* solver, RetroTable* table, int bits,
+                       int values_n) {
+    size_t slots_n = (size_t)1 << bits;
+    table->stride = sizeof(uint64_t) + sizeof(float) * values_n;
+    table->stride = (table->stride + 7) & ~(size_t)7;
+    table->mask = slots_n - 1;
+    table->bytes = table->stride * slots_n;
+    atomic_init(&table->boards_n, 0);
+
+    void* slots;
+    if (table->bytes <= solver->ram_left) {
+        solver->ram_left -= table->bytes;
+        slots = mmap(NULL, table->bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    } else {
+        // the file is gone once unmapped, nothing is left behind on disk
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/retro-XXXXXX",
+                 solver->params.spill_dir);
+        int fd = mkstemp(path);
+        if (fd < 0) return false;
+        unlink(path);
+        if (ftruncate(fd, (off_t)table->bytes) != 0) {
+            close(fd);
+            return false;
+        }
+        slots = mmap(NULL, table->bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+        close(fd);
+        table->on_disk = true;
+    }
+    if (slots == MAP_FAILED) return false;
+    table->slots = slots;
+    return true;
+}
+
+static void table_free(RetroSolver* solver, RetroTable* table) {
+    if (!table->slots) return;
+    munmap(table->slots, table->bytes);
+    if (!table->on_disk) solver->ram_left += table->bytes;
+    *table = (RetroTable){0};
+}
+
+static const float* table_find(const RetroTable* table, uint64_t key) {
+    uint64_t stored = key + 1;
+    for (uint64_t slot = hash_key(key) & table->mask;;
+         slot = (slot + 1) & table->mask) {
+        uint64_t found = atomic_load_explicit(slot_key(table, slot),
+                                              memory_order_relaxed);
+        if (found == stored) return slot_values(table, slot);
+        if (found == 0) return NULL;
+    }
+}
+
+// returns 1 if the key is new, 0 if it was there and -1 if the table is full
+// or past its load. a full table is given up on after probing every slot
+static int table_insert(RetroTable* table, uint64_t key) {
+    uint64_t stored = key + 1;
+    uint64_t slot = hash_key(key) & table->mask;
+    for (uint64_t probes = 0; probes <= table->mask;
+         ++probes, slot = (slot + 1) & table->mask) {
+        uint64_t found = 0;
+        if (atomic_compare_exchange_strong(slot_key(table, slot), &found,
+                                           stored)) {
+            uint64_t boards_n = atomic_fetch_add(&table->boards_n, 1) + 1;
+            return boards_n > RETRO_MAX_LOAD * (table->mask + 1) ? -1 : 1;
+        }
+        if (found == stored) return 0;
+    }
+    return -1;
+}
+
+static void init_codes(RetroSolver* solver) {
+    int size = solver->params.size;
+    const BlockMask* masks = get_block_masks();
+    for (int i = 0; i < get_shapes_n() * 4; ++i) {
+        int code = 0;
+        while (code < solver->codes_n &&
+               solver->code_cells[code] != masks[i].cells) {
+            code++;
+        }
+        if (code == solver->codes_n) {
+            solver->codes_n++;
+            solver->code_cells[code] = masks[i].cells;
+            for (int y = 0; y + masks[i].height <= size; ++y) {
+                for (int x = 0; x + masks[i].width <= size; ++x) {
+                    solver->code_origins[code] |=
+                        board_cell(y * FIELD_SIZE + x);
+                }
+            }
+        }
+        // every rotation of a shape is dealt as likely
+        solver->code_chances[code] += get_shape_chance(i / 4) / 4;
+    }
+
+    for (int a = 0; a < solver->codes_n; ++a) {
+        for (int b = a; b < solver->codes_n; ++b) {
+            solver->pairs[a][b] = solver->pairs[b][a] = solver->pairs_n++;
+            for (int c = b; c < solver->codes_n; ++c) {
+                int deal = solver->deals_n++;
+                solver->deals[deal][0] = a;
+                solver->deals[deal][1] = b;
+                solver->deals[deal][2] = c;
+                // the orders the three blocks can come in
+                int orders = a == c ? 1 : a == b || b == c ? 3 : 6;
+                solver->deal_chances[deal] = orders * solver->code_chances[a] *
+                                             solver->code_chances[b] *
+                                             solver->code_chances[c];
+            }
+        }
+    }
+}
+
+RetroSolver* retro_solver_new(const RetroParams* params) {
+    if (params->size < RETRO_SIZE_MIN || params->size > RETRO_SIZE_MAX ||
+        params->table_bits < 1 || params->table_bits > 40) {
+        return NULL;
+    }
+    RetroSolver* solver = calloc(1, sizeof(*solver));
+    if (!solver) return NULL;
+    solver->params = *params;
+    if (solver->params.threads_n < 1) solver->params.threads_n = 1;
+    solver->row = (1u << params->size) - 1;
+    init_codes(solver);
+
+    // only the boards until they are all found
+    solver->ram_left = params->ram_budget;
+    for (int phase = 0; phase < RETRO_PHASES_N; ++phase) {
+        if (!table_init(solver, &solver->tables[phase], params->table_bits,
+                        0)) {
+            retro_solver_free(solver);
+            return NULL;
+        }
+    }
+    return solver;
+}
+
+void retro_solver_free(RetroSolver* solver) {
+    if (!solver) return;
+    for (int phase = 0; phase < RETRO_PHASES_N; ++phase) {
+        table_free(solver, &solver->tables[phase]);
+    }
+    free(solver);
+}
+
+// enumeration, breadth first over (board, phase) one block at a time. an
+// entry of the frontier is the packed board with the phase on top
+
+#define RETRO_PHASE_SHIFT 56
+
+typedef struct BoardList {
+    uint64_t* items;
+    size_t n;
+    size_t cap;
+} BoardList;
+
+typedef struct EnumerateCtx {
+    RetroSolver* solver;
+    const BoardList* frontier;
+    BoardList* found;  // per thread
+    _Atomic size_t next;
+    _Atomic bool overflowed;
+} EnumerateCtx;
+
+static bool board_list_push(BoardList* list, uint64_t item) {
+    if (list->n == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 1024;
+        uint64_t* items = realloc(list->items, sizeof(*items) * cap);
+        if (!items) return false;
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->n++] = item;
+    return true;
+}
+
+static void enumerate_thread(void* arg, int thread_index, int threads_n) {
+    (void)threads_n;
+    EnumerateCtx* ctx = arg;
+    RetroSolver* solver = ctx->solver;
+    BoardList* found = &ctx->found[thread_index];
+    for (;;) {
+        size_t first = atomic_fetch_add(&ctx->next, RETRO_CHUNK_SLOTS);
+        if (first >= ctx->frontier->n) break;
+        size_t last = first + RETRO_CHUNK_SLOTS;
+        if (last > ctx->frontier->n) last = ctx->frontier->n;
+
+        for (size_t i = first; i < last; ++i) {
+            uint64_t item = ctx->frontier->items[i];
+            // the phase of the boards a placement leads to
+            int phase = ((item >> RETRO_PHASE_SHIFT) + 1) % RETRO_PHASES_N;
+            Board board = unpack_board(
+                solver, item & (((uint64_t)1 << RETRO_PHASE_SHIFT) - 1));
+            RetroTable* table = &solver->tables[phase];
+            for (int code = 0; code < solver->codes_n; ++code) {
+                Board cells = solver->code_cells[code];
+                for (Board origins = solver->code_origins[code]; origins;
+                     origins &= origins - 1) {
+                    // a chunk can insert more boards than the table has
+                    // room left for
+                    if (atomic_load_explicit(&ctx->overflowed,
+                                             memory_order_relaxed)) {
+                        return;
+                    }
+                    Board placed = cells << __builtin_ctzll(origins);
+                    if (board & placed) continue;
+                    uint64_t key =
+                        pack_board(solver, clear_lines(solver, board | placed));
+                    int inserted = table_insert(table, key);
+                    if (inserted < 0) atomic_store(&ctx->overflowed, true);
+                    if (inserted > 0 &&
+                        !board_list_push(found,
+                                         key | (uint64_t)phase
+                                                   << RETRO_PHASE_SHIFT)) {
+                        atomic_store(&ctx->overflowed, true);
+                    }
+                }
+            }
+        }
+        if (atomic_load(&ctx->overflowed)) break;
+    }
+}
+
+typedef struct RehashCtx {
+    const RetroTable* from;
+    RetroTable* to;
+    _Atomic uint64_t next;
+    _Atomic bool overflowed;
+} RehashCtx;
+
+static void rehash_thread(void* arg, int thread_index, int threads_n) {
+    (void)thread_index;
+    (void)threads_n;
+    RehashCtx* ctx = arg;
+    for (;;) {
+        uint64_t first = atomic_fetch_add(&ctx->next, RETRO_CHUNK_SLOTS);
+        if (first > ctx->from->mask) break;
+        uint64_t last = first + RETRO_CHUNK_SLOTS;
+        if (last > ctx->from->mask + 1) last = ctx->from->mask + 1;
+        for (uint64_t slot = first; slot < last; ++slot) {
+            uint64_t stored = atomic_load_explicit(slot_key(ctx->from, slot),
+                                                   memory_order_relaxed);
+            if (stored && table_insert(ctx->to, stored - 1) < 0) {
+                atomic_store(&ctx->overflowed, true);
+                return;
+            }
+        }
+    }
+}
+
+// swaps the table of found boards for one with room for the values, sized
+// for the boards there are
+static bool make_value_table(RetroSolver* solver, int phase, int values_n) {
+    RetroTable* boards = &solver->tables[phase];
+    uint64_t boards_n = atomic_load(&boards->boards_n);
+    int bits = 1;
+    while (boards_n > RETRO_VALUE_LOAD * ((uint64_t)1 << bits)) bits++;
+
+    RetroTable values = {0};
+    if (!table_init(solver, &values, bits, values_n)) return false;
+    RehashCtx ctx = {.from = boards, .to = &values};
+    if (!parallel_run(solver->params.threads_n, rehash_thread, &ctx)) {
+        rehash_thread(&ctx, 0, 1);
+    }
+    if (atomic_load(&ctx.overflowed)) {
+        table_free(solver, &values);
+        return false;
+    }
+    table_free(solver, boards);
+    memcpy(boards, &values, sizeof(values));
+    return true;
+}
+
+bool retro_enumerate(RetroSolver* solver) {
+    int threads_n = solver->params.threads_n;
+    BoardList frontier = {0};
+    BoardList* found = calloc(threads_n, sizeof(*found));
+    bool ok = found && table_insert(&solver->tables[0], 0) >= 0 &&
+              board_list_push(&frontier, 0);
+
+    while (ok && frontier.n) {
+        EnumerateCtx ctx = {
+            .solver = solver,
+            .frontier = &frontier,
+            .found = found,
+        };
+        if (!parallel_run(threads_n, enumerate_thread, &ctx)) {
+            enumerate_thread(&ctx, 0, 1);
+        }
+        ok = !atomic_load(&ctx.overflowed);
+
+        frontier.n = 0;
+        for (int i = 0; i < threads_n && ok; ++i) {
+            for (size_t j = 0; j < found[i].n && ok; ++j) {
+                ok = board_list_push(&frontier, found[i].items[j]);
+            }
+            found[i].n = 0;
+        }
+    }
+
+    for (int i = 0; found && i < threads_n; ++i) free(found[i].items);
+    free(found);
+    free(frontier.items);
+    if (!ok) return false;
+
+    int values_n[RETRO_PHASES_N] = {
+        RETRO_VALUE_COLUMNS,
+        solver->pairs_n,
+        solver->codes_n,
+    };
+    for (int phase = 0; phase < RETRO_PHASES_N; ++phase) {
+        if (!make_value_table(solver, phase, values_n[phase])) return false;
+    }
+
+    // surviving zero more turns is certain
+    RetroTable* starts = &solver->tables[0];
+    for (uint64_t slot = 0; slot <= starts->mask; ++slot) {
+        if (atomic_load_explicit(slot_key(starts, slot), memory_order_relaxed)) {
+            slot_values(starts, slot)[0] = 1;
+        }
+    }
+    solver->turns_n = 0;
+    return true;
+}
+
+// one backwards pass over the boards of a phase, every pass reads the
+// table of the phase after it
+
+typedef struct PassCtx {
+    RetroSolver* solver;
+    int phase;
+    int from_column;  // of the turn start values
+    _Atomic uint64_t next;
+    double* max_changes;  // per thread
+} PassCtx;
+
+static const float* get_child_values(const RetroSolver* solver, int phase,
+                                     Board board) {
+    const float* values = table_find(&solver->tables[phase],
+                                     pack_board(solver,
+                                                clear_lines(solver, board)));
+    assert(values && "enumeration missed a board");
+    return values;
+}
+
+// two blocks placed, the values of the last block of every code
+static void pass_last_block(const RetroSolver* solver, Board board,
+                            float* values, int from_column) {
+    for (int code = 0; code < solver->codes_n; ++code) {
+        float best = 0;
+        Board cells = solver->code_cells[code];
+        for (Board origins = solver->code_origins[code]; origins;
+             origins &= origins - 1) {
+            Board placed = cells << __builtin_ctzll(origins);
+            if (board & placed) continue;
+            float value =
+                get_child_values(solver, 0, board | placed)[from_column];
+            if (value > best) best = value;
+        }
+        values[code] = best;
+    }
+}
+
+// one block placed, the values of every pair of blocks left, in either
+// order
+static void pass_block_pair(const RetroSolver* solver, Board board,
+                            float* values) {
+    for (int pair = 0; pair < solver->pairs_n; ++pair) values[pair] = 0;
+    for (int code = 0; code < solver->codes_n; ++code) {
+        Board cells = solver->code_cells[code];
+        for (Board origins = solver->code_origins[code]; origins;
+             origins &= origins - 1) {
+            Board placed = cells << __builtin_ctzll(origins);
+            if (board & placed) continue;
+            const float* last = get_child_values(solver, 2, board | placed);
+            const int* pairs = solver->pairs[code];
+            for (int other = 0; other < solver->codes_n; ++other) {
+                if (last[other] > values[pairs[other]]) {
+                    values[pairs[other]] = last[other];
+                }
+            }
+        }
+    }
+}
+
+// a turn start, the chance to survive over all deals
+static double pass_turn_start(const RetroSolver* solver, Board board) {
+    // best value with the code placed first and the pair left
+    float first[RETRO_CODES_MAX][RETRO_PAIRS_MAX];
+    for (int code = 0; code < solver->codes_n; ++code) {
+        for (int pair = 0; pair < solver->pairs_n; ++pair) {
+            first[code][pair] = 0;
+        }
+        Board cells = solver->code_cells[code];
+        for (Board origins = solver->code_origins[code]; origins;
+             origins &= origins - 1) {
+            Board placed = cells << __builtin_ctzll(origins);
+            if (board & placed) continue;
+            const float* pairs = get_child_values(solver, 1, board | placed);
+            for (int pair = 0; pair < solver->pairs_n; ++pair) {
+                if (pairs[pair] > first[code][pair]) {
+                    first[code][pair] = pairs[pair];
+                }
+            }
+        }
+    }
+
+    double value = 0;
+    for (int deal = 0; deal < solver->deals_n; ++deal) {
+        int a = solver->deals[deal][0];
+        int b = solver->deals[deal][1];
+        int c = solver->deals[deal][2];
+        float best = first[a][solver->pairs[b][c]];
+        if (first[b][solver->pairs[a][c]] > best) {
+            best = first[b][solver->pairs[a][c]];
+        }
+        if (first[c][solver->pairs[a][b]] > best) {
+            best = first[c][solver->pairs[a][b]];
+        }
+        value += solver->deal_chances[deal] * best;
+    }
+    return value;
+}
+
+static void pass_thread(void* arg, int thread_index, int threads_n) {
+    (void)threads_n;
+    PassCtx* ctx = arg;
+    const RetroSolver* solver = ctx->solver;
+    const RetroTable* table = &solver->tables[ctx->phase];
+    double max_change = 0;
+    for (;;) {
+        uint64_t first = atomic_fetch_add(&ctx->next, RETRO_CHUNK_SLOTS);
+        if (first > table->mask) break;
+        uint64_t last = first + RETRO_CHUNK_SLOTS;
+        if (last > table->mask + 1) last = table->mask + 1;
+
+        for (uint64_t slot = first; slot < last; ++slot) {
+            uint64_t stored = atomic_load_explicit(slot_key(table, slot),
+                                                   memory_order_relaxed);
+            if (!stored) continue;
+            Board board = unpack_board(solver, stored - 1);
+            float* values = slot_values(table, slot);
+            switch (ctx->phase) {
+                case 0: {
+                    double value = pass_turn_start(solver, board);
+                    double change = values[ctx->from_column] - value;
+                    if (change > max_change) max_change = change;
+                    values[!ctx->from_column] = value;
+                    break;
+                }
+                case 1:
+                    pass_block_pair(solver, board, values);
+                    break;
+                case 2:
+                    pass_last_block(solver, board, values, ctx->from_column);
+                    break;
+            }
+        }
+    }
+    ctx->max_changes[thread_index] = max_change;
+}
+
+double retro_iterate(RetroSolver* solver) {
+    int threads_n = solver->params.threads_n;
+    double* max_changes = calloc(threads_n, sizeof(*max_changes));
+    if (!max_changes) return -1;
+    for (int phase = RETRO_PHASES_N - 1; phase >= 0; --phase) {
+        PassCtx ctx = {
+            .solver = solver,
+            .phase = phase,
+            .from_column = solver->turns_n & 1,
+            .max_changes = max_changes,
+        };
+        if (!parallel_run(threads_n, pass_thread, &ctx)) {
+            pass_thread(&ctx, 0, 1);
+        }
+    }
+    solver->turns_n++;
+
+    // a longer horizon never makes surviving more likely
+    double max_change = 0;
+    for (int i = 0; i < threads_n; ++i) {
+        if (max_changes[i] > max_change) max_change = max_changes[i];
+    }
+    free(max_changes);
+    return max_change;
+}
+
+void retro_get_stats(const RetroSolver* solver, RetroStats* stats_out) {
+    *stats_out = (RetroStats){.turns_n = solver->turns_n};
+    for (int phase = 0; phase < RETRO_PHASES_N; ++phase) {
+        const RetroTable* table = &solver->tables[phase];
+        stats_out->boards_n[phase] = atomic_load(&table->boards_n);
+        stats_out->table_bytes[phase] = table->bytes;
+        stats_out->on_disk[phase] = table->on_disk;
+    }
+}
+
+double retro_value(const RetroSolver* solver, Board occupied) {
+    Board field = 0;
+    for (int y = 0; y < solver->params.size; ++y) {
+        field |= (Board)solver->row << y * FIELD_SIZE;
+    }
+    if (occupied & ~field) return -1;
+    const float* values =
+        table_find(&solver->tables[0], pack_board(solver, occupied));
+    return values ? values[solver->turns_n & 1] : -1;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+bool retro_export(const RetroSolver* solver, const char* path) {
+    const RetroTable* starts = &solver->tables[0];
+    uint64_t boards_n = atomic_load(&starts->boards_n);
+    uint64_t* boards = malloc(sizeof(*boards) * (boards_n ? boards_n : 1));
+    uint16_t* values = malloc(sizeof(*values) * (boards_n ? boards_n : 1));
+    FILE* file = fopen(path, "wb");
+    bool ok = boards && values && file;
+
+    if (ok) {
+        uint64_t n = 0;
+        for (uint64_t slot = 0; slot <= starts->mask; ++slot) {
+            uint64_t stored = atomic_load_explicit(slot_key(starts, slot),
+                                                   memory_order_relaxed);
+            if (stored) boards[n++] = stored - 1;
+        }
+        assert(n == boards_n);
+        qsort(boards, boards_n, sizeof(*boards), compare_u64);
+        int column = solver->turns_n & 1;
+        for (uint64_t i = 0; i < boards_n; ++i) {
+            float value = table_find(starts, boards[i])[column];
+            values[i] = (uint16_t)(value * 65535 + 0.5f);
+        }
+
+        RetroExportHeader header = {
+            .magic = RETRO_EXPORT_MAGIC,
+            .version = RETRO_EXPORT_VERSION,
+            .size = solver->params.size,
+            .turns_n = solver->turns_n,
+            .boards_n = boards_n,
+            .shape_set_hash = get_shape_set_hash(),
+        };
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(boards, sizeof(*boards), boards_n, file) == boards_n &&
+             fwrite(values, sizeof(*values), boards_n, file) == boards_n;
+    }
+    if (file) ok &= fclose(file) == 0;
+    free(values);
+    free(boards);
+    return ok;
+}
@@ -0,0 +1,85 @@
+#if !defined(RETRO_H)
+#define RETRO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+
+// exact perfect play on a small size x size field with the same shapes,
+// deals and line clears as the real one. the solver enumerates every board
+// reachable from the empty field, after 0, 1 or 2 blocks of a turn, and then
+// works backwards one turn at a time: the value of a turn start is the
+// chance to survive the next turns when the blocks are dealt at random and
+// always placed the best way.
+//
+// the boards live on the bitboard layout, in the top left corner. the value
+// tables are hash tables in anonymous memory, or in unlinked files under
+// spill_dir once they would go past the ram budget, so the kernel pages
+// them out to disk instead of the solver running out of memory.
+
+#define RETRO_SIZE_MIN 3
+#define RETRO_SIZE_MAX 7
+// the tables of turn starts, and after one and two placed blocks
+#define RETRO_PHASES_N 3
+
+typedef struct RetroParams {
+    int size;
+    int threads_n;
+    // log2 of the slots of the tables the boards are enumerated into. the
+    // value tables are sized for the boards found after that
+    int table_bits;
+    size_t ram_budget;  // bytes
+    const char* spill_dir;
+} RetroParams;
+
+typedef struct RetroStats {
+    uint64_t boards_n[RETRO_PHASES_N];
+    size_t table_bytes[RETRO_PHASES_N];
+    bool on_disk[RETRO_PHASES_N];
+    int turns_n;  // horizon of the current values
+} RetroStats;
+
+typedef struct RetroSolver RetroSolver;
+
+#define RETRO_EXPORT_MAGIC "RMRT"
+#define RETRO_EXPORT_VERSION 2
+
+// export layout (native byte order):
+//   RetroExportHeader
+//   uint64_t boards[boards_n], packed row by row, size bits a row, sorted
+//   uint16_t values[boards_n], the chance to survive times 65535
+
+typedef struct RetroExportHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+    uint32_t turns_n;
+    uint64_t boards_n;
+    // get_shape_set_hash, the values mean nothing under another set
+    uint64_t shape_set_hash;
+} RetroExportHeader;
+
+// sensible defaults for a field size: every core, half of the physical
+// memory and the system's temporary directory
+RetroParams make_retro_params(int size);
+
+// init_block_masks must have been called. NULL if the tables can't be
+// made
+RetroSolver* retro_solver_new(const RetroParams* params);
+void retro_solver_free(RetroSolver* solver);
+
+// fills the tables with every reachable board, false if one overflowed.
+// the values start out at 1, surviving zero turns
+bool retro_enumerate(RetroSolver* solver);
+// adds a turn to the horizon, returns the largest change of a value or -1
+// if it ran out of memory
+double retro_iterate(RetroSolver* solver);
+
+void retro_get_stats(const RetroSolver* solver, RetroStats* stats_out);
+// the value of a turn start, -1 if the board can't be reached
+double retro_value(const RetroSolver* solver, Board occupied);
+bool retro_export(const RetroSolver* solver, const char* path);
+
+#endif  // RETRO_H
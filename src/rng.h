@@ -0,0 +1,25 @@
+#if !defined(RNG_H)
+#define RNG_H
+
+#include <stdint.h>
+
+// per-game random number generator (splitmix64), so a game can be replayed
+// from its seed alone
+typedef struct Rng {
+    uint64_t state;
+} Rng;
+
+static inline Rng make_rng(uint64_t seed) { return (Rng){.state = seed}; }
+
+static inline uint64_t rng_next(Rng* rng) {
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline int rng_range(Rng* rng, int n) {
+    return (int)(rng_next(rng) % (uint64_t)n);
+}
+
+#endif  // RNG_H
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+#include "save.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t get_fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// words of a field of this size, the save keeps no more than that
+static int get_save_words_n(int size) { return (size * size + 63) / 64; }
+
+static size_t get_payload_size(int size) {
+    return 1 + CELL_COLORS_N * get_save_words_n(size) * sizeof(uint64_t) +
+           2 * sizeof(int32_t) + 3 + HELD_BLOCKS_N + 2 * sizeof(uint64_t);
+}
+
+size_t encode_save(const WideState* state, uint64_t seed, uint8_t* out) {
+    int size = state->geometry->size;
+    int words_n = get_save_words_n(size);
+    uint8_t* p = out + sizeof(SaveHeader);
+    *p++ = size;
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        memcpy(p, state->field[color].words, words_n * sizeof(uint64_t));
+        p += words_n * sizeof(uint64_t);
+    }
+    int32_t counters[2] = {state->points, state->combo};
+    memcpy(p, counters, sizeof(counters));
+    p += sizeof(counters);
+    *p++ = state->blocks_placed;
+    *p++ = state->block_selected;
+    *p++ = state->cleared_in_turn;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        *p++ = pack_block(&state->held_blocks[i]);
+    }
+    memcpy(p, &state->rng.state, sizeof(uint64_t));
+    p += sizeof(uint64_t);
+    memcpy(p, &seed, sizeof(uint64_t));
+    p += sizeof(uint64_t);
+
+    size_t payload_size = p - out - sizeof(SaveHeader);
+    SaveHeader header = {
+        .version = SAVE_VERSION,
+        .checksum = get_fnv1a(out + sizeof(SaveHeader), payload_size),
+        .shape_set_hash = get_shape_set_hash(),
+        .payload_size = payload_size,
+    };
+    memcpy(header.magic, SAVE_MAGIC, sizeof(header.magic));
+    memcpy(out, &header, sizeof(header));
+    return p - out;
+}
+
+static bool block_is_valid(const Block* block) {
+    if (block->item == CELL_ITEM_EMPTY) return true;
+    return block->item <= CELL_COLORS_N && (int)block->shape < get_shapes_n();
+}
+
+bool decode_save(const uint8_t* data, size_t size, WideState* state_out,
+                 uint64_t* seed_out) {
+    SaveHeader header;
+    if (size < sizeof(header) + 1) return false;
+    memcpy(&header, data, sizeof(header));
+    const uint8_t* p = data + sizeof(header);
+    if (memcmp(header.magic, SAVE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SAVE_VERSION ||
+        header.shape_set_hash != get_shape_set_hash() ||
+        header.payload_size != size - sizeof(header) ||
+        header.checksum != get_fnv1a(p, header.payload_size)) {
+        return false;
+    }
+    int field_size = *p++;
+    const WideGeometry* geometry = get_wide_geometry(field_size);
+    if (!geometry || header.payload_size != get_payload_size(field_size)) {
+        return false;
+    }
+
+    WideState state = {.geometry = geometry};
+    int words_n = get_save_words_n(field_size);
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        memcpy(state.field[color].words, p, words_n * sizeof(uint64_t));
+        p += words_n * sizeof(uint64_t);
+    }
+    int32_t counters[2];
+    memcpy(counters, p, sizeof(counters));
+    p += sizeof(counters);
+    state.points = counters[0];
+    state.combo = counters[1];
+    state.blocks_placed = *p++;
+    state.block_selected = *p++;
+    uint8_t cleared_in_turn = *p++;
+    state.cleared_in_turn = cleared_in_turn;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        state.held_blocks[i] = unpack_block(*p++);
+        if (!block_is_valid(&state.held_blocks[i])) return false;
+    }
+    memcpy(&state.rng.state, p, sizeof(uint64_t));
+    p += sizeof(uint64_t);
+    uint64_t seed;
+    memcpy(&seed, p, sizeof(uint64_t));
+
+    // the colors may only cover cells of the field, and each one once
+    for (int w = 0; w < WIDE_WORDS_MAX; ++w) {
+        uint64_t cells = 0;
+        for (int r = 0; r < field_size; ++r) {
+            cells |= geometry->rows[r].words[w];
+        }
+        uint64_t seen = 0;
+        for (int color = 0; color < CELL_COLORS_N; ++color) {
+            uint64_t word = state.field[color].words[w];
+            if ((word & ~cells) || (word & seen)) return false;
+            seen |= word;
+        }
+    }
+    // the last block of a turn deals new ones, so a turn always has a
+    // block left and every placed one left its slot empty
+    if (state.points < 0 || state.combo < 1 ||
+        state.blocks_placed >= HELD_BLOCKS_N ||
+        state.block_selected >= HELD_BLOCKS_N || cleared_in_turn > 1) {
+        return false;
+    }
+    int empty_n = 0;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        empty_n += state.held_blocks[i].item == CELL_ITEM_EMPTY;
+    }
+    if (empty_n != state.blocks_placed) return false;
+    *state_out = state;
+    *seed_out = seed;
+    return true;
+}
+
+bool load_save(const char* path, WideState* state_out, uint64_t* seed_out) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    uint8_t data[SAVE_SIZE_MAX + 1];
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    return size <= SAVE_SIZE_MAX &&
+           decode_save(data, size, state_out, seed_out);
+}
+
+static void* autosaver_main(void* arg) {
+    Autosaver* saver = arg;
+    uint8_t data[SAVE_SIZE_MAX];
+    pthread_mutex_lock(&saver->mutex);
+    for (;;) {
+        while (!saver->pending_size && !saver->stopping) {
+            pthread_cond_wait(&saver->changed, &saver->mutex);
+        }
+        if (!saver->pending_size) break;
+
+        // whatever else comes in until the delay is over replaces it
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        int64_t nanoseconds = deadline.tv_nsec + (int64_t)(saver->delay * 1e9);
+        deadline.tv_sec += nanoseconds / 1000000000;
+        deadline.tv_nsec = nanoseconds % 1000000000;
+        while (!saver->stopping &&
+               pthread_cond_timedwait(&saver->changed, &saver->mutex,
+                                      &deadline) != ETIMEDOUT) {
+        }
+
+        size_t size = saver->pending_size;
+        memcpy(data, saver->pending, size);
+        saver->pending_size = 0;
+        pthread_mutex_unlock(&saver->mutex);
+        bool ok = write_file_atomic(saver->path, data, size);
+        pthread_mutex_lock(&saver->mutex);
+        saver->writes_n += ok;
+        saver->failures_n += !ok;
+    }
+    pthread_mutex_unlock(&saver->mutex);
+    return NULL;
+}
+
+bool autosaver_start(Autosaver* saver, const char* path, double delay) {
+    *saver = (Autosaver){.delay = delay};
+    if (strlen(path) >= sizeof(saver->path)) return false;
+    strcpy(saver->path, path);
+    pthread_mutex_init(&saver->mutex, NULL);
+    pthread_cond_init(&saver->changed, NULL);
+    if (pthread_create(&saver->thread, NULL, autosaver_main, saver) != 0) {
+        pthread_mutex_destroy(&saver->mutex);
+        pthread_cond_destroy(&saver->changed);
+        return false;
+    }
+    return true;
+}
+
+void autosaver_submit(Autosaver* saver, const uint8_t* data, size_t size) {
+    pthread_mutex_lock(&saver->mutex);
+    memcpy(saver->pending, data, size);
+    saver->pending_size = size;
+    pthread_cond_signal(&saver->changed);
+    pthread_mutex_unlock(&saver->mutex);
+}
+
+void autosaver_stop(Autosaver* saver) {
+    pthread_mutex_lock(&saver->mutex);
+    saver->stopping = true;
+    pthread_cond_signal(&saver->changed);
+    pthread_mutex_unlock(&saver->mutex);
+    pthread_join(saver->thread, NULL);
+    pthread_mutex_destroy(&saver->mutex);
+    pthread_cond_destroy(&saver->changed);
+}
@@ -0,0 +1,75 @@
+#if !defined(SAVE_H)
+#define SAVE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fileio.h"
+#include "wide.h"
+
+// save files of the game in progress (native byte order):
+//   SaveHeader
+//   uint8_t field size
+//   uint64_t cells of each color, as many words as the size needs
+//   int32_t points, combo
+//   uint8_t blocks placed, block selected, cleared in turn
+//   PackedBlock held blocks
+//   uint64_t rng state
+//   uint64_t seed the game started from, for the leaderboard
+//
+// the checksum covers everything after the header, so a torn or damaged
+// file is refused rather than restored into a broken game. the rng is
+// saved too, a restored game deals exactly the blocks it would have, which
+// it only can under the same shape set, so a save of another one is
+// refused as well.
+
+#define SAVE_MAGIC "RMSV"
+// bumped whenever the layout or the game rules change
+#define SAVE_VERSION 3
+#define SAVE_SIZE_MAX                                                   \
+    (sizeof(SaveHeader) + 1 + CELL_COLORS_N * WIDE_WORDS_MAX * 8 + 8 + \
+     3 + HELD_BLOCKS_N + 8 + 8)
+
+typedef struct SaveHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t checksum;  // fnv-1a of the payload
+    uint64_t shape_set_hash;  // get_shape_set_hash
+    uint32_t payload_size;
+    uint32_t reserved;
+} SaveHeader;
+
+// the save of the state, started from seed, in out, which holds
+// SAVE_SIZE_MAX bytes. returns its size
+size_t encode_save(const WideState* state, uint64_t seed, uint8_t* out);
+// false if the data isn't an intact save of this version played with the
+// shape set loaded now
+bool decode_save(const uint8_t* data, size_t size, WideState* state_out,
+                 uint64_t* seed_out);
+bool load_save(const char* path, WideState* state_out, uint64_t* seed_out);
+
+// writes saves on a thread of its own. the render loop hands over the
+// encoded bytes and moves on, saves submitted within the delay of each
+// other are coalesced into one write of the latest
+typedef struct Autosaver {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    char path[FILEIO_PATH_MAX];
+    double delay;  // seconds
+    uint8_t pending[SAVE_SIZE_MAX];
+    size_t pending_size;  // 0 if nothing is waiting
+    bool stopping;
+    uint64_t writes_n;
+    uint64_t failures_n;
+} Autosaver;
+
+bool autosaver_start(Autosaver* saver, const char* path, double delay);
+// takes a copy, never waits for the disk
+void autosaver_submit(Autosaver* saver, const uint8_t* data, size_t size);
+// writes what is still pending and joins the thread
+void autosaver_stop(Autosaver* saver);
+
+#endif  // SAVE_H
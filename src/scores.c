@@ -0,0 +1,455 @@
+#define _GNU_SOURCE
+#include "scores.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block.h"
+
+static_assert(sizeof(ScoresHeader) == 16, "ScoresHeader changed its size");
+static_assert(sizeof(ScoreRecord) == 32, "ScoreRecord changed its size");
+
+// records read from the log at once
+#define SCORES_READ_CHUNK 256
+
+static uint32_t get_record_checksum(const ScoreRecord* record) {
+    const uint8_t* data = (const uint8_t*)record;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < offsetof(ScoreRecord, checksum); ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return (uint32_t)(hash ^ hash >> 32);
+}
+
+static void update_size(ScoreNode* nodes, uint32_t node) {
+    nodes[node].size =
+        1 + nodes[nodes[node].left].size + nodes[nodes[node].right].size;
+}
+
+static uint32_t rotate_left(ScoreNode* nodes, uint32_t root) {
+    uint32_t right = nodes[root].right;
+    nodes[root].right = nodes[right].left;
+    nodes[right].left = root;
+    update_size(nodes, root);
+    update_size(nodes, right);
+    return right;
+}
+
+static uint32_t rotate_right(ScoreNode* nodes, uint32_t root) {
+    uint32_t left = nodes[root].left;
+    nodes[root].left = nodes[left].right;
+    nodes[left].right = root;
+    update_size(nodes, root);
+    update_size(nodes, left);
+    return left;
+}
+
+static bool is_better(const ScoreNode* a, const ScoreNode* b) {
+    return a->record.score > b->record.score ||
+           (a->record.score == b->record.score && a->order < b->order);
+}
+
+static uint32_t insert_node(ScoreNode* nodes, uint32_t root, uint32_t node) {
+    if (!root) return node;
+    if (is_better(&nodes[node], &nodes[root])) {
+        nodes[root].right = insert_node(nodes, nodes[root].right, node);
+        if (nodes[nodes[root].right].priority > nodes[root].priority) {
+            return rotate_left(nodes, root);
+        }
+    } else {
+        nodes[root].left = insert_node(nodes, nodes[root].left, node);
+        if (nodes[nodes[root].left].priority > nodes[root].priority) {
+            return rotate_right(nodes, root);
+        }
+    }
+    update_size(nodes, root);
+    return root;
+}
+
+// the worst node has no worse child, its better one takes its place
+static uint32_t remove_worst(ScoreNode* nodes, uint32_t root,
+                             uint32_t* removed) {
+    if (!nodes[root].left) {
+        *removed = root;
+        return nodes[root].right;
+    }
+    nodes[root].left = remove_worst(nodes, nodes[root].left, removed);
+    nodes[root].size--;
+    return root;
+}
+
+// a new game ranks below the indexed ones with the same score
+static uint64_t get_rank(const ScoreStore* store, int32_t score) {
+    const ScoreNode* nodes = store->nodes;
+    uint64_t rank = 1;
+    for (uint32_t node = store->root; node;) {
+        if (nodes[node].record.score >= score) {
+            rank += 1 + nodes[nodes[node].right].size;
+            node = nodes[node].left;
+        } else {
+            node = nodes[node].right;
+        }
+    }
+    return rank;
+}
+
+static uint64_t index_record(ScoreStore* store, const ScoreRecord* record) {
+    uint64_t order = store->orders_n++;
+    uint64_t rank = get_rank(store, record->score);
+    uint32_t node;
+    if (store->nodes_n < store->capacity) {
+        node = ++store->nodes_n;
+    } else if (rank > store->capacity) {
+        return 0;
+    } else {
+        store->root = remove_worst(store->nodes, store->root, &node);
+    }
+    store->nodes[node] = (ScoreNode){
+        .record = *record,
+        .order = order,
+        .priority = (uint32_t)rng_next(&store->rng),
+        .size = 1,
+    };
+    store->root = insert_node(store->nodes, store->root, node);
+    return rank;
+}
+
+// best first, skipping the first *skip
+static void collect_best(const ScoreNode* nodes, uint32_t root,
+                         uint64_t* skip, ScoreRecord* out, uint32_t* n,
+                         uint32_t k) {
+    if (!root || *n >= k) return;
+    uint32_t right_size = nodes[nodes[root].right].size;
+    if (*skip >= right_size) {
+        *skip -= right_size;
+    } else {
+        collect_best(nodes, nodes[root].right, skip, out, n, k);
+    }
+    if (*n >= k) return;
+    if (*skip > 0) {
+        --*skip;
+    } else {
+        out[(*n)++] = nodes[root].record;
+    }
+    collect_best(nodes, nodes[root].left, skip, out, n, k);
+}
+
+static void publish_top(ScoreStore* store) {
+    uint64_t seq = atomic_load_explicit(&store->top_seq, memory_order_relaxed);
+    atomic_store_explicit(&store->top_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    uint32_t n = 0;
+    uint64_t skip = 0;
+    collect_best(store->nodes, store->root, &skip, store->top, &n,
+                 SCORES_TOP_MAX);
+    atomic_store_explicit(&store->top_n, n, memory_order_relaxed);
+    atomic_store_explicit(&store->top_seq, seq + 2, memory_order_release);
+}
+
+static bool write_header(FILE* file) {
+    ScoresHeader header = {
+        .version = SCORES_VERSION,
+        .shape_set_hash = get_shape_set_hash(),
+    };
+    memcpy(header.magic, SCORES_MAGIC, sizeof(header.magic));
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+// indexes the intact records and cuts the log after them
+static bool load_log(ScoreStore* store) {
+    FILE* file = store->file;
+    ScoresHeader header;
+    size_t header_size = fread(&header, 1, sizeof(header), file);
+    if (header_size < sizeof(header)) {
+        // new, or torn while it was being created
+        store->truncated_bytes = header_size;
+        rewind(file);
+        return write_header(file) && fflush(file) == 0 &&
+               truncate_file(file, sizeof(header)) && sync_file(file);
+    }
+    if (memcmp(header.magic, SCORES_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SCORES_VERSION ||
+        header.shape_set_hash != get_shape_set_hash()) {
+        return false;
+    }
+
+    ScoreRecord records[SCORES_READ_CHUNK];
+    bool intact = true;
+    while (intact) {
+        size_t n = fread(records, sizeof(*records), SCORES_READ_CHUNK, file);
+        for (size_t i = 0; i < n && intact; ++i) {
+            intact = records[i].checksum == get_record_checksum(&records[i]);
+            if (intact) {
+                index_record(store, &records[i]);
+                store->records_n++;
+            }
+        }
+        if (n < SCORES_READ_CHUNK) break;
+    }
+
+    uint64_t size = sizeof(header) + store->records_n * sizeof(ScoreRecord);
+    if (fseek(file, 0, SEEK_END) != 0) return false;
+    long file_size = ftell(file);
+    if (file_size < 0) return false;
+    if ((uint64_t)file_size > size) {
+        store->truncated_bytes = file_size - size;
+        if (!truncate_file(file, size) || !sync_file(file)) return false;
+    }
+    return fseek(file, (long)size, SEEK_SET) == 0;
+}
+
+static FILE* open_log(const char* path) {
+    FILE* file = fopen(path, "r+b");
+    if (!file && errno == ENOENT) file = fopen(path, "w+b");
+    if (file) setvbuf(file, NULL, _IOFBF, SCORES_WRITE_BUFFER);
+    return file;
+}
+
+bool scores_open(ScoreStore* store, const char* path, uint32_t capacity) {
+    assert(capacity > 0);
+    *store = (ScoreStore){.capacity = capacity};
+    if (strlen(path) >= sizeof(store->path)) return false;
+    strcpy(store->path, path);
+    store->rng = make_rng((uint64_t)(uintptr_t)store ^ 0x5c0e5);
+    store->nodes = calloc((size_t)capacity + 1, sizeof(*store->nodes));
+    if (!store->nodes) return false;
+    store->file = open_log(path);
+    if (!store->file || !load_log(store)) {
+        if (store->file) fclose(store->file);
+        free(store->nodes);
+        return false;
+    }
+    pthread_mutex_init(&store->mutex, NULL);
+    publish_top(store);
+    atomic_store(&store->entries_n, store->nodes_n);
+    return true;
+}
+
+void scores_close(ScoreStore* store) {
+    if (store->file) {
+        fflush(store->file);
+        sync_file(store->file);
+        fclose(store->file);
+    }
+    free(store->nodes);
+    pthread_mutex_destroy(&store->mutex);
+}
+
+uint64_t scores_add(ScoreStore* store, int32_t score, uint64_t seed,
+                    uint64_t replay_offset, int64_t timestamp) {
+    ScoreRecord record = {
+        .seed = seed,
+        .replay_offset = replay_offset,
+        .timestamp = timestamp,
+        .score = score,
+    };
+    record.checksum = get_record_checksum(&record);
+
+    pthread_mutex_lock(&store->mutex);
+    if (!store->file || fwrite(&record, sizeof(record), 1, store->file) != 1) {
+        store->write_failed = true;
+    }
+    store->records_n++;
+    uint64_t rank = index_record(store, &record);
+    if (rank > 0 && rank <= SCORES_TOP_MAX) publish_top(store);
+    atomic_store_explicit(&store->entries_n, store->nodes_n,
+                          memory_order_relaxed);
+    pthread_mutex_unlock(&store->mutex);
+    return rank;
+}
+
+bool scores_flush(ScoreStore* store) {
+    // only the copy out of the stdio buffer holds up the writers
+    pthread_mutex_lock(&store->mutex);
+    bool ok = store->file && fflush(store->file) == 0 && !store->write_failed;
+    FILE* file = store->file;
+    pthread_mutex_unlock(&store->mutex);
+    return ok && sync_file(file);
+}
+
+uint64_t scores_rank(ScoreStore* store, int32_t score) {
+    pthread_mutex_lock(&store->mutex);
+    uint64_t rank = get_rank(store, score);
+    pthread_mutex_unlock(&store->mutex);
+    return rank;
+}
+
+uint32_t scores_get_page(ScoreStore* store, uint64_t rank, ScoreRecord* out,
+                         uint32_t k) {
+    assert(rank > 0);
+    uint32_t n = 0;
+    uint64_t skip = rank - 1;
+    pthread_mutex_lock(&store->mutex);
+    collect_best(store->nodes, store->root, &skip, out, &n, k);
+    pthread_mutex_unlock(&store->mutex);
+    return n;
+}
+
+bool scores_should_compact(ScoreStore* store) {
+    pthread_mutex_lock(&store->mutex);
+    bool should = !store->compacting &&
+                  store->records_n >
+                      (uint64_t)SCORES_COMPACT_RATIO * store->nodes_n;
+    pthread_mutex_unlock(&store->mutex);
+    return should;
+}
+
+static int compare_order(const void* a, const void* b) {
+    uint64_t order_a = ((const ScoreNode*)a)->order;
+    uint64_t order_b = ((const ScoreNode*)b)->order;
+    return (order_a > order_b) - (order_a < order_b);
+}
+
+// appends the records of the log from the given one on
+static bool copy_log_tail(FILE* from, uint64_t first, uint64_t records_n,
+                          FILE* to) {
+    long offset = (long)(sizeof(ScoresHeader) + first * sizeof(ScoreRecord));
+    if (fseek(from, offset, SEEK_SET) != 0) return false;
+    ScoreRecord records[SCORES_READ_CHUNK];
+    while (records_n > 0) {
+        size_t n = records_n < SCORES_READ_CHUNK ? records_n
+                                                 : SCORES_READ_CHUNK;
+        if (fread(records, sizeof(*records), n, from) != n ||
+            fwrite(records, sizeof(*records), n, to) != n) {
+            return false;
+        }
+        records_n -= n;
+    }
+    return true;
+}
+
+bool scores_compact(ScoreStore* store) {
+    char temp_path[sizeof(store->path) + 8];
+    get_temp_path(store->path, temp_path, sizeof(temp_path));
+
+    pthread_mutex_lock(&store->mutex);
+    if (store->compacting || !store->file || fflush(store->file) != 0) {
+        pthread_mutex_unlock(&store->mutex);
+        return false;
+    }
+    store->compacting = true;
+    // every node in use is in the tree
+    uint32_t kept_n = store->nodes_n;
+    uint64_t snapshot_records_n = store->records_n;
+    ScoreNode* kept = malloc(sizeof(*kept) * (kept_n + 1));
+    if (kept) memcpy(kept, store->nodes + 1, sizeof(*kept) * kept_n);
+    pthread_mutex_unlock(&store->mutex);
+
+    // in log order, so ties come out the same when it's loaded again
+    FILE* temp = kept ? fopen(temp_path, "wb") : NULL;
+    bool ok = temp != NULL;
+    if (ok) {
+        qsort(kept, kept_n, sizeof(*kept), compare_order);
+        ok = write_header(temp);
+        for (uint32_t i = 0; i < kept_n && ok; ++i) {
+            ok = fwrite(&kept[i].record, sizeof(ScoreRecord), 1, temp) == 1;
+        }
+        ok = ok && fflush(temp) == 0 && sync_file(temp);
+    }
+    free(kept);
+
+    // the games added meanwhile follow the snapshot in the old log. they're
+    // only as durable as any other unflushed game
+    pthread_mutex_lock(&store->mutex);
+    uint64_t added_n = store->records_n - snapshot_records_n;
+    ok = ok && fflush(store->file) == 0 &&
+         copy_log_tail(store->file, snapshot_records_n, added_n, temp) &&
+         fflush(temp) == 0;
+    if (temp) ok &= fclose(temp) == 0;
+    if (ok) {
+        // windows can't replace a file that's open
+        fclose(store->file);
+        ok = replace_file(temp_path, store->path);
+        if (!ok) remove(temp_path);
+        store->file = open_log(store->path);
+        if (store->file) {
+            fseek(store->file, 0, SEEK_END);
+        } else {
+            store->write_failed = true;
+        }
+        if (ok) store->records_n = kept_n + added_n;
+    } else {
+        remove(temp_path);
+        fseek(store->file, 0, SEEK_END);
+    }
+    ok &= store->file != NULL;
+    store->compacting = false;
+    pthread_mutex_unlock(&store->mutex);
+    return ok;
+}
+
+uint32_t scores_read_top(const ScoreStore* store, ScoreRecord* out,
+                         uint32_t k) {
+    if (k > SCORES_TOP_MAX) k = SCORES_TOP_MAX;
+    for (;;) {
+        uint64_t seq =
+            atomic_load_explicit(&store->top_seq, memory_order_acquire);
+        if (seq & 1) continue;
+        uint32_t n = atomic_load_explicit(&store->top_n, memory_order_relaxed);
+        if (n > k) n = k;
+        memcpy(out, store->top, sizeof(*out) * n);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&store->top_seq, memory_order_relaxed) ==
+            seq) {
+            return n;
+        }
+    }
+}
+
+uint32_t scores_read_entries_n(const ScoreStore* store) {
+    return atomic_load_explicit(&store->entries_n, memory_order_relaxed);
+}
+
+static void* scores_flusher_main(void* arg) {
+    ScoresFlusher* flusher = arg;
+    pthread_mutex_lock(&flusher->mutex);
+    for (;;) {
+        while (!flusher->requested && !flusher->stopping) {
+            pthread_cond_wait(&flusher->changed, &flusher->mutex);
+        }
+        if (!flusher->requested) break;
+        flusher->requested = false;
+
+        pthread_mutex_unlock(&flusher->mutex);
+        bool ok = scores_flush(flusher->store);
+        pthread_mutex_lock(&flusher->mutex);
+        flusher->flushes_n += ok;
+        flusher->failures_n += !ok;
+    }
+    pthread_mutex_unlock(&flusher->mutex);
+    return NULL;
+}
+
+bool scores_flusher_start(ScoresFlusher* flusher, ScoreStore* store) {
+    *flusher = (ScoresFlusher){.store = store};
+    pthread_mutex_init(&flusher->mutex, NULL);
+    pthread_cond_init(&flusher->changed, NULL);
+    if (pthread_create(&flusher->thread, NULL, scores_flusher_main,
+                       flusher) != 0) {
+        pthread_mutex_destroy(&flusher->mutex);
+        pthread_cond_destroy(&flusher->changed);
+        return false;
+    }
+    return true;
+}
+
+void scores_flusher_request(ScoresFlusher* flusher) {
+    pthread_mutex_lock(&flusher->mutex);
+    flusher->requested = true;
+    pthread_cond_signal(&flusher->changed);
+    pthread_mutex_unlock(&flusher->mutex);
+}
+
+void scores_flusher_stop(ScoresFlusher* flusher) {
+    pthread_mutex_lock(&flusher->mutex);
+    flusher->stopping = true;
+    pthread_cond_signal(&flusher->changed);
+    pthread_mutex_unlock(&flusher->mutex);
+    pthread_join(flusher->thread, NULL);
+    pthread_mutex_destroy(&flusher->mutex);
+    pthread_cond_destroy(&flusher->changed);
+}
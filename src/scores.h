@@ -0,0 +1,142 @@
+#if !defined(SCORES_H)
+#define SCORES_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fileio.h"
+#include "rng.h"
+
+// a leaderboard kept as an append-only log of finished games (native byte
+// order):
+//   ScoresHeader
+//   ScoreRecord, one per game, in the order they were added
+//
+// every record carries its own checksum. opening the log replays it into
+// the index and cuts off whatever follows the first record that's torn or
+// damaged, which is all a crash can leave behind. records are written
+// through the stdio buffer, scores_flush puts them on disk. a log only
+// opens under the shape set it was started with, so init_block_masks has
+// to run first.
+//
+// the index is a treap ordered by score, with subtree sizes for ranks. it
+// keeps the best capacity games, a game below all of them when it's full
+// is logged but not indexed. once the log holds more than twice what the
+// index does, compaction rewrites it with just the indexed games.
+//
+// adding takes a lock that only writers share. the best SCORES_TOP_MAX
+// games are also published under a sequence counter, so leaderboard reads
+// never wait for a writer and never hold one up.
+
+#define SCORES_MAGIC "RMHS"
+#define SCORES_VERSION 2
+#define SCORES_TOP_MAX 100
+// the log is compacted once it holds this many times the indexed games
+#define SCORES_COMPACT_RATIO 2
+#define SCORES_WRITE_BUFFER (64 * 1024)
+// replay_offset of a game without a replay
+#define SCORES_NO_REPLAY UINT64_MAX
+
+typedef struct ScoresHeader {
+    char magic[4];
+    uint32_t version;
+    // get_shape_set_hash, games of another shape set don't rank together
+    uint64_t shape_set_hash;
+} ScoresHeader;
+
+typedef struct ScoreRecord {
+    uint64_t seed;
+    uint64_t replay_offset;  // of the game in its replay archive
+    int64_t timestamp;       // unix seconds
+    int32_t score;
+    uint32_t checksum;  // of the fields above
+} ScoreRecord;
+
+typedef struct ScoreNode {
+    ScoreRecord record;
+    uint64_t order;  // position in the log, earlier games win ties
+    uint32_t priority;
+    uint32_t size;  // of the subtree
+    uint32_t left;  // worse games
+    uint32_t right;
+} ScoreNode;
+
+typedef struct ScoreStore {
+    FILE* file;
+    char path[FILEIO_PATH_MAX];
+    pthread_mutex_t mutex;  // held by writers only
+    // the index, nodes[0] is the empty tree. an evicted node is reused
+    // right away, so nodes_n only grows up to the capacity
+    ScoreNode* nodes;
+    uint32_t capacity;
+    uint32_t root;
+    uint32_t nodes_n;
+    Rng rng;
+    uint64_t records_n;  // in the log, buffered ones included
+    uint64_t orders_n;   // games ever added, compaction doesn't reset it
+    uint64_t truncated_bytes;  // cut off the log when it was opened
+    bool compacting;
+    bool write_failed;
+    // the published leaderboard, odd seq while it's being rewritten
+    _Atomic uint64_t top_seq;
+    _Atomic uint32_t top_n;
+    _Atomic uint32_t entries_n;
+    ScoreRecord top[SCORES_TOP_MAX];
+} ScoreStore;
+
+// opens or creates the log and loads it into an index of the best capacity
+// games. false if the file can't be used
+bool scores_open(ScoreStore* store, const char* path, uint32_t capacity);
+// flushes and closes
+void scores_close(ScoreStore* store);
+// logs and indexes a finished game and returns its rank, 1 for the best,
+// or 0 if it didn't make the index
+uint64_t scores_add(ScoreStore* store, int32_t score, uint64_t seed,
+                    uint64_t replay_offset, int64_t timestamp);
+// puts the records added so far on disk, false if writing any failed.
+// flushing and compacting are meant for one maintenance thread, they
+// mustn't run at the same time
+bool scores_flush(ScoreStore* store);
+// the rank a game with this score would get
+uint64_t scores_rank(ScoreStore* store, int32_t score);
+// copies up to k indexed games from the given rank down and returns how
+// many. holds up writers for as long as it takes, readers of the top
+// should use scores_read_top
+uint32_t scores_get_page(ScoreStore* store, uint64_t rank, ScoreRecord* out,
+                         uint32_t k);
+// true once the log is worth compacting
+bool scores_should_compact(ScoreStore* store);
+// rewrites the log with the indexed games. the games are copied out under
+// the lock and written without it, so adding carries on meanwhile
+bool scores_compact(ScoreStore* store);
+
+// copies the best k games, at most SCORES_TOP_MAX, and returns how many
+// there were. never blocks
+uint32_t scores_read_top(const ScoreStore* store, ScoreRecord* out,
+                         uint32_t k);
+uint32_t scores_read_entries_n(const ScoreStore* store);
+
+// flushes a store on a thread of its own whenever asked, for a thread that
+// adds games but mustn't wait on the disk. requests made while a flush is
+// running are served by one more flush
+typedef struct ScoresFlusher {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    ScoreStore* store;
+    bool requested;
+    bool stopping;
+    uint64_t flushes_n;
+    uint64_t failures_n;
+} ScoresFlusher;
+
+bool scores_flusher_start(ScoresFlusher* flusher, ScoreStore* store);
+// never waits for the disk
+void scores_flusher_request(ScoresFlusher* flusher);
+// serves a request still pending and joins the thread
+void scores_flusher_stop(ScoresFlusher* flusher);
+
+#endif  // SCORES_H
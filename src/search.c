@@ -0,0 +1,88 @@
+#include "search.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "board_features.h"
+
+// a line of play that ends the game is worse than any that doesn't
+#define SEARCH_DEAD_PENALTY 1e6f
+// leaf weights next to points and empty cells, tuned on simulated games
+#define SEARCH_HOLE_WEIGHT 3.0f
+#define SEARCH_FITTING_WEIGHT 1.0f
+#define SEARCH_RECT_WEIGHT 0.5f
+
+typedef struct SearchCtx {
+    // best line found from each depth
+    Move pv[HELD_BLOCKS_N + 1][HELD_BLOCKS_N];
+    int pv_n[HELD_BLOCKS_N + 1];
+    uint64_t nodes_n;
+} SearchCtx;
+
+float evaluate_state(const GameState* state) {
+    BoardFeatures features;
+    extract_features(get_occupied_cells(state), &features);
+    return state->points + features.empty_n -
+           SEARCH_HOLE_WEIGHT * features.holes_n +
+           SEARCH_FITTING_WEIGHT * features.fitting_n +
+           SEARCH_RECT_WEIGHT * features.largest_rect;
+}
+
+static bool same_block(const Block* a, const Block* b) {
+    return a->shape == b->shape && (a->rotation & 3) == (b->rotation & 3);
+}
+
+static float search_node(SearchCtx* ctx, GameState* state, int depth) {
+    ctx->nodes_n++;
+    ctx->pv_n[depth] = 0;
+    if (turn_finished(state)) return evaluate_state(state);
+
+    Board occupied = get_occupied_cells(state);
+    float best = -INFINITY;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        const Block* block = &state->held_blocks[slot];
+        if (block->item == CELL_ITEM_EMPTY) continue;
+        // a block identical to an earlier slot leads to the same positions
+        bool duplicate = false;
+        for (int i = 0; i < slot; ++i) {
+            const Block* other = &state->held_blocks[i];
+            duplicate |= other->item != CELL_ITEM_EMPTY &&
+                         same_block(block, other);
+        }
+        if (duplicate) continue;
+
+        Board legal = get_legal_origins(occupied, get_block_mask(block));
+        for (; legal; legal &= legal - 1) {
+            Move move = {.slot = slot, .cell = __builtin_ctzll(legal)};
+            PlacementUndo undo;
+            make_move(state, move, &undo);
+            float value = search_node(ctx, state, depth + 1);
+            unmake_move(state, &undo);
+
+            if (value > best) {
+                best = value;
+                int child_n = ctx->pv_n[depth + 1];
+                ctx->pv[depth][0] = move;
+                memcpy(&ctx->pv[depth][1], ctx->pv[depth + 1],
+                       sizeof(Move) * child_n);
+                ctx->pv_n[depth] = child_n + 1;
+            }
+        }
+    }
+    // no block fits, the game ends here
+    if (ctx->pv_n[depth] == 0) {
+        return evaluate_state(state) - SEARCH_DEAD_PENALTY;
+    }
+    return best;
+}
+
+void search_turn(GameState* state, SearchResult* result_out) {
+    SearchCtx ctx = {0};
+    float value = search_node(&ctx, state, 0);
+    *result_out = (SearchResult){
+        .moves_n = ctx.pv_n[0],
+        .value = value,
+        .nodes_n = ctx.nodes_n,
+    };
+    memcpy(result_out->moves, ctx.pv[0], sizeof(Move) * ctx.pv_n[0]);
+}
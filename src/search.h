@@ -0,0 +1,22 @@
+#if !defined(SEARCH_H)
+#define SEARCH_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+typedef struct SearchResult {
+    Move moves[HELD_BLOCKS_N];  // in the order they should be made
+    int moves_n;  // less than the blocks left if the turn can't be finished
+    float value;
+    uint64_t nodes_n;
+} SearchResult;
+
+// points plus board shape features, higher is better
+float evaluate_state(const GameState* state);
+
+// finds the best order and placement of the blocks left in the turn. the
+// search makes and unmakes moves on state itself and leaves it as it was
+void search_turn(GameState* state, SearchResult* result_out);
+
+#endif  // SEARCH_H
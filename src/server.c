@@ -0,0 +1,551 @@
+#define _GNU_SOURCE
+#include "server.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "metrics.h"
+#include "timing.h"
+
+static_assert(sizeof(ServerRequest) == 16, "ServerRequest changed its size");
+static_assert(sizeof(ServerReply) == 48, "ServerReply changed its size");
+static_assert(SERVER_SESSIONS_MAX <= 1 << 16,
+              "session indices must fit into the low half of an id");
+
+#define SERVER_EVENTS_N 256
+// epoll data of the listening socket, connections use their index
+#define LISTEN_TOKEN UINT64_MAX
+#define NO_OWNER UINT16_MAX
+#define NO_SESSION UINT32_MAX
+
+typedef struct Connection {
+    int fd;  // -1 while free
+    bool writing;  // replies are stuck until the socket drains
+    uint32_t in_n;      // bytes of requests read
+    uint32_t out_n;     // replies written
+    uint32_t out_sent;  // bytes of them sent
+    uint64_t read_time;  // nanoseconds, when the last requests came in
+    uint32_t first_session;  // of its sessions, or NO_SESSION
+    // replies are built right in the buffer that's sent
+    uint8_t* in;
+    ServerReply* out;
+} Connection;
+
+typedef struct FinishedGame {
+    uint64_t seed;
+    int64_t timestamp;
+    int32_t score;
+} FinishedGame;
+
+struct ServerLoop {
+    Server* server;
+    int epoll_fd;
+    Connection* connections;
+    uint32_t* free_connections;
+    uint32_t free_connections_n;
+    // the buffers of all connections in two allocations
+    uint8_t* in_buffers;
+    ServerReply* out_buffers;
+    GameState* sessions;
+    uint64_t* seeds;  // of every session, for the leaderboard
+    // the id of a session is its generation above its index, so the id of
+    // an ended session doesn't reach the one that reuses its slot
+    uint16_t* generations;
+    uint16_t* owners;  // connection index of every session, or NO_OWNER
+    // the sessions of a connection are linked through these, so closing it
+    // ends its own and doesn't look at anyone else's
+    uint32_t* next_sessions;
+    uint32_t* previous_sessions;
+    uint32_t* free_sessions;
+    uint32_t free_sessions_n;
+    // ended games on their way to the scores, a ring the loop adds to and
+    // server_drain_scores takes from. only allocated with the scores
+    FinishedGame* finished;
+    _Atomic uint64_t finished_head;  // advanced by the drain
+    _Atomic uint64_t finished_tail;  // advanced by the loop
+    _Atomic uint64_t games_dropped_n;
+    _Atomic uint64_t requests_n;
+    _Atomic uint32_t connections_n;
+    _Atomic uint32_t sessions_n;
+};
+
+static GameState* new_session(ServerLoop* loop, uint32_t connection,
+                              uint64_t seed, uint32_t* id_out) {
+    if (loop->free_sessions_n == 0) return NULL;
+    uint32_t index = loop->free_sessions[--loop->free_sessions_n];
+    loop->owners[index] = connection;
+    Connection* conn = &loop->connections[connection];
+    loop->next_sessions[index] = conn->first_session;
+    loop->previous_sessions[index] = NO_SESSION;
+    if (conn->first_session != NO_SESSION) {
+        loop->previous_sessions[conn->first_session] = index;
+    }
+    conn->first_session = index;
+    loop->sessions[index] = make_gamestate(seed);
+    loop->seeds[index] = seed;
+    *id_out = (uint32_t)loop->generations[index] << 16 | index;
+    atomic_fetch_add_explicit(&loop->sessions_n, 1, memory_order_relaxed);
+    return &loop->sessions[index];
+}
+
+static GameState* find_session(ServerLoop* loop, uint32_t connection,
+                               uint32_t id) {
+    uint32_t index = id & 0xffff;
+    if (index >= SERVER_SESSIONS_MAX || loop->owners[index] != connection ||
+        loop->generations[index] != id >> 16) {
+        return NULL;
+    }
+    return &loop->sessions[index];
+}
+
+// queues the game for the scores, it's dropped if the queue is full
+static void finish_game(ServerLoop* loop, uint32_t index) {
+    uint64_t tail =
+        atomic_load_explicit(&loop->finished_tail, memory_order_relaxed);
+    uint64_t head =
+        atomic_load_explicit(&loop->finished_head, memory_order_acquire);
+    if (tail - head == SERVER_FINISHED_MAX) {
+        atomic_fetch_add_explicit(&loop->games_dropped_n, 1,
+                                  memory_order_relaxed);
+        return;
+    }
+    loop->finished[tail & (SERVER_FINISHED_MAX - 1)] = (FinishedGame){
+        .seed = loop->seeds[index],
+        .timestamp = (int64_t)time(NULL),
+        .score = loop->sessions[index].points,
+    };
+    atomic_store_explicit(&loop->finished_tail, tail + 1,
+                          memory_order_release);
+}
+
+static void end_session(ServerLoop* loop, uint32_t index) {
+    if (loop->finished) finish_game(loop, index);
+    uint32_t next = loop->next_sessions[index];
+    uint32_t previous = loop->previous_sessions[index];
+    if (next != NO_SESSION) loop->previous_sessions[next] = previous;
+    if (previous != NO_SESSION) {
+        loop->next_sessions[previous] = next;
+    } else {
+        loop->connections[loop->owners[index]].first_session = next;
+    }
+    loop->owners[index] = NO_OWNER;
+    loop->generations[index]++;
+    loop->free_sessions[loop->free_sessions_n++] = index;
+    atomic_fetch_sub_explicit(&loop->sessions_n, 1, memory_order_relaxed);
+}
+
+static void fill_reply_state(const GameState* state, ServerReply* reply) {
+    reply->game_over = is_game_over(state);
+    reply->points = state->points;
+    reply->combo = state->combo;
+    reply->blocks_placed = state->blocks_placed;
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        reply->held_blocks[i] = pack_block(&state->held_blocks[i]);
+    }
+    for (int i = 0; i < CELL_COLORS_N; ++i) reply->field[i] = state->field[i];
+}
+
+static void handle_request(ServerLoop* loop, uint32_t connection,
+                           const ServerRequest* request, ServerReply* reply) {
+    *reply = (ServerReply){.kind = request->kind, .session = request->session};
+    GameState* state;
+    switch (request->kind) {
+    case SERVER_REQUEST_NEW_GAME:
+        state = new_session(loop, connection, request->seed, &reply->session);
+        if (!state) {
+            reply->status = SERVER_STATUS_FULL;
+            return;
+        }
+        metrics_count(METRIC_GAMES_STARTED, 1);
+        break;
+    case SERVER_REQUEST_PLACE:
+    case SERVER_REQUEST_GET_STATE:
+    case SERVER_REQUEST_END_GAME:
+        state = find_session(loop, connection, request->session);
+        if (!state) {
+            reply->status = SERVER_STATUS_NO_SESSION;
+            return;
+        }
+        if (request->kind == SERVER_REQUEST_END_GAME) {
+            end_session(loop, request->session & 0xffff);
+            return;
+        }
+        if (request->kind == SERVER_REQUEST_PLACE) {
+            Move move = {.slot = request->slot, .cell = request->cell};
+            int combo = state->combo;
+            int lines_cleared = apply_move(state, move, NULL);
+            if (lines_cleared < 0) {
+                reply->status = SERVER_STATUS_ILLEGAL_MOVE;
+            } else {
+                reply->lines_cleared = lines_cleared;
+                metrics_count(METRIC_PLACEMENTS, 1);
+                metrics_count(METRIC_LINES_CLEARED, lines_cleared);
+                if (combo > 1 && state->combo == 1) {
+                    metrics_observe(METRIC_COMBO_LENGTH, combo);
+                }
+            }
+        }
+        break;
+    default:
+        reply->status = SERVER_STATUS_BAD_REQUEST;
+        return;
+    }
+    fill_reply_state(state, reply);
+    if (request->kind == SERVER_REQUEST_PLACE &&
+        reply->status == SERVER_STATUS_OK && reply->game_over) {
+        metrics_count(METRIC_GAMES_FINISHED, 1);
+    }
+}
+
+// answers every whole request read so far, the out buffer must be empty
+static void handle_requests(ServerLoop* loop, uint32_t index) {
+    Connection* conn = &loop->connections[index];
+    assert(conn->out_n == 0);
+    uint32_t requests_n = conn->in_n / sizeof(ServerRequest);
+    for (uint32_t i = 0; i < requests_n; ++i) {
+        ServerRequest request;
+        memcpy(&request, conn->in + i * sizeof(request), sizeof(request));
+        handle_request(loop, index, &request, &conn->out[conn->out_n++]);
+    }
+    uint32_t used = requests_n * sizeof(ServerRequest);
+    memmove(conn->in, conn->in + used, conn->in_n - used);
+    conn->in_n -= used;
+    atomic_fetch_add_explicit(&loop->requests_n, requests_n,
+                              memory_order_relaxed);
+    metrics_count(METRIC_REQUESTS, requests_n);
+}
+
+static bool watch_connection(ServerLoop* loop, uint32_t index, int op,
+                             uint32_t events) {
+    struct epoll_event event = {.events = events, .data.u64 = index};
+    return epoll_ctl(loop->epoll_fd, op, loop->connections[index].fd,
+                     &event) == 0;
+}
+
+// sends what's left of the replies. false if the connection broke
+static bool flush_replies(ServerLoop* loop, uint32_t index) {
+    Connection* conn = &loop->connections[index];
+    size_t size = conn->out_n * sizeof(ServerReply);
+    while (conn->out_sent < size) {
+        ssize_t n = send(conn->fd, (uint8_t*)conn->out + conn->out_sent,
+                         size - conn->out_sent, MSG_NOSIGNAL);
+        if (n >= 0) {
+            conn->out_sent += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // no more requests are read until the client reads its replies
+            if (!conn->writing &&
+                !watch_connection(loop, index, EPOLL_CTL_MOD, EPOLLOUT)) {
+                return false;
+            }
+            conn->writing = true;
+            return true;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+    if (conn->out_n > 0) {
+        metrics_observe_n(METRIC_REQUEST_LATENCY,
+                          get_time_nanoseconds() - conn->read_time,
+                          conn->out_n);
+    }
+    conn->out_n = 0;
+    conn->out_sent = 0;
+    if (conn->writing) {
+        conn->writing = false;
+        return watch_connection(loop, index, EPOLL_CTL_MOD, EPOLLIN);
+    }
+    return true;
+}
+
+static void close_connection(ServerLoop* loop, uint32_t index) {
+    Connection* conn = &loop->connections[index];
+    close(conn->fd);  // also takes it out of the epoll set
+    conn->fd = -1;
+    while (conn->first_session != NO_SESSION) {
+        end_session(loop, conn->first_session);
+    }
+    loop->free_connections[loop->free_connections_n++] = index;
+    atomic_fetch_sub_explicit(&loop->connections_n, 1, memory_order_relaxed);
+}
+
+// reads, answers and sends until the socket runs dry or blocks. false if
+// the connection has to be closed
+static bool serve_connection(ServerLoop* loop, uint32_t index) {
+    Connection* conn = &loop->connections[index];
+    for (;;) {
+        if (!flush_replies(loop, index)) return false;
+        if (conn->writing) return true;
+        if (conn->in_n >= sizeof(ServerRequest)) {
+            handle_requests(loop, index);
+            continue;
+        }
+        uint32_t in_cap = SERVER_PIPELINE_MAX * sizeof(ServerRequest);
+        ssize_t n = read(conn->fd, conn->in + conn->in_n, in_cap - conn->in_n);
+        if (n > 0) {
+            conn->in_n += n;
+            conn->read_time = get_time_nanoseconds();
+        } else if (n == 0) {
+            return false;
+        } else if (errno != EINTR) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+static void accept_connections(ServerLoop* loop) {
+    for (;;) {
+        int fd = accept4(loop->server->listen_fd, NULL, NULL,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;  // EAGAIN once another loop got the rest
+        if (loop->free_connections_n == 0) {
+            close(fd);
+            continue;
+        }
+        uint32_t index = loop->free_connections[--loop->free_connections_n];
+        Connection* conn = &loop->connections[index];
+        conn->fd = fd;
+        conn->writing = false;
+        conn->in_n = 0;
+        conn->out_n = 0;
+        conn->out_sent = 0;
+        conn->first_session = NO_SESSION;
+        atomic_fetch_add_explicit(&loop->connections_n, 1,
+                                  memory_order_relaxed);
+        if (!watch_connection(loop, index, EPOLL_CTL_ADD, EPOLLIN)) {
+            close_connection(loop, index);
+        }
+    }
+}
+
+static void* server_loop_main(void* arg) {
+    ServerLoop* loop = arg;
+    struct epoll_event events[SERVER_EVENTS_N];
+    while (!atomic_load(&loop->server->stop)) {
+        int events_n = epoll_wait(loop->epoll_fd, events, SERVER_EVENTS_N, 100);
+        for (int i = 0; i < events_n; ++i) {
+            if (events[i].data.u64 == LISTEN_TOKEN) {
+                accept_connections(loop);
+                continue;
+            }
+            uint32_t index = events[i].data.u64;
+            if (loop->connections[index].fd < 0) continue;
+            if (!serve_connection(loop, index)) close_connection(loop, index);
+        }
+    }
+    return NULL;
+}
+
+static bool init_loop(Server* server, ServerLoop* loop) {
+    *loop = (ServerLoop){
+        .server = server,
+        .epoll_fd = epoll_create1(EPOLL_CLOEXEC),
+        .connections =
+            malloc(sizeof(*loop->connections) * SERVER_CONNECTIONS_MAX),
+        .free_connections =
+            malloc(sizeof(*loop->free_connections) * SERVER_CONNECTIONS_MAX),
+        .in_buffers = malloc(SERVER_CONNECTIONS_MAX * SERVER_PIPELINE_MAX *
+                             sizeof(ServerRequest)),
+        .out_buffers = malloc(SERVER_CONNECTIONS_MAX * SERVER_PIPELINE_MAX *
+                              sizeof(ServerReply)),
+        .sessions = malloc(sizeof(*loop->sessions) * SERVER_SESSIONS_MAX),
+        .seeds = malloc(sizeof(*loop->seeds) * SERVER_SESSIONS_MAX),
+        .generations =
+            calloc(SERVER_SESSIONS_MAX, sizeof(*loop->generations)),
+        .owners = malloc(sizeof(*loop->owners) * SERVER_SESSIONS_MAX),
+        .next_sessions =
+            malloc(sizeof(*loop->next_sessions) * SERVER_SESSIONS_MAX),
+        .previous_sessions =
+            malloc(sizeof(*loop->previous_sessions) * SERVER_SESSIONS_MAX),
+        .free_sessions =
+            malloc(sizeof(*loop->free_sessions) * SERVER_SESSIONS_MAX),
+    };
+    if (loop->connections) {
+        for (uint32_t i = 0; i < SERVER_CONNECTIONS_MAX; ++i) {
+            loop->connections[i] =
+                (Connection){.fd = -1, .first_session = NO_SESSION};
+        }
+    }
+    if (loop->epoll_fd < 0 || !loop->connections || !loop->free_connections ||
+        !loop->in_buffers || !loop->out_buffers || !loop->sessions ||
+        !loop->seeds || !loop->generations || !loop->owners ||
+        !loop->next_sessions || !loop->previous_sessions ||
+        !loop->free_sessions) {
+        return false;
+    }
+
+    // popped from the back, so the lowest indices go first
+    for (uint32_t i = 0; i < SERVER_CONNECTIONS_MAX; ++i) {
+        Connection* conn = &loop->connections[i];
+        conn->in = loop->in_buffers + i * SERVER_PIPELINE_MAX *
+                                          sizeof(ServerRequest);
+        conn->out = loop->out_buffers + i * SERVER_PIPELINE_MAX;
+        loop->free_connections[i] = SERVER_CONNECTIONS_MAX - 1 - i;
+    }
+    loop->free_connections_n = SERVER_CONNECTIONS_MAX;
+    for (uint32_t i = 0; i < SERVER_SESSIONS_MAX; ++i) {
+        loop->owners[i] = NO_OWNER;
+        loop->free_sessions[i] = SERVER_SESSIONS_MAX - 1 - i;
+    }
+    loop->free_sessions_n = SERVER_SESSIONS_MAX;
+
+    // every loop waits on the listening socket, exclusively so that a new
+    // connection wakes one of them rather than all
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLEXCLUSIVE,
+        .data.u64 = LISTEN_TOKEN,
+    };
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, server->listen_fd,
+                     &event) == 0;
+}
+
+static void free_loop(ServerLoop* loop) {
+    if (loop->connections) {
+        for (uint32_t i = 0; i < SERVER_CONNECTIONS_MAX; ++i) {
+            if (loop->connections[i].fd >= 0) close(loop->connections[i].fd);
+        }
+    }
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+    free(loop->connections);
+    free(loop->free_connections);
+    free(loop->in_buffers);
+    free(loop->out_buffers);
+    free(loop->sessions);
+    free(loop->seeds);
+    free(loop->generations);
+    free(loop->owners);
+    free(loop->next_sessions);
+    free(loop->previous_sessions);
+    free(loop->free_sessions);
+    free(loop->finished);
+}
+
+bool server_open(Server* server, const char* path, int loops_n) {
+    assert(loops_n > 0 && loops_n <= SERVER_LOOPS_MAX);
+    *server = (Server){.listen_fd = -1, .loops_n = loops_n};
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    strcpy(server->path, path);
+
+    server->listen_fd =
+        socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) return false;
+    unlink(path);
+    if (bind(server->listen_fd, (struct sockaddr*)&address,
+             sizeof(address)) != 0 ||
+        listen(server->listen_fd, SOMAXCONN) != 0) {
+        server_close(server);
+        return false;
+    }
+
+    server->loops = calloc(loops_n, sizeof(*server->loops));
+    if (!server->loops) {
+        server_close(server);
+        return false;
+    }
+    for (int i = 0; i < loops_n; ++i) {
+        server->loops[i].epoll_fd = -1;
+    }
+    for (int i = 0; i < loops_n; ++i) {
+        if (!init_loop(server, &server->loops[i])) {
+            server_close(server);
+            errno = ENOMEM;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool server_start(Server* server) {
+    atomic_store(&server->stop, false);
+    for (int i = 0; i < server->loops_n && server->scores; ++i) {
+        ServerLoop* loop = &server->loops[i];
+        if (!loop->finished) {
+            loop->finished =
+                malloc(sizeof(*loop->finished) * SERVER_FINISHED_MAX);
+        }
+        if (!loop->finished) return false;
+    }
+    for (int i = 0; i < server->loops_n; ++i) {
+        if (pthread_create(&server->threads[i], NULL, server_loop_main,
+                           &server->loops[i]) != 0) {
+            // the loops already running have to be joined
+            server_stop(server);
+            for (int j = 0; j < i; ++j) pthread_join(server->threads[j], NULL);
+            return false;
+        }
+    }
+    return true;
+}
+
+void server_stop(Server* server) { atomic_store(&server->stop, true); }
+
+void server_join(Server* server) {
+    for (int i = 0; i < server->loops_n; ++i) {
+        pthread_join(server->threads[i], NULL);
+    }
+}
+
+void server_close(Server* server) {
+    if (server->loops) {
+        for (int i = 0; i < server->loops_n; ++i) free_loop(&server->loops[i]);
+        free(server->loops);
+        server->loops = NULL;
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        unlink(server->path);
+        server->listen_fd = -1;
+    }
+}
+
+ServerStats get_server_stats(const Server* server) {
+    ServerStats stats = {0};
+    for (int i = 0; i < server->loops_n; ++i) {
+        ServerLoop* loop = &server->loops[i];
+        stats.requests_n +=
+            atomic_load_explicit(&loop->requests_n, memory_order_relaxed);
+        stats.connections_n +=
+            atomic_load_explicit(&loop->connections_n, memory_order_relaxed);
+        stats.sessions_n +=
+            atomic_load_explicit(&loop->sessions_n, memory_order_relaxed);
+        stats.games_dropped_n += atomic_load_explicit(&loop->games_dropped_n,
+                                                      memory_order_relaxed);
+    }
+    return stats;
+}
+
+uint32_t server_drain_scores(Server* server) {
+    if (!server->scores) return 0;
+    uint32_t added_n = 0;
+    for (int i = 0; i < server->loops_n; ++i) {
+        ServerLoop* loop = &server->loops[i];
+        if (!loop->finished) continue;
+        uint64_t head =
+            atomic_load_explicit(&loop->finished_head, memory_order_relaxed);
+        uint64_t tail =
+            atomic_load_explicit(&loop->finished_tail, memory_order_acquire);
+        for (; head != tail; ++head) {
+            const FinishedGame* game =
+                &loop->finished[head & (SERVER_FINISHED_MAX - 1)];
+            scores_add(server->scores, game->score, game->seed,
+                       SCORES_NO_REPLAY, game->timestamp);
+            added_n++;
+        }
+        // the loop may reuse the slots from here on
+        atomic_store_explicit(&loop->finished_head, head,
+                              memory_order_release);
+    }
+    return added_n;
+}
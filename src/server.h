@@ -0,0 +1,111 @@
+#if !defined(SERVER_H)
+#define SERVER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "block.h"
+#include "constants.h"
+#include "scores.h"
+
+// many game sessions behind a unix domain socket. every loop is one thread
+// with its own epoll set, connections and session pool, so nothing is
+// shared between them but the listening socket, which each connection is
+// accepted from by exactly one loop. a session belongs to the connection
+// that created it and ends with it.
+//
+// the protocol is fixed size binary records in host byte order, the server
+// and its clients share a machine. a client may send many requests before
+// reading any reply, the replies come back in request order.
+
+typedef enum ServerRequestKind {
+    SERVER_REQUEST_NEW_GAME = 1,  // seed, replies with the new session
+    SERVER_REQUEST_PLACE,         // session, slot and cell
+    SERVER_REQUEST_GET_STATE,     // session
+    SERVER_REQUEST_END_GAME,      // session, replies without a state
+} ServerRequestKind;
+
+typedef enum ServerStatus {
+    SERVER_STATUS_OK,
+    SERVER_STATUS_ILLEGAL_MOVE,  // the state is sent anyway, unchanged
+    SERVER_STATUS_NO_SESSION,
+    SERVER_STATUS_FULL,  // no session left in the pool
+    SERVER_STATUS_BAD_REQUEST,
+} ServerStatus;
+
+typedef struct ServerRequest {
+    uint8_t kind;
+    uint8_t slot;
+    uint8_t cell;
+    uint8_t reserved;
+    uint32_t session;
+    uint64_t seed;
+} ServerRequest;
+
+typedef struct ServerReply {
+    uint8_t kind;    // of the request
+    uint8_t status;  // ServerStatus
+    uint8_t lines_cleared;
+    uint8_t game_over;
+    PackedBlock held_blocks[HELD_BLOCKS_N];
+    uint8_t reserved;
+    uint32_t session;
+    int32_t points;
+    int32_t combo;
+    uint32_t blocks_placed;
+    uint64_t field[CELL_COLORS_N];  // cells of each color
+} ServerReply;
+
+#define SERVER_LOOPS_MAX 16
+#define SERVER_CONNECTIONS_MAX 1024  // per loop
+#define SERVER_SESSIONS_MAX 16384    // per loop
+// requests read from a connection at once, its buffers hold this many
+#define SERVER_PIPELINE_MAX 64
+// ended games a loop holds for server_drain_scores, a power of two
+#define SERVER_FINISHED_MAX 65536
+
+typedef struct ServerLoop ServerLoop;
+
+typedef struct Server {
+    char path[108];  // sun_path of the socket
+    int listen_fd;
+    int loops_n;
+    ServerLoop* loops;
+    pthread_t threads[SERVER_LOOPS_MAX];
+    _Atomic bool stop;
+    // every session that ends, by request or with its connection, goes on
+    // it if it's set. set it between server_open and server_start
+    ScoreStore* scores;
+} Server;
+
+typedef struct ServerStats {
+    uint64_t requests_n;
+    uint32_t connections_n;
+    uint32_t sessions_n;
+    // ended games that found the queue of their loop full and didn't make
+    // it to the scores
+    uint64_t games_dropped_n;
+} ServerStats;
+
+// binds the socket, replacing a stale one at the path, and allocates the
+// loops. false with errno set if that failed
+bool server_open(Server* server, const char* path, int loops_n);
+// runs every loop on its own thread
+bool server_start(Server* server);
+// makes the loops return within a tenth of a second, safe to call from a
+// signal handler
+void server_stop(Server* server);
+void server_join(Server* server);
+// closes every connection and removes the socket file
+void server_close(Server* server);
+// sums of the loops, read while they run
+ServerStats get_server_stats(const Server* server);
+// adds the games that ended since the last call to the scores, returns how
+// many. the loops only queue ended games and never wait on the store, one
+// thread has to call this often enough that no queue fills up, a loop
+// holds SERVER_FINISHED_MAX of them
+uint32_t server_drain_scores(Server* server);
+
+#endif  // SERVER_H
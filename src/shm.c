@@ -0,0 +1,47 @@
+#define _GNU_SOURCE
+#include "shm.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool map_shared(SharedBuffer* buffer, int fd, size_t size) {
+    void* data = size
+                     ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, 0)
+                     : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    *buffer = (SharedBuffer){.data = data, .size = size};
+    return true;
+}
+
+bool shared_buffer_create(SharedBuffer* buffer, const char* name,
+                          size_t size) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return false;
+    }
+    return map_shared(buffer, fd, size);
+}
+
+bool shared_buffer_open(SharedBuffer* buffer, const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    return map_shared(buffer, fd, st.st_size);
+}
+
+void shared_buffer_close(SharedBuffer* buffer) {
+    if (buffer->data) munmap(buffer->data, buffer->size);
+    *buffer = (SharedBuffer){0};
+}
+
+bool shared_buffer_unlink(const char* name) { return shm_unlink(name) == 0; }
@@ -0,0 +1,25 @@
+#if !defined(SHM_H)
+#define SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// a named posix shared memory segment mapped read/write, so another process
+// (a trainer reading observations, say) can map the same bytes by name
+
+typedef struct SharedBuffer {
+    void* data;
+    size_t size;
+} SharedBuffer;
+
+// creates the segment, or resizes it if it already exists. name starts
+// with a slash, like "/blocks_obs"
+bool shared_buffer_create(SharedBuffer* buffer, const char* name,
+                          size_t size);
+// maps an existing segment at its current size
+bool shared_buffer_open(SharedBuffer* buffer, const char* name);
+// unmaps, the segment itself lives on until shared_buffer_unlink
+void shared_buffer_close(SharedBuffer* buffer);
+bool shared_buffer_unlink(const char* name);
+
+#endif  // SHM_H
@@ -0,0 +1,426 @@
+#define _GNU_SOURCE
+#include "spectate.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the ring starts a cache line after the header
+#define SPECTATE_RING_OFFSET 64
+static_assert(sizeof(SpectateHeader) <= SPECTATE_RING_OFFSET,
+              "the header overlaps the ring");
+
+// the largest record of a stream, a keyframe of all its games
+static uint32_t get_record_max(uint32_t games_n) {
+    return 1 + 5 + games_n * SPECTATE_SNAPSHOT_MAX;
+}
+
+static uint8_t* put_varint(uint8_t* p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static uint8_t* put_board(uint8_t* p, Board board) {
+    memcpy(p, &board, sizeof(board));
+    return p + sizeof(board);
+}
+
+// the readers return NULL past the end of the record
+static const uint8_t* get_varint(const uint8_t* p, const uint8_t* end,
+                                 uint64_t* value_out) {
+    uint64_t value = 0;
+    for (int shift = 0; p && p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value_out = value;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t* get_bytes(const uint8_t* p, const uint8_t* end,
+                                void* out, size_t size) {
+    if (!p || (size_t)(end - p) < size) return NULL;
+    memcpy(out, p, size);
+    return p + size;
+}
+
+static uint8_t* put_snapshot(uint8_t* p, uint32_t game,
+                             const GameState* state) {
+    p = put_varint(p, game);
+    for (int i = 0; i < CELL_COLORS_N; ++i) p = put_board(p, state->field[i]);
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        *p++ = pack_block(&state->held_blocks[i]);
+    }
+    p = put_varint(p, state->points);
+    p = put_varint(p, state->combo);
+    return put_varint(p, state->blocks_placed);
+}
+
+static const uint8_t* get_snapshot(const uint8_t* p, const uint8_t* end,
+                                   uint32_t games_n, uint32_t* game_out,
+                                   GameState* state_out) {
+    uint64_t game = 0, points = 0, combo = 0, blocks_placed = 0;
+    p = get_varint(p, end, &game);
+    GameState state = {0};
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        p = get_bytes(p, end, &state.field[i], sizeof(Board));
+    }
+    PackedBlock packed[HELD_BLOCKS_N];
+    p = get_bytes(p, end, packed, sizeof(packed));
+    p = get_varint(p, end, &points);
+    p = get_varint(p, end, &combo);
+    p = get_varint(p, end, &blocks_placed);
+    if (!p || game >= games_n) return NULL;
+
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        state.held_blocks[i] = unpack_block(packed[i]);
+    }
+    state.points = points;
+    state.combo = combo;
+    state.blocks_placed = blocks_placed;
+    *game_out = game;
+    *state_out = state;
+    return p;
+}
+
+static void ring_write(uint8_t* ring, uint32_t capacity, uint64_t pos,
+                       const void* data, size_t size) {
+    size_t start = pos & (capacity - 1);
+    size_t first = size < capacity - start ? size : capacity - start;
+    memcpy(ring + start, data, first);
+    memcpy(ring, (const uint8_t*)data + first, size - first);
+}
+
+static void ring_read(const uint8_t* ring, uint32_t capacity, uint64_t pos,
+                      void* out, size_t size) {
+    size_t start = pos & (capacity - 1);
+    size_t first = size < capacity - start ? size : capacity - start;
+    memcpy(out, ring + start, first);
+    memcpy((uint8_t*)out + first, ring, size - first);
+}
+
+// appends the record and returns where it starts
+static uint64_t publish_record(SpectatePublisher* publisher, uint32_t size) {
+    SpectateHeader* header = publisher->header;
+    uint64_t pos = atomic_load_explicit(&header->write_pos,
+                                        memory_order_relaxed);
+    ring_write(publisher->ring, header->capacity, pos, &size, sizeof(size));
+    ring_write(publisher->ring, header->capacity, pos + sizeof(size),
+               publisher->record, size);
+    atomic_store_explicit(&header->write_pos, pos + sizeof(size) + size,
+                          memory_order_release);
+    return pos;
+}
+
+static void publish_keyframe(SpectatePublisher* publisher) {
+    uint32_t games_n = publisher->header->games_n;
+    uint8_t* p = publisher->record;
+    *p++ = SPECTATE_RECORD_KEYFRAME;
+    p = put_varint(p, games_n);
+    for (uint32_t i = 0; i < games_n; ++i) {
+        p = put_snapshot(p, i, &publisher->games[i]);
+    }
+    uint32_t size = p - publisher->record;
+    uint64_t pos = publish_record(publisher, size);
+    atomic_store_explicit(&publisher->header->keyframe_pos, pos,
+                          memory_order_release);
+    publisher->moves_since_keyframe = 0;
+    publisher->keyframes_n++;
+    publisher->keyframe_bytes += sizeof(size) + size;
+}
+
+static void maybe_publish_keyframe(SpectatePublisher* publisher) {
+    SpectateHeader* header = publisher->header;
+    uint64_t since_keyframe =
+        atomic_load_explicit(&header->write_pos, memory_order_relaxed) -
+        atomic_load_explicit(&header->keyframe_pos, memory_order_relaxed);
+    if (publisher->moves_since_keyframe >=
+            (uint64_t)publisher->keyframe_every * header->games_n ||
+        since_keyframe >= header->capacity / SPECTATE_RING_MIN_RECORDS -
+                              get_record_max(header->games_n)) {
+        publish_keyframe(publisher);
+    }
+}
+
+bool spectate_publisher_open(SpectatePublisher* publisher, const char* name,
+                             uint32_t games_n, uint32_t capacity,
+                             uint32_t keyframe_every) {
+    *publisher = (SpectatePublisher){.keyframe_every = keyframe_every};
+    if (games_n == 0 || games_n > SPECTATE_GAMES_MAX ||
+        strlen(name) >= sizeof(publisher->name)) {
+        return false;
+    }
+    // twice the least, so the bound on the bytes between keyframes stays
+    // well above one record
+    uint32_t capacity_min =
+        2 * SPECTATE_RING_MIN_RECORDS * get_record_max(games_n);
+    if (capacity < capacity_min) capacity = capacity_min;
+    uint32_t ring_capacity = 1;
+    while (ring_capacity < capacity) ring_capacity *= 2;
+
+    publisher->games = calloc(games_n, sizeof(*publisher->games));
+    publisher->record = malloc(get_record_max(games_n));
+    if (!publisher->games || !publisher->record ||
+        !shared_buffer_create(&publisher->buffer, name,
+                              SPECTATE_RING_OFFSET + ring_capacity)) {
+        free(publisher->games);
+        free(publisher->record);
+        return false;
+    }
+    strcpy(publisher->name, name);
+    publisher->header = publisher->buffer.data;
+    publisher->ring = (uint8_t*)publisher->buffer.data + SPECTATE_RING_OFFSET;
+
+    SpectateHeader* header = publisher->header;
+    memcpy(header->magic, SPECTATE_MAGIC, sizeof(header->magic));
+    header->version = SPECTATE_VERSION;
+    header->capacity = ring_capacity;
+    header->games_n = games_n;
+    atomic_store(&header->write_pos, 0);
+    // the games start out empty, so subscribers have something to start from
+    publish_keyframe(publisher);
+    return true;
+}
+
+void spectate_publisher_close(SpectatePublisher* publisher) {
+    shared_buffer_close(&publisher->buffer);
+    shared_buffer_unlink(publisher->name);
+    free(publisher->games);
+    free(publisher->record);
+    *publisher = (SpectatePublisher){0};
+}
+
+void spectate_publish_game(SpectatePublisher* publisher, uint32_t game,
+                           const GameState* state) {
+    assert(game < publisher->header->games_n);
+    publisher->games[game] = *state;
+    uint8_t* p = publisher->record;
+    *p++ = SPECTATE_RECORD_GAME;
+    p = put_snapshot(p, game, state);
+    publish_record(publisher, p - publisher->record);
+    maybe_publish_keyframe(publisher);
+}
+
+void spectate_publish_move(SpectatePublisher* publisher, uint32_t game,
+                           const GameState* state, Move move,
+                           const PlacementUndo* undo) {
+    assert(game < publisher->header->games_n);
+    publisher->games[game] = *state;
+
+    Board cleared = 0;
+    for (int i = 0; i < CELL_COLORS_N; ++i) cleared |= undo->cleared[i];
+    // a line is cleared only if all of it was, and nothing else is
+    unsigned rows = board_full_rows(cleared);
+    unsigned cols = board_full_cols(cleared);
+
+    uint8_t* p = publisher->record;
+    *p++ = SPECTATE_RECORD_MOVE | (cleared ? SPECTATE_MOVE_CLEARED : 0) |
+           (undo->turn.dealt ? SPECTATE_MOVE_DEALT : 0);
+    p = put_varint(p, game);
+    *p++ = move.slot;
+    *p++ = move.cell;
+    if (cleared) {
+        *p++ = rows;
+        *p++ = cols;
+    }
+    if (undo->turn.dealt) {
+        for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+            *p++ = pack_block(&state->held_blocks[i]);
+        }
+    }
+    p = put_varint(p, state->points - undo->turn.points);
+    p = put_varint(p, state->combo);
+    uint32_t size = p - publisher->record;
+    publish_record(publisher, size);
+
+    publisher->moves_n++;
+    publisher->move_bytes += sizeof(size) + size;
+    publisher->moves_since_keyframe++;
+    maybe_publish_keyframe(publisher);
+}
+
+bool spectate_subscriber_open(SpectateSubscriber* subscriber,
+                              const char* name) {
+    *subscriber = (SpectateSubscriber){0};
+    if (!shared_buffer_open(&subscriber->buffer, name)) return false;
+    const SpectateHeader* header = subscriber->buffer.data;
+    if (subscriber->buffer.size < SPECTATE_RING_OFFSET ||
+        memcmp(header->magic, SPECTATE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SPECTATE_VERSION || header->games_n == 0 ||
+        header->games_n > SPECTATE_GAMES_MAX ||
+        subscriber->buffer.size < SPECTATE_RING_OFFSET + header->capacity) {
+        shared_buffer_close(&subscriber->buffer);
+        return false;
+    }
+    subscriber->header = header;
+    subscriber->ring =
+        (const uint8_t*)subscriber->buffer.data + SPECTATE_RING_OFFSET;
+    subscriber->games_n = header->games_n;
+    subscriber->games = calloc(header->games_n, sizeof(*subscriber->games));
+    subscriber->record = malloc(get_record_max(header->games_n));
+    if (!subscriber->games || !subscriber->record) {
+        spectate_subscriber_close(subscriber);
+        return false;
+    }
+    return true;
+}
+
+void spectate_subscriber_close(SpectateSubscriber* subscriber) {
+    shared_buffer_close(&subscriber->buffer);
+    free(subscriber->games);
+    free(subscriber->record);
+    *subscriber = (SpectateSubscriber){0};
+}
+
+static bool same_game(const GameState* a, const GameState* b) {
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        if (a->field[i] != b->field[i]) return false;
+    }
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        if (pack_block(&a->held_blocks[i]) != pack_block(&b->held_blocks[i])) {
+            return false;
+        }
+    }
+    return a->points == b->points && a->combo == b->combo &&
+           a->blocks_placed == b->blocks_placed;
+}
+
+// the snapshot in a game record or keyframe, checked against the state the
+// moves led to if check is set
+static const uint8_t* apply_snapshot(SpectateSubscriber* subscriber,
+                                     const uint8_t* p, const uint8_t* end,
+                                     bool check) {
+    uint32_t game;
+    GameState state;
+    p = get_snapshot(p, end, subscriber->games_n, &game, &state);
+    if (!p) return NULL;
+    if (check && !same_game(&subscriber->games[game], &state)) {
+        subscriber->diverged_n++;
+    }
+    subscriber->games[game] = state;
+    return p;
+}
+
+static bool apply_move_record(SpectateSubscriber* subscriber, uint8_t kind,
+                              const uint8_t* p, const uint8_t* end) {
+    uint64_t game = 0, points = 0, combo = 0;
+    uint8_t slot_cell[2], lines[2] = {0};
+    PackedBlock dealt[HELD_BLOCKS_N];
+    p = get_varint(p, end, &game);
+    p = get_bytes(p, end, slot_cell, sizeof(slot_cell));
+    if (kind & SPECTATE_MOVE_CLEARED) p = get_bytes(p, end, lines, 2);
+    if (kind & SPECTATE_MOVE_DEALT) p = get_bytes(p, end, dealt, sizeof(dealt));
+    p = get_varint(p, end, &points);
+    p = get_varint(p, end, &combo);
+    if (!p || game >= subscriber->games_n || slot_cell[0] >= HELD_BLOCKS_N ||
+        slot_cell[1] >= FIELD_SIZE * FIELD_SIZE) {
+        return false;
+    }
+
+    GameState* state = &subscriber->games[game];
+    Block* block = &state->held_blocks[slot_cell[0]];
+    if (block->item == CELL_ITEM_EMPTY) return false;
+    state->field[block->item - 1] |= get_block_mask(block)->cells
+                                     << slot_cell[1];
+    *block = get_empty_block();
+    Board cleared = board_lines_cells(lines[0], lines[1]);
+    for (int i = 0; i < CELL_COLORS_N; ++i) state->field[i] &= ~cleared;
+    state->blocks_placed++;
+    // blocks_placed counts the current turn, a deal starts the next one
+    if (kind & SPECTATE_MOVE_DEALT) {
+        for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+            state->held_blocks[i] = unpack_block(dealt[i]);
+        }
+        state->blocks_placed = 0;
+    }
+    state->points += points;
+    state->combo = combo;
+    return true;
+}
+
+static bool apply_record(SpectateSubscriber* subscriber, uint32_t size,
+                         bool check) {
+    const uint8_t* p = subscriber->record;
+    const uint8_t* end = p + size;
+    uint8_t kind = *p++;
+    switch (kind & SPECTATE_KIND_MASK) {
+    case SPECTATE_RECORD_KEYFRAME: {
+        uint64_t games_n;
+        p = get_varint(p, end, &games_n);
+        if (!p || games_n != subscriber->games_n) return false;
+        for (uint64_t i = 0; p && i < games_n; ++i) {
+            p = apply_snapshot(subscriber, p, end, check);
+        }
+        return p != NULL;
+    }
+    case SPECTATE_RECORD_GAME:
+        return apply_snapshot(subscriber, p, end, false) != NULL;
+    case SPECTATE_RECORD_MOVE:
+        return apply_move_record(subscriber, kind, p, end);
+    default:
+        return false;
+    }
+}
+
+int spectate_poll(SpectateSubscriber* subscriber) {
+    const SpectateHeader* header = subscriber->header;
+    uint32_t capacity = header->capacity;
+    uint32_t record_max = get_record_max(subscriber->games_n);
+    int records_n = 0;
+    for (;;) {
+        uint64_t write_pos =
+            atomic_load_explicit(&header->write_pos, memory_order_acquire);
+        // the keyframe after a jump is where the games come from, the
+        // others have to agree with them
+        bool check = true;
+        if (!subscriber->synced ||
+            write_pos - subscriber->read_pos > capacity - record_max) {
+            subscriber->read_pos = atomic_load_explicit(&header->keyframe_pos,
+                                                        memory_order_acquire);
+            subscriber->synced = true;
+            subscriber->resyncs_n++;
+            check = false;
+        }
+        bool lapped = false;
+        while (subscriber->read_pos < write_pos) {
+            uint64_t pos = subscriber->read_pos;
+            uint32_t size;
+            ring_read(subscriber->ring, capacity, pos, &size, sizeof(size));
+            if (size == 0 || size > record_max) {
+                lapped = true;
+                break;
+            }
+            ring_read(subscriber->ring, capacity, pos + sizeof(size),
+                      subscriber->record, size);
+            // the publisher may have written over the record while it was
+            // copied, anything up to a record past write_pos is fair game
+            atomic_thread_fence(memory_order_acquire);
+            uint64_t now_pos = atomic_load_explicit(&header->write_pos,
+                                                    memory_order_relaxed);
+            if (now_pos + record_max - pos > capacity) {
+                lapped = true;
+                break;
+            }
+            if (!apply_record(subscriber, size, check)) {
+                // a record that makes no sense for the games, the next poll
+                // starts over from a keyframe
+                subscriber->diverged_n++;
+                subscriber->synced = false;
+                return records_n;
+            }
+            check = true;
+            subscriber->read_pos = pos + sizeof(size) + size;
+            subscriber->records_n++;
+            records_n++;
+        }
+        if (!lapped) return records_n;
+        subscriber->synced = false;
+    }
+}
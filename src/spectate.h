@@ -0,0 +1,114 @@
+#if !defined(SPECTATE_H)
+#define SPECTATE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "shm.h"
+
+// a stream of the moves of a set of games, for any number of spectators on
+// the machine. one publisher appends records to a ring in shared memory and
+// never waits for anyone. every subscriber keeps its own read position and
+// its own copy of the games, which it advances with the records.
+//
+// a move record carries only what changed: the slot and cell of the placed
+// block, the full rows and columns it cleared, the blocks dealt if any and
+// the points gained, about 11 bytes with its size where a full state takes
+// 32. a keyframe with the state of every game is written every so many
+// moves of each game, so it costs every move the same share of a state
+// however many games there are. a subscriber joining late, or one that fell so far behind that the ring
+// wrapped over its position, starts over from the latest keyframe.
+//
+// records in the ring: uint32_t size, then size bytes starting with the
+// kind. numbers are varints, boards 8 bytes in native byte order.
+
+#define SPECTATE_MAGIC "RMSP"
+#define SPECTATE_VERSION 1
+
+#define SPECTATE_GAMES_MAX 1024
+// the largest encoded state of one game
+#define SPECTATE_SNAPSHOT_MAX 48
+// bytes between keyframes are kept under a quarter of the ring, so a
+// keyframe is always there to start from
+#define SPECTATE_RING_MIN_RECORDS 4
+
+typedef enum SpectateRecordKind {
+    SPECTATE_RECORD_KEYFRAME = 1,  // games_n, then a snapshot of each
+    SPECTATE_RECORD_GAME,          // a snapshot of a game that restarted
+    SPECTATE_RECORD_MOVE,
+} SpectateRecordKind;
+
+// flags of a move record, in the kind byte
+#define SPECTATE_MOVE_CLEARED 0x40  // rows and cols bytes follow
+#define SPECTATE_MOVE_DEALT 0x80    // the packed new blocks follow
+#define SPECTATE_KIND_MASK 0x3f
+
+typedef struct SpectateHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t capacity;  // of the ring, a power of two
+    uint32_t games_n;
+    // bytes ever written, stored once the record is complete
+    _Atomic uint64_t write_pos;
+    // stream position of the latest keyframe
+    _Atomic uint64_t keyframe_pos;
+} SpectateHeader;
+
+typedef struct SpectatePublisher {
+    SharedBuffer buffer;
+    SpectateHeader* header;
+    uint8_t* ring;
+    char name[64];
+    GameState* games;  // latest state of every game, for the keyframes
+    uint8_t* record;   // scratch for the record being encoded
+    uint32_t keyframe_every;  // moves of each game
+    uint64_t moves_since_keyframe;
+    uint64_t moves_n;
+    uint64_t move_bytes;
+    uint64_t keyframes_n;
+    uint64_t keyframe_bytes;
+} SpectatePublisher;
+
+typedef struct SpectateSubscriber {
+    SharedBuffer buffer;
+    const SpectateHeader* header;
+    const uint8_t* ring;
+    uint64_t read_pos;
+    bool synced;
+    GameState* games;  // only field, held blocks and the counters are kept
+    uint32_t games_n;
+    uint8_t* record;
+    uint64_t records_n;
+    uint64_t resyncs_n;  // jumps to a keyframe, the first one included
+    // keyframes that didn't match the state the moves led to, always 0
+    // unless the stream is broken
+    uint64_t diverged_n;
+} SpectateSubscriber;
+
+// creates the named shared memory stream of games_n empty games, the
+// capacity is rounded up to a power of two. keyframes are written every
+// keyframe_every moves of each game, keyframe_every * games_n moves in all,
+// more often if the moves fill a quarter of the ring
+bool spectate_publisher_open(SpectatePublisher* publisher, const char* name,
+                             uint32_t games_n, uint32_t capacity,
+                             uint32_t keyframe_every);
+// removes the stream, subscribers keep their mapping
+void spectate_publisher_close(SpectatePublisher* publisher);
+// a game (re)started with this state
+void spectate_publish_game(SpectatePublisher* publisher, uint32_t game,
+                           const GameState* state);
+// a move made by apply_move, with the state after it and the undo it
+// filled in
+void spectate_publish_move(SpectatePublisher* publisher, uint32_t game,
+                           const GameState* state, Move move,
+                           const PlacementUndo* undo);
+
+bool spectate_subscriber_open(SpectateSubscriber* subscriber,
+                              const char* name);
+void spectate_subscriber_close(SpectateSubscriber* subscriber);
+// applies the records published since the last poll and returns how many
+int spectate_poll(SpectateSubscriber* subscriber);
+
+#endif  // SPECTATE_H
@@ -0,0 +1,111 @@
+#if !defined(STATS_H)
+#define STATS_H
+
+#include <math.h>
+#include <stdint.h>
+
+// confidence intervals shared by the estimators
+
+// z of a two sided 95% interval
+#define STATS_Z_95 1.96
+
+// wilson score interval of a success rate, which stays sensible for rates
+// near 0 or 1 and few trials. [0, 1] without any trials
+static inline void get_wilson_interval(uint64_t successes_n, uint64_t n,
+                                       double z, double* low_out,
+                                       double* high_out) {
+    if (n == 0) {
+        *low_out = 0;
+        *high_out = 1;
+        return;
+    }
+    double p = (double)successes_n / n;
+    double z2 = z * z;
+    double center = (p + z2 / (2.0 * n)) / (1 + z2 / n);
+    double margin =
+        z / (1 + z2 / n) * sqrt(p * (1 - p) / n + z2 / (4.0 * n * n));
+    *low_out = fmax(0, center - margin);
+    *high_out = fmin(1, center + margin);
+}
+
+// running mean and variance (welford), adding samples one at a time keeps
+// it exact over millions of games
+typedef struct RunningStats {
+    uint64_t n;
+    double mean;
+    double m2;  // sum of squared deviations from the mean
+} RunningStats;
+
+static inline void running_stats_add(RunningStats* stats, double x) {
+    stats->n++;
+    double delta = x - stats->mean;
+    stats->mean += delta / stats->n;
+    stats->m2 += delta * (x - stats->mean);
+}
+
+// standard error of the mean, 0 with fewer than two samples
+static inline double running_stats_error(const RunningStats* stats) {
+    if (stats->n < 2) return 0;
+    return sqrt(stats->m2 / (stats->n - 1) / stats->n);
+}
+
+// latencies in nanoseconds, counted in buckets that split every power of
+// two into 16 steps, so a percentile is off by at most 1/16 whatever the
+// range, at a fixed 8kb
+#define LATENCY_SUB_BITS 4
+#define LATENCY_BUCKETS_N ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+typedef struct LatencyHistogram {
+    uint64_t counts[LATENCY_BUCKETS_N];
+    uint64_t n;
+    uint64_t max;
+} LatencyHistogram;
+
+static inline int get_latency_bucket(uint64_t nanoseconds) {
+    if (nanoseconds < 1u << LATENCY_SUB_BITS) return (int)nanoseconds;
+    int shift = 63 - __builtin_clzll(nanoseconds) - LATENCY_SUB_BITS;
+    return ((shift + 1) << LATENCY_SUB_BITS) +
+           (int)((nanoseconds >> shift) & ((1u << LATENCY_SUB_BITS) - 1));
+}
+
+// the largest latency that lands in the bucket
+static inline uint64_t get_latency_bucket_max(int bucket) {
+    if (bucket < 1 << LATENCY_SUB_BITS) return bucket;
+    int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t step = bucket & ((1u << LATENCY_SUB_BITS) - 1);
+    return (((1ull << LATENCY_SUB_BITS) + step + 1) << shift) - 1;
+}
+
+static inline void latency_histogram_add(LatencyHistogram* histogram,
+                                         uint64_t nanoseconds) {
+    histogram->counts[get_latency_bucket(nanoseconds)]++;
+    histogram->n++;
+    if (nanoseconds > histogram->max) histogram->max = nanoseconds;
+}
+
+static inline void latency_histogram_merge(LatencyHistogram* histogram,
+                                           const LatencyHistogram* other) {
+    for (int i = 0; i < LATENCY_BUCKETS_N; ++i) {
+        histogram->counts[i] += other->counts[i];
+    }
+    histogram->n += other->n;
+    if (other->max > histogram->max) histogram->max = other->max;
+}
+
+// latency that q of the samples don't exceed, q from 0 to 1. 0 when empty
+static inline uint64_t latency_histogram_quantile(
+    const LatencyHistogram* histogram, double q) {
+    uint64_t rank = (uint64_t)ceil(q * histogram->n);
+    if (rank < 1) rank = 1;
+    uint64_t seen_n = 0;
+    for (int i = 0; i < LATENCY_BUCKETS_N; ++i) {
+        seen_n += histogram->counts[i];
+        if (seen_n >= rank) {
+            uint64_t latency = get_latency_bucket_max(i);
+            return latency < histogram->max ? latency : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+#endif  // STATS_H
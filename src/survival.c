@@ -0,0 +1,160 @@
+#include "survival.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "parallel.h"
+#include "stats.h"
+
+// rollouts played between two looks at the interval
+#define SURVIVAL_BATCH_N 64
+
+SurvivalParams make_survival_params(PolicyKind policy, int turns_n) {
+    return (SurvivalParams){
+        .policy = policy,
+        .turns_n = turns_n,
+        .seed = 1,
+        .half_width = 0.01,
+        .min_rollouts_n = 256,
+        .max_rollouts_n = 1 << 17,
+        .threads_n = parallel_default_threads(),
+    };
+}
+
+static void make_estimate(uint64_t survived_n, uint64_t rollouts_n,
+                          SurvivalEstimate* estimate_out) {
+    *estimate_out = (SurvivalEstimate){
+        .rollouts_n = rollouts_n,
+        .survived_n = survived_n,
+        .high = 1,
+    };
+    if (rollouts_n == 0) return;
+
+    estimate_out->probability = (double)survived_n / rollouts_n;
+    get_wilson_interval(survived_n, rollouts_n, STATS_Z_95,
+                        &estimate_out->low, &estimate_out->high);
+}
+
+static bool estimate_done(uint64_t survived_n, uint64_t rollouts_n,
+                          const SurvivalParams* params) {
+    if (rollouts_n >= params->max_rollouts_n) return true;
+    if (params->half_width <= 0 || rollouts_n < params->min_rollouts_n) {
+        return false;
+    }
+    SurvivalEstimate estimate;
+    make_estimate(survived_n, rollouts_n, &estimate);
+    return (estimate.high - estimate.low) / 2 <= params->half_width;
+}
+
+// plays rollouts_n games from state, each with its own future blocks
+static uint64_t play_rollouts(const GameState* state,
+                              const SurvivalParams* params, Rng* rng,
+                              uint64_t rollouts_n) {
+    uint64_t survived_n = 0;
+    for (uint64_t i = 0; i < rollouts_n; ++i) {
+        GameState rollout = *state;
+        rollout.rng = make_rng(rng_next(rng));
+        bool alive = true;
+        for (int turn = 0; turn < params->turns_n && alive; ++turn) {
+            alive = play_turn(params->policy, &rollout, rng, NULL, NULL);
+        }
+        survived_n += alive;
+    }
+    return survived_n;
+}
+
+typedef struct ParallelEstimateCtx {
+    const GameState* state;
+    const SurvivalParams* params;
+    _Atomic uint64_t claimed_n;
+    _Atomic uint64_t rollouts_n;
+    _Atomic uint64_t survived_n;
+    _Atomic bool done;
+} ParallelEstimateCtx;
+
+static void estimate_thread(void* arg, int thread_index, int threads_n) {
+    (void)threads_n;
+    ParallelEstimateCtx* ctx = arg;
+    const SurvivalParams* params = ctx->params;
+    // every thread has its own stream of rollout seeds
+    Rng rng = make_rng(params->seed ^ (uint64_t)thread_index << 32);
+
+    while (!atomic_load(&ctx->done)) {
+        uint64_t first = atomic_fetch_add(&ctx->claimed_n, SURVIVAL_BATCH_N);
+        if (first >= params->max_rollouts_n) break;
+        uint64_t batch_n = params->max_rollouts_n - first;
+        if (batch_n > SURVIVAL_BATCH_N) batch_n = SURVIVAL_BATCH_N;
+
+        uint64_t survived = play_rollouts(ctx->state, params, &rng, batch_n);
+        uint64_t survived_n =
+            atomic_fetch_add(&ctx->survived_n, survived) + survived;
+        uint64_t rollouts_n =
+            atomic_fetch_add(&ctx->rollouts_n, batch_n) + batch_n;
+        // the two counters may be a batch apart here, which only matters
+        // for when to stop
+        if (estimate_done(survived_n, rollouts_n, params)) {
+            atomic_store(&ctx->done, true);
+        }
+    }
+}
+
+void estimate_survival(const GameState* state, const SurvivalParams* params,
+                       SurvivalEstimate* estimate_out) {
+    ParallelEstimateCtx ctx = {.state = state, .params = params};
+    if (!parallel_run(params->threads_n > 0 ? params->threads_n : 1,
+                      estimate_thread, &ctx)) {
+        estimate_thread(&ctx, 0, 1);
+    }
+    make_estimate(atomic_load(&ctx.survived_n), atomic_load(&ctx.rollouts_n),
+                  estimate_out);
+}
+
+typedef struct BatchEstimateCtx {
+    const GameState* states;
+    int states_n;
+    const SurvivalParams* params;
+    SurvivalEstimate* estimates;
+    _Atomic int next_state;
+} BatchEstimateCtx;
+
+static void estimate_batch_thread(void* arg, int thread_index,
+                                  int threads_n) {
+    (void)thread_index;
+    (void)threads_n;
+    BatchEstimateCtx* ctx = arg;
+    const SurvivalParams* params = ctx->params;
+    for (;;) {
+        int i = atomic_fetch_add(&ctx->next_state, 1);
+        if (i >= ctx->states_n) break;
+
+        // seeded by position, so the estimates don't depend on the threads
+        Rng rng = make_rng(params->seed ^ (uint64_t)i << 32);
+        uint64_t rollouts_n = 0;
+        uint64_t survived_n = 0;
+        while (!estimate_done(survived_n, rollouts_n, params)) {
+            uint64_t batch_n = params->max_rollouts_n - rollouts_n;
+            if (batch_n > SURVIVAL_BATCH_N) batch_n = SURVIVAL_BATCH_N;
+            survived_n +=
+                play_rollouts(&ctx->states[i], params, &rng, batch_n);
+            rollouts_n += batch_n;
+        }
+        make_estimate(survived_n, rollouts_n, &ctx->estimates[i]);
+    }
+}
+
+void estimate_survival_batch(const GameState* states, int states_n,
+                             const SurvivalParams* params,
+                             SurvivalEstimate* estimates_out) {
+    BatchEstimateCtx ctx = {
+        .states = states,
+        .states_n = states_n,
+        .params = params,
+        .estimates = estimates_out,
+    };
+    int threads_n = params->threads_n > 0 ? params->threads_n : 1;
+    if (threads_n > states_n) threads_n = states_n;
+    if (threads_n > 0 &&
+        !parallel_run(threads_n, estimate_batch_thread, &ctx)) {
+        estimate_batch_thread(&ctx, 0, 1);
+    }
+}
@@ -0,0 +1,46 @@
+#if !defined(SURVIVAL_H)
+#define SURVIVAL_H
+
+#include <stdint.h>
+
+#include "game.h"
+#include "policy.h"
+
+// monte carlo estimates of how likely a policy is to survive the next
+// turns_n turns from a position. every rollout deals its own future blocks
+// from a fresh seed, the rest of the current turn counts as the first turn.
+
+typedef struct SurvivalParams {
+    PolicyKind policy;
+    int turns_n;
+    uint64_t seed;  // rollout seeds are drawn from it
+    // rollouts stop once the 95% interval is at most this wide on either
+    // side, or at max_rollouts_n. 0 always plays max_rollouts_n
+    double half_width;
+    uint64_t min_rollouts_n;
+    uint64_t max_rollouts_n;
+    int threads_n;
+} SurvivalParams;
+
+typedef struct SurvivalEstimate {
+    double probability;
+    double low;  // 95% wilson score interval
+    double high;
+    uint64_t rollouts_n;
+    uint64_t survived_n;
+} SurvivalEstimate;
+
+// default params, survive turns_n turns to within +-1% with every core
+SurvivalParams make_survival_params(PolicyKind policy, int turns_n);
+
+// one position, its rollouts spread across params->threads_n threads
+void estimate_survival(const GameState* state, const SurvivalParams* params,
+                       SurvivalEstimate* estimate_out);
+// many positions, each estimated on a single thread and the positions
+// spread across the threads, which keeps every core busy without any
+// sharing between them
+void estimate_survival_batch(const GameState* states, int states_n,
+                             const SurvivalParams* params,
+                             SurvivalEstimate* estimates_out);
+
+#endif  // SURVIVAL_H
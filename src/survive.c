@@ -0,0 +1,154 @@
+#include "survive.h"
+
+#include <stdlib.h>
+
+#define SURVIVE_TABLE_BITS 16
+#define SURVIVE_TABLE_SIZE (1 << SURVIVE_TABLE_BITS)
+#define SURVIVE_PROBES_MAX 16
+
+typedef struct SurviveEntry {
+    Board board;
+    uint64_t lines_n;
+    uint32_t generation;  // the entry is empty unless it's the current one
+    uint8_t left;  // bit per slot still to place
+} SurviveEntry;
+
+struct SurviveSolver {
+    const BlockMask* masks[HELD_BLOCKS_N];
+    uint32_t generation;
+    bool count_lines;
+    uint64_t nodes_n;
+    SurviveEntry table[SURVIVE_TABLE_SIZE];
+};
+
+SurviveSolver* survive_solver_new(void) {
+    return calloc(1, sizeof(SurviveSolver));
+}
+
+void survive_solver_free(SurviveSolver* solver) { free(solver); }
+
+static inline uint32_t hash_position(Board board, unsigned left) {
+    uint64_t h = (board ^ (uint64_t)left << 61) * 0x9e3779b97f4a7c15ull;
+    return (uint32_t)(h >> (64 - SURVIVE_TABLE_BITS));
+}
+
+// the entry of the position, or the empty one it should go into. NULL if
+// the probes ran out, then the position just isn't stored
+static SurviveEntry* find_entry(SurviveSolver* solver, Board board,
+                                unsigned left) {
+    uint32_t index = hash_position(board, left);
+    for (int i = 0; i < SURVIVE_PROBES_MAX; ++i) {
+        SurviveEntry* entry =
+            &solver->table[(index + i) & (SURVIVE_TABLE_SIZE - 1)];
+        if (entry->generation != solver->generation ||
+            (entry->board == board && entry->left == left)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static inline Board place_and_clear(Board occupied, Board placed) {
+    Board board = occupied | placed;
+    return board & ~board_lines_cells(board_full_rows(board),
+                                      board_full_cols(board));
+}
+
+static uint64_t solve_node(SurviveSolver* solver, Board occupied,
+                           unsigned left) {
+    solver->nodes_n++;
+    SurviveEntry* entry = find_entry(solver, occupied, left);
+    if (entry && entry->generation == solver->generation) {
+        return entry->lines_n;
+    }
+
+    uint64_t lines_n = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        if (!(left & (1u << slot))) continue;
+        const BlockMask* mask = solver->masks[slot];
+        // for a yes or no, a block just like an earlier one left changes
+        // nothing
+        bool duplicate = false;
+        for (int i = 0; i < slot; ++i) {
+            duplicate |= (left & (1u << i)) &&
+                         solver->masks[i]->cells == mask->cells;
+        }
+        if (duplicate && !solver->count_lines) continue;
+        Board legal = get_legal_origins(occupied, mask);
+        unsigned rest = left & ~(1u << slot);
+
+        if (!rest) {
+            // the last block, every legal corner finishes a line of play
+            lines_n += board_popcount(legal);
+        } else {
+            for (; legal; legal &= legal - 1) {
+                int cell = __builtin_ctzll(legal);
+                Board next = place_and_clear(occupied, mask->cells << cell);
+                lines_n += solve_node(solver, next, rest);
+                if (lines_n && !solver->count_lines) break;
+            }
+        }
+        if (lines_n && !solver->count_lines) break;
+    }
+
+    if (entry) {
+        *entry = (SurviveEntry){
+            .board = occupied,
+            .lines_n = lines_n,
+            .generation = solver->generation,
+            .left = left,
+        };
+    }
+    return lines_n;
+}
+
+static void solve(SurviveSolver* solver, Board occupied,
+                  const PackedBlock held_blocks[HELD_BLOCKS_N],
+                  bool count_lines, SurviveResult* result_out) {
+    // a new generation empties the table without touching it
+    if (++solver->generation == 0) {
+        for (int i = 0; i < SURVIVE_TABLE_SIZE; ++i) {
+            solver->table[i].generation = 0;
+        }
+        solver->generation = 1;
+    }
+    solver->count_lines = count_lines;
+    solver->nodes_n = 0;
+
+    unsigned left = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        Block block = unpack_block(held_blocks[slot]);
+        if (block.item == CELL_ITEM_EMPTY) continue;
+        solver->masks[slot] = get_block_mask(&block);
+        left |= 1u << slot;
+    }
+
+    uint64_t lines_n = left ? solve_node(solver, occupied, left) : 1;
+    *result_out = (SurviveResult){
+        .survives = lines_n > 0,
+        .lines_n = count_lines ? lines_n : lines_n > 0,
+        .nodes_n = solver->nodes_n,
+    };
+}
+
+void survive_check(SurviveSolver* solver, Board occupied,
+                   const PackedBlock held_blocks[HELD_BLOCKS_N],
+                   SurviveResult* result_out) {
+    solve(solver, occupied, held_blocks, false, result_out);
+}
+
+void survive_count_lines(SurviveSolver* solver, Board occupied,
+                         const PackedBlock held_blocks[HELD_BLOCKS_N],
+                         SurviveResult* result_out) {
+    solve(solver, occupied, held_blocks, true, result_out);
+}
+
+bool state_can_survive(SurviveSolver* solver, const GameState* state) {
+    PackedBlock held_blocks[HELD_BLOCKS_N];
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        held_blocks[slot] = pack_block(&state->held_blocks[slot]);
+    }
+    SurviveResult result;
+    survive_check(solver, get_occupied_cells(state), held_blocks, &result);
+    return result.survives;
+}
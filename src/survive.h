@@ -0,0 +1,43 @@
+#if !defined(SURVIVE_H)
+#define SURVIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "block.h"
+#include "game.h"
+
+// exact answers about the blocks still held in the current turn. a line of
+// play is an order and placement of all of them, as a sequence of moves, and
+// the board survives the turn if there is at least one. positions reached
+// in more than one way are solved once, through a hash table of
+// (board, blocks left) that the solver keeps between calls.
+
+typedef struct SurviveResult {
+    bool survives;
+    // lines of play, only counted by survive_count_lines, otherwise 1 if
+    // the board survives
+    uint64_t lines_n;
+    uint64_t nodes_n;
+} SurviveResult;
+
+typedef struct SurviveSolver SurviveSolver;
+
+// init_block_masks must have been called. a solver must only be used by
+// one thread at a time
+SurviveSolver* survive_solver_new(void);
+void survive_solver_free(SurviveSolver* solver);
+
+// stops at the first line of play found
+void survive_check(SurviveSolver* solver, Board occupied,
+                   const PackedBlock held_blocks[HELD_BLOCKS_N],
+                   SurviveResult* result_out);
+void survive_count_lines(SurviveSolver* solver, Board occupied,
+                         const PackedBlock held_blocks[HELD_BLOCKS_N],
+                         SurviveResult* result_out);
+
+// survive_check on a game's current turn
+bool state_can_survive(SurviveSolver* solver, const GameState* state);
+
+#endif  // SURVIVE_H
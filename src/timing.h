@@ -0,0 +1,20 @@
+#if !defined(TIMING_H)
+#define TIMING_H
+
+// needs _GNU_SOURCE (or _POSIX_C_SOURCE) defined by the including file
+#include <stdint.h>
+#include <time.h>
+
+static inline double get_time_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline uint64_t get_time_nanoseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif  // TIMING_H
@@ -0,0 +1,232 @@
+// re-simulates every game of a replay archive on all cores and prints
+// aggregate statistics
+//
+// usage: analyze <archive> [threads] [score bucket width]
+
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "parallel.h"
+#include "replay.h"
+#include "timing.h"
+
+#define ANALYZE_CHUNK_GAMES 4096
+#define SCORE_BUCKETS_N 64
+#define COMBO_LENGTHS_N 32
+// held block sets are sorted shape triples, an empty slot counting as
+// BLOCK_SHAPES_MAX
+#define HELD_SHAPES_N (BLOCK_SHAPES_MAX + 1)
+#define HELD_SETS_N (HELD_SHAPES_N * HELD_SHAPES_N * HELD_SHAPES_N)
+
+typedef struct AnalyzeStats {
+    uint64_t games_n;
+    uint64_t moves_n;
+    uint64_t bytes_n;
+    uint64_t invalid_games_n;
+    uint64_t score_buckets[SCORE_BUCKETS_N];  // last bucket is open ended
+    uint64_t shape_placements[BLOCK_SHAPES_MAX];
+    uint64_t shape_lines_cleared[BLOCK_SHAPES_MAX];
+    uint64_t combo_lengths[COMBO_LENGTHS_N];  // last length is open ended
+    uint64_t game_over_held_sets[HELD_SETS_N];
+} AnalyzeStats;
+
+typedef struct AnalyzeCtx {
+    const ReplayArchive* archive;
+    int score_bucket_width;
+    _Atomic uint64_t next_chunk;
+    AnalyzeStats* thread_stats;
+} AnalyzeCtx;
+
+static void record_combo(AnalyzeStats* stats, int combo) {
+    // a combo of n means n - 1 clearing placements in a row
+    int length = combo - 1;
+    if (length <= 0) return;
+    if (length >= COMBO_LENGTHS_N) length = COMBO_LENGTHS_N - 1;
+    stats->combo_lengths[length]++;
+}
+
+static int get_held_set(const GameState* state) {
+    int shapes[HELD_BLOCKS_N];
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        const Block* block = &state->held_blocks[i];
+        shapes[i] =
+            block->item == CELL_ITEM_EMPTY ? BLOCK_SHAPES_MAX : block->shape;
+    }
+    for (int i = 1; i < HELD_BLOCKS_N; ++i) {
+        for (int j = i; j > 0 && shapes[j - 1] > shapes[j]; --j) {
+            int tmp = shapes[j];
+            shapes[j] = shapes[j - 1];
+            shapes[j - 1] = tmp;
+        }
+    }
+    return (shapes[0] * HELD_SHAPES_N + shapes[1]) * HELD_SHAPES_N + shapes[2];
+}
+
+static void analyze_game(AnalyzeCtx* ctx, AnalyzeStats* stats,
+                         const ReplayIndexEntry* entry) {
+    const Move* moves = replay_game_moves(ctx->archive, entry);
+    if (!moves) {
+        stats->invalid_games_n++;
+        return;
+    }
+
+    GameState state = make_gamestate(entry->seed);
+    for (uint32_t i = 0; i < entry->moves_n; ++i) {
+        int slot = moves[i].slot % HELD_BLOCKS_N;
+        BlockShape shape = state.held_blocks[slot].shape;
+        int prev_combo = state.combo;
+        int lines_cleared = apply_move(&state, moves[i], NULL);
+        if (lines_cleared < 0) {
+            stats->invalid_games_n++;
+            return;
+        }
+        stats->shape_placements[shape]++;
+        stats->shape_lines_cleared[shape] += lines_cleared;
+        if (state.combo < prev_combo) record_combo(stats, prev_combo);
+    }
+    if (state.points != entry->score || !is_game_over(&state)) {
+        stats->invalid_games_n++;
+        return;
+    }
+    record_combo(stats, state.combo);
+
+    int bucket = state.points / ctx->score_bucket_width;
+    if (bucket >= SCORE_BUCKETS_N) bucket = SCORE_BUCKETS_N - 1;
+    stats->score_buckets[bucket]++;
+    stats->game_over_held_sets[get_held_set(&state)]++;
+    stats->games_n++;
+    stats->moves_n += entry->moves_n;
+    stats->bytes_n += sizeof(*entry) + entry->moves_n * sizeof(Move);
+}
+
+static void analyze_thread(void* arg, int thread_index, int threads_n) {
+    (void)threads_n;
+    AnalyzeCtx* ctx = arg;
+    AnalyzeStats* stats = &ctx->thread_stats[thread_index];
+    uint64_t games_n = ctx->archive->games_n;
+
+    for (;;) {
+        uint64_t first = atomic_fetch_add(&ctx->next_chunk, 1) *
+                         ANALYZE_CHUNK_GAMES;
+        if (first >= games_n) break;
+        uint64_t last = first + ANALYZE_CHUNK_GAMES;
+        if (last > games_n) last = games_n;
+        for (uint64_t game = first; game < last; ++game) {
+            analyze_game(ctx, stats, replay_game(ctx->archive, game));
+        }
+    }
+}
+
+static void merge_stats(AnalyzeStats* into, const AnalyzeStats* from) {
+    // every field is a uint64_t counter
+    uint64_t* dst = (uint64_t*)into;
+    const uint64_t* src = (const uint64_t*)from;
+    for (size_t i = 0; i < sizeof(*into) / sizeof(uint64_t); ++i) {
+        dst[i] += src[i];
+    }
+}
+
+static const char* get_held_shape_name(int shape) {
+    return shape == BLOCK_SHAPES_MAX ? "-" : get_shape_name(shape);
+}
+
+static void print_stats(const AnalyzeStats* stats, int score_bucket_width) {
+    printf("\nscores:\n");
+    for (int i = 0; i < SCORE_BUCKETS_N; ++i) {
+        if (!stats->score_buckets[i]) continue;
+        if (i == SCORE_BUCKETS_N - 1) {
+            printf("  %8d+        %10llu\n", i * score_bucket_width,
+                   (unsigned long long)stats->score_buckets[i]);
+        } else {
+            printf("  %8d-%-8d %10llu\n", i * score_bucket_width,
+                   (i + 1) * score_bucket_width - 1,
+                   (unsigned long long)stats->score_buckets[i]);
+        }
+    }
+
+    printf("\nlines cleared per placement:\n");
+    for (int i = 0; i < get_shapes_n(); ++i) {
+        uint64_t placements = stats->shape_placements[i];
+        printf("  %-4s %12llu placements %8.4f lines/placement\n",
+               get_shape_name(i), (unsigned long long)placements,
+               placements ? (double)stats->shape_lines_cleared[i] / placements
+                          : 0.0);
+    }
+
+    printf("\ncombo lengths:\n");
+    for (int i = 1; i < COMBO_LENGTHS_N; ++i) {
+        if (!stats->combo_lengths[i]) continue;
+        printf("  %3d%s %10llu\n", i, i == COMBO_LENGTHS_N - 1 ? "+" : " ",
+               (unsigned long long)stats->combo_lengths[i]);
+    }
+
+    printf("\nheld blocks at game over:\n");
+    for (int i = 0; i < HELD_SETS_N; ++i) {
+        uint64_t n = stats->game_over_held_sets[i];
+        if (!n) continue;
+        printf("  %-4s %-4s %-4s %10llu %6.2f%%\n",
+               get_held_shape_name(i / (HELD_SHAPES_N * HELD_SHAPES_N)),
+               get_held_shape_name(i / HELD_SHAPES_N % HELD_SHAPES_N),
+               get_held_shape_name(i % HELD_SHAPES_N), (unsigned long long)n,
+               100.0 * n / stats->games_n);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <archive> [threads] [score bucket width]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    int threads_n = argc > 2 ? atoi(argv[2]) : parallel_default_threads();
+    if (threads_n < 1) threads_n = 1;
+    int score_bucket_width = argc > 3 ? atoi(argv[3]) : 50;
+    if (score_bucket_width < 1) score_bucket_width = 1;
+
+    ReplayArchive archive;
+    if (!replay_archive_open(&archive, argv[1])) {
+        fprintf(stderr, "failed to open %s\n", argv[1]);
+        return 1;
+    }
+    replay_archive_advise_sequential(&archive);
+
+    AnalyzeCtx ctx = {
+        .archive = &archive,
+        .score_bucket_width = score_bucket_width,
+        .thread_stats = calloc(threads_n, sizeof(AnalyzeStats)),
+    };
+    if (!ctx.thread_stats) {
+        fprintf(stderr, "out of memory\n");
+        replay_archive_close(&archive);
+        return 1;
+    }
+
+    double start = get_time_seconds();
+    if (!parallel_run(threads_n, analyze_thread, &ctx)) {
+        analyze_thread(&ctx, 0, 1);
+    }
+    double secs = get_time_seconds() - start;
+
+    AnalyzeStats stats = {0};
+    for (int i = 0; i < threads_n; ++i) {
+        merge_stats(&stats, &ctx.thread_stats[i]);
+    }
+
+    printf("%llu games, %llu moves, %llu invalid\n",
+           (unsigned long long)stats.games_n,
+           (unsigned long long)stats.moves_n,
+           (unsigned long long)stats.invalid_games_n);
+    printf("%.3fs on %d threads, %.0f games/s, %.3f GB/s\n", secs, threads_n,
+           stats.games_n / secs, stats.bytes_n / secs * 1e-9);
+    print_stats(&stats, score_bucket_width);
+
+    free(ctx.thread_stats);
+    replay_archive_close(&archive);
+    return 0;
+}
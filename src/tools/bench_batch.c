@@ -0,0 +1,212 @@
+// times the batch kernels at every level the cpu supports against the plain
+// per board bitboard code, and checks that they all agree with it
+//
+// usage: bench_batch [boards] [repeats]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "game.h"
+#include "timing.h"
+
+typedef struct BenchData {
+    int boards_n;
+    Board* boards;
+    Board* placed;
+    PackedBlock* held_blocks;
+    Board* cleared;  // boards to run the clear kernel on
+    uint8_t* out;
+} BenchData;
+
+// random boards of varied density with a few full lines mixed in
+static Board get_random_board(Rng* rng) {
+    Board board = 0;
+    int density = rng_range(rng, 9);
+    for (int cell = 0; cell < FIELD_SIZE * FIELD_SIZE; ++cell) {
+        if ((int)rng_range(rng, 10) < density) board |= board_cell(cell);
+    }
+    if (rng_range(rng, 4) == 0) {
+        board |= BOARD_ROW_0 << (rng_range(rng, FIELD_SIZE) * FIELD_SIZE);
+    }
+    if (rng_range(rng, 4) == 0) board |= BOARD_COL_0 << rng_range(rng, 8);
+    return board;
+}
+
+// the per board reference, the same code the game runs. boards go in the
+// first color of a field for clear_field
+static int clear_scalar(Board* board) {
+    Board field[CELL_COLORS_N] = {*board};
+    int lines;
+    clear_field(field, 1, &lines, NULL);
+    *board = field[0];
+    return lines;
+}
+
+static Board get_scalar_legal(Board board, const PackedBlock* held) {
+    Board legal = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        Block block = unpack_block(held[slot]);
+        if (block.item == CELL_ITEM_EMPTY) continue;
+        legal |= get_legal_origins(board, get_block_mask(&block));
+    }
+    return legal;
+}
+
+static void run_scalar_path(BenchData* data, int repeats, double secs[3]) {
+    int n = data->boards_n;
+    double start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        for (int i = 0; i < n; ++i) {
+            data->out[i] = (data->boards[i] & data->placed[i]) == 0;
+        }
+    }
+    secs[0] = get_time_seconds() - start;
+
+    start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        memcpy(data->cleared, data->boards, sizeof(Board) * n);
+        for (int i = 0; i < n; ++i) {
+            data->out[i] = clear_scalar(&data->cleared[i]);
+        }
+    }
+    secs[1] = get_time_seconds() - start;
+
+    start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        for (int i = 0; i < n; ++i) {
+            const PackedBlock* held = &data->held_blocks[i * HELD_BLOCKS_N];
+            data->out[i] = get_scalar_legal(data->boards[i], held) == 0;
+        }
+    }
+    secs[2] = get_time_seconds() - start;
+}
+
+static void run_kernels(BenchData* data, int repeats, double secs[3]) {
+    int n = data->boards_n;
+    double start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        batch_placement_free(data->boards, data->placed, data->out, n);
+    }
+    secs[0] = get_time_seconds() - start;
+
+    start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        memcpy(data->cleared, data->boards, sizeof(Board) * n);
+        batch_clear_lines(data->cleared, data->out, n);
+    }
+    secs[1] = get_time_seconds() - start;
+
+    start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        batch_game_over(data->boards, data->held_blocks, data->out, n);
+    }
+    secs[2] = get_time_seconds() - start;
+}
+
+// returns the amount of boards a kernel got wrong
+static int check_kernels(BenchData* data) {
+    int n = data->boards_n;
+    int bad_n = 0;
+
+    batch_placement_free(data->boards, data->placed, data->out, n);
+    for (int i = 0; i < n; ++i) {
+        bad_n += data->out[i] != ((data->boards[i] & data->placed[i]) == 0);
+    }
+
+    memcpy(data->cleared, data->boards, sizeof(Board) * n);
+    batch_clear_lines(data->cleared, data->out, n);
+    for (int i = 0; i < n; ++i) {
+        Board board = data->boards[i];
+        int lines = clear_scalar(&board);
+        bad_n += data->out[i] != lines || data->cleared[i] != board;
+    }
+
+    batch_game_over(data->boards, data->held_blocks, data->out, n);
+    for (int i = 0; i < n; ++i) {
+        const PackedBlock* held = &data->held_blocks[i * HELD_BLOCKS_N];
+        bad_n += data->out[i] != (get_scalar_legal(data->boards[i], held) == 0);
+    }
+    return bad_n;
+}
+
+static void print_times(const char* name, const double secs[3],
+                        double boards) {
+    static const char* kernels[] = {"placement", "clear lines", "game over"};
+    for (int k = 0; k < 3; ++k) {
+        printf("%-10s %-12s %7.2f ns/board  %8.1fM boards/s\n", name,
+               kernels[k], secs[k] / boards * 1e9, boards / secs[k] * 1e-6);
+    }
+}
+
+int main(int argc, char** argv) {
+    int boards_n = argc > 1 ? atoi(argv[1]) : 4096;
+    int repeats = argc > 2 ? atoi(argv[2]) : 2000;
+    if (boards_n < 1 || repeats < 1) {
+        fprintf(stderr, "usage: %s [boards] [repeats]\n", argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    BenchData data = {
+        .boards_n = boards_n,
+        .boards = malloc(sizeof(Board) * boards_n),
+        .placed = malloc(sizeof(Board) * boards_n),
+        .held_blocks = malloc(sizeof(PackedBlock) * boards_n * HELD_BLOCKS_N),
+        .cleared = malloc(sizeof(Board) * boards_n),
+        .out = malloc(boards_n),
+    };
+    if (!data.boards || !data.placed || !data.held_blocks || !data.cleared ||
+        !data.out) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    Rng rng = make_rng(1);
+    for (int i = 0; i < boards_n; ++i) {
+        data.boards[i] = get_random_board(&rng);
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            Block block = get_random_block(&rng);
+            // some slots already used this turn
+            if (rng_range(&rng, 4) == 0) block.item = CELL_ITEM_EMPTY;
+            data.held_blocks[i * HELD_BLOCKS_N + slot] = pack_block(&block);
+        }
+        Block block = get_random_block(&rng);
+        const BlockMask* mask = get_block_mask(&block);
+        data.placed[i] = mask->cells << rng_range(&rng, 64 - 18);
+    }
+
+    double boards = (double)boards_n * repeats;
+    double secs[3];
+    run_scalar_path(&data, repeats, secs);
+    print_times("bitboard", secs, boards);
+
+    int failed = 0;
+    BatchKernelLevel best = init_batch_kernels(BATCH_KERNEL_AVX512);
+    for (BatchKernelLevel level = BATCH_KERNEL_SCALAR; level <= best;
+         ++level) {
+        set_batch_kernels(level);
+        const char* name = get_batch_kernel_name(level);
+        int bad_n = check_kernels(&data);
+        if (bad_n) {
+            fprintf(stderr, "%s kernels disagree on %d boards\n", name,
+                    bad_n);
+            failed = 1;
+        }
+        run_kernels(&data, repeats, secs);
+        print_times(name, secs, boards);
+    }
+    init_batch_kernels(BATCH_KERNEL_AVX512);
+    char kernels[128];
+    format_batch_kernels(kernels, sizeof(kernels));
+    printf("picked: %s\n", kernels);
+
+    free(data.out);
+    free(data.cleared);
+    free(data.held_blocks);
+    free(data.placed);
+    free(data.boards);
+    return failed;
+}
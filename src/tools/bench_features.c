@@ -0,0 +1,145 @@
+// times extract_features and checks it against plain loops over the cells
+//
+// usage: bench_features [boards] [repeats]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "block.h"
+#include "board_features.h"
+#include "timing.h"
+#include "vector_fns.h"
+
+static bool is_empty(Board occupied, int x, int y) {
+    if (x < 0 || y < 0 || x >= FIELD_SIZE || y >= FIELD_SIZE) return false;
+    return !board_test(occupied, y * FIELD_SIZE + x);
+}
+
+static void extract_features_slow(Board occupied, BoardFeatures* out) {
+    *out = (BoardFeatures){0};
+    for (int y = 0; y < FIELD_SIZE; ++y) {
+        for (int x = 0; x < FIELD_SIZE; ++x) {
+            if (!is_empty(occupied, x, y)) {
+                out->row_fill[y]++;
+                out->col_fill[x]++;
+                continue;
+            }
+            out->empty_n++;
+            out->holes_n += !is_empty(occupied, x - 1, y) &&
+                            !is_empty(occupied, x + 1, y) &&
+                            !is_empty(occupied, x, y - 1) &&
+                            !is_empty(occupied, x, y + 1);
+        }
+    }
+
+    for (int y0 = 0; y0 < FIELD_SIZE; ++y0) {
+        for (int x0 = 0; x0 < FIELD_SIZE; ++x0) {
+            for (int y1 = y0; y1 < FIELD_SIZE; ++y1) {
+                for (int x1 = x0; x1 < FIELD_SIZE; ++x1) {
+                    bool empty = true;
+                    for (int y = y0; y <= y1; ++y) {
+                        for (int x = x0; x <= x1; ++x) {
+                            empty &= is_empty(occupied, x, y);
+                        }
+                    }
+                    int area = (y1 - y0 + 1) * (x1 - x0 + 1);
+                    if (empty && area > out->largest_rect) {
+                        out->largest_rect = area;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int shape = 0; shape < get_shapes_n(); ++shape) {
+        int cells_n = get_shape_coords(shape).len;
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            Block block = make_block(CELL_ITEM_BLUE, shape, rotation);
+            // cells relative to the top left corner of the rotated shape
+            Vector2 corner = get_block_cell_coord(&block, 0);
+            for (int i = 1; i < cells_n; ++i) {
+                corner = Vector2Min(corner, get_block_cell_coord(&block, i));
+            }
+            bool fits = false;
+            for (int y = 0; y < FIELD_SIZE; ++y) {
+                for (int x = 0; x < FIELD_SIZE; ++x) {
+                    bool free = true;
+                    for (int i = 0; i < cells_n; ++i) {
+                        Vector2 cell = Vector2Round(Vector2Subtract(
+                            get_block_cell_coord(&block, i), corner));
+                        free &= is_empty(occupied, x + cell.x, y + cell.y);
+                    }
+                    fits |= free;
+                }
+            }
+            out->fitting_n += fits;
+        }
+    }
+}
+
+static bool same_features(const BoardFeatures* a, const BoardFeatures* b) {
+    bool same = a->empty_n == b->empty_n && a->holes_n == b->holes_n &&
+                a->largest_rect == b->largest_rect &&
+                a->fitting_n == b->fitting_n;
+    for (int i = 0; i < FIELD_SIZE; ++i) {
+        same &= a->row_fill[i] == b->row_fill[i] &&
+                a->col_fill[i] == b->col_fill[i];
+    }
+    return same;
+}
+
+int main(int argc, char** argv) {
+    int boards_n = argc > 1 ? atoi(argv[1]) : 4096;
+    int repeats = argc > 2 ? atoi(argv[2]) : 200;
+    if (boards_n < 1 || repeats < 1) {
+        fprintf(stderr, "usage: %s [boards] [repeats]\n", argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    Board* boards = malloc(sizeof(Board) * boards_n);
+    if (!boards) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    Rng rng = make_rng(1);
+    for (int i = 0; i < boards_n; ++i) {
+        int density = rng_range(&rng, 10);
+        boards[i] = 0;
+        for (int cell = 0; cell < FIELD_SIZE * FIELD_SIZE; ++cell) {
+            if ((int)rng_range(&rng, 10) < density) {
+                boards[i] |= board_cell(cell);
+            }
+        }
+    }
+
+    int bad_n = 0;
+    for (int i = 0; i < boards_n; ++i) {
+        BoardFeatures fast;
+        BoardFeatures slow;
+        extract_features(boards[i], &fast);
+        extract_features_slow(boards[i], &slow);
+        bad_n += !same_features(&fast, &slow);
+    }
+    if (bad_n) fprintf(stderr, "%d boards got wrong features\n", bad_n);
+
+    // summed so the calls can't be optimized out
+    unsigned sum = 0;
+    double start = get_time_seconds();
+    for (int r = 0; r < repeats; ++r) {
+        for (int i = 0; i < boards_n; ++i) {
+            BoardFeatures features;
+            extract_features(boards[i], &features);
+            sum += features.largest_rect + features.fitting_n +
+                   features.holes_n;
+        }
+    }
+    double secs = get_time_seconds() - start;
+
+    double calls = (double)boards_n * repeats;
+    printf("extract_features: %.1f ns/call (%u)\n", secs / calls * 1e9,
+           sum & 1);
+    free(boards);
+    return bad_n != 0;
+}
@@ -0,0 +1,137 @@
+// times the survival solver on turns from random games and on the widest
+// turns there are, and checks it against a plain search without the table
+//
+// usage: bench_survive [turns] [seed]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "survive.h"
+#include "timing.h"
+
+typedef struct Turn {
+    Board occupied;
+    PackedBlock held_blocks[HELD_BLOCKS_N];
+} Turn;
+
+static uint64_t count_lines_slow(Board occupied, const PackedBlock* held,
+                                 unsigned left) {
+    if (!left) return 1;
+    uint64_t lines_n = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        if (!(left & (1u << slot))) continue;
+        Block block = unpack_block(held[slot]);
+        const BlockMask* mask = get_block_mask(&block);
+        for (Board legal = get_legal_origins(occupied, mask); legal;
+             legal &= legal - 1) {
+            Board board = occupied | mask->cells << __builtin_ctzll(legal);
+            board &= ~board_lines_cells(board_full_rows(board),
+                                        board_full_cols(board));
+            lines_n += count_lines_slow(board, held, left & ~(1u << slot));
+        }
+    }
+    return lines_n;
+}
+
+// turn starts of random games, down to the one that ended each game
+static int collect_turns(Turn* turns, int turns_n, uint64_t seed) {
+    int n = 0;
+    while (n < turns_n) {
+        GameState state = make_gamestate(seed++);
+        Rng rng = make_rng(seed);
+        while (n < turns_n) {
+            if (state.blocks_placed == 0) {
+                turns[n].occupied = get_occupied_cells(&state);
+                for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+                    turns[n].held_blocks[slot] =
+                        pack_block(&state.held_blocks[slot]);
+                }
+                n++;
+            }
+            Move moves[MAX_MOVES_N];
+            int moves_n = get_legal_moves(&state, moves);
+            if (!moves_n) break;
+            apply_move(&state, moves[rng_range(&rng, moves_n)], NULL);
+        }
+    }
+    return n;
+}
+
+static void time_solver(SurviveSolver* solver, const char* name,
+                        const Turn* turns, int turns_n, bool count) {
+    uint64_t nodes_n = 0;
+    uint64_t survived_n = 0;
+    double worst = 0;
+    double start = get_time_seconds();
+    for (int i = 0; i < turns_n; ++i) {
+        double turn_start = get_time_seconds();
+        SurviveResult result;
+        if (count) {
+            survive_count_lines(solver, turns[i].occupied,
+                                turns[i].held_blocks, &result);
+        } else {
+            survive_check(solver, turns[i].occupied, turns[i].held_blocks,
+                          &result);
+        }
+        double secs = get_time_seconds() - turn_start;
+        if (secs > worst) worst = secs;
+        nodes_n += result.nodes_n;
+        survived_n += result.survives;
+    }
+    double secs = get_time_seconds() - start;
+    printf("%-22s %8.2f us/turn  worst %8.2f us  %6.1f nodes/turn  "
+           "%llu/%d survive\n",
+           name, secs / turns_n * 1e6, worst * 1e6,
+           (double)nodes_n / turns_n, (unsigned long long)survived_n,
+           turns_n);
+}
+
+int main(int argc, char** argv) {
+    int turns_n = argc > 1 ? atoi(argv[1]) : 10000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    if (turns_n < 1) {
+        fprintf(stderr, "usage: %s [turns] [seed]\n", argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    Turn* turns = malloc(sizeof(*turns) * turns_n);
+    SurviveSolver* solver = survive_solver_new();
+    if (!turns || !solver) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    turns_n = collect_turns(turns, turns_n, seed);
+
+    int bad_n = 0;
+    for (int i = 0; i < turns_n && i < 1000; ++i) {
+        uint64_t expected = count_lines_slow(
+            turns[i].occupied, turns[i].held_blocks, (1u << HELD_BLOCKS_N) - 1);
+        SurviveResult counted;
+        SurviveResult checked;
+        survive_count_lines(solver, turns[i].occupied, turns[i].held_blocks,
+                            &counted);
+        survive_check(solver, turns[i].occupied, turns[i].held_blocks,
+                      &checked);
+        bad_n += counted.lines_n != expected ||
+                 checked.survives != (expected > 0);
+    }
+    if (bad_n) fprintf(stderr, "%d turns solved wrong\n", bad_n);
+
+    time_solver(solver, "check, random games", turns, turns_n, false);
+    time_solver(solver, "count, random games", turns, turns_n, true);
+
+    // an empty field with three of the smallest blocks has the most lines
+    Block small = make_block(CELL_ITEM_BLUE, BLOCK_SHAPE_2x2, 0);
+    Turn widest = {0};
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        widest.held_blocks[slot] = pack_block(&small);
+    }
+    time_solver(solver, "check, empty field", &widest, 1, false);
+    time_solver(solver, "count, empty field", &widest, 1, true);
+
+    survive_solver_free(solver);
+    free(turns);
+    return bad_n != 0;
+}
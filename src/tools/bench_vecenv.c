@@ -0,0 +1,133 @@
+// steps a batched environment with random legal actions and reports how
+// many steps per second the environment itself manages. observations are
+// written into a shared memory segment, the way a trainer would map them,
+// either in the default layout or with every plane
+//
+// usage: bench_vecenv [envs] [steps per env] [scalar|avx2|avx512]
+//                     [default|planes] [random|bag]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shm.h"
+#include "timing.h"
+#include "vecenv.h"
+
+#define OBS_SHM_NAME "/bench_vecenv_obs"
+
+static int pick_random_action(const Board* legal, Rng* rng) {
+    int total = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        total += board_popcount(legal[slot]);
+    }
+    int k = rng_range(rng, total);
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        int n = board_popcount(legal[slot]);
+        if (k < n) {
+            Board board = legal[slot];
+            while (k--) board &= board - 1;
+            return slot * FIELD_SIZE * FIELD_SIZE + __builtin_ctzll(board);
+        }
+        k -= n;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int envs_n = argc > 1 ? atoi(argv[1]) : 1024;
+    int steps_n = argc > 2 ? atoi(argv[2]) : 1000;
+    BatchKernelLevel max_level = BATCH_KERNEL_AVX512;
+    if (argc > 3) {
+        if (strcmp(argv[3], "scalar") == 0) {
+            max_level = BATCH_KERNEL_SCALAR;
+        } else if (strcmp(argv[3], "avx2") == 0) {
+            max_level = BATCH_KERNEL_AVX2;
+        } else if (strcmp(argv[3], "avx512") != 0) {
+            envs_n = 0;
+        }
+    }
+    unsigned obs_sections = VECENV_DEFAULT_OBS;
+    if (argc > 4) {
+        if (strcmp(argv[4], "planes") == 0) {
+            obs_sections = OBS_OCCUPANCY | OBS_COLORS | OBS_HELD_PLANES |
+                           OBS_LEGAL | OBS_HELD_CODES;
+        } else if (strcmp(argv[4], "default") != 0) {
+            envs_n = 0;
+        }
+    }
+    DealMode deal_mode = DEAL_MODE_RANDOM;
+    if (argc > 5 && !parse_deal_mode(argv[5], &deal_mode)) envs_n = 0;
+    if (envs_n < 1 || steps_n < 1) {
+        fprintf(stderr,
+                "usage: %s [envs] [steps per env] [scalar|avx2|avx512] "
+                "[default|planes] [random|bag]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+    init_batch_kernels(max_level);
+
+    VecEnv env;
+    if (!vecenv_init(&env, envs_n, 1)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    vecenv_set_obs_layout(&env, obs_sections);
+    if (deal_mode != DEAL_MODE_RANDOM) {
+        vecenv_set_deal_mode(&env, deal_mode);
+        vecenv_reset(&env, NULL);
+    }
+    SharedBuffer obs_buffer;
+    if (!shared_buffer_create(&obs_buffer, OBS_SHM_NAME,
+                              (size_t)envs_n * env.obs_layout.size)) {
+        fprintf(stderr, "can't create shared memory %s\n", OBS_SHM_NAME);
+        return 1;
+    }
+    uint8_t* obs = obs_buffer.data;
+    int32_t* actions = malloc(sizeof(*actions) * envs_n);
+    float* rewards = malloc(sizeof(*rewards) * envs_n);
+    uint8_t* dones = malloc(envs_n);
+    Board* legal = malloc(sizeof(*legal) * envs_n * HELD_BLOCKS_N);
+    Rng rng = make_rng(2);
+
+    double step_secs = 0;
+    uint64_t games_n = 0;
+    double start = get_time_seconds();
+    for (int step = 0; step < steps_n; ++step) {
+        vecenv_legal_moves(&env, legal);
+        for (int i = 0; i < envs_n; ++i) {
+            actions[i] = pick_random_action(&legal[i * HELD_BLOCKS_N], &rng);
+        }
+
+        double step_start = get_time_seconds();
+        vecenv_step(&env, actions, rewards, dones, obs);
+        step_secs += get_time_seconds() - step_start;
+
+        for (int i = 0; i < envs_n; ++i) games_n += dones[i];
+    }
+    double secs = get_time_seconds() - start;
+
+    double steps = (double)envs_n * steps_n;
+    char kernels[128];
+    format_batch_kernels(kernels, sizeof(kernels));
+    printf("%d envs x %d steps, %llu games finished, %s deals\n", envs_n,
+           steps_n, (unsigned long long)games_n,
+           get_deal_mode_name(deal_mode));
+    printf("kernels: %s\n", kernels);
+    printf("vecenv_step: %.2fM steps/s (%.1f ns/step)\n",
+           steps / step_secs * 1e-6, step_secs / steps * 1e9);
+    printf("observations: %zu bytes per game\n", env.obs_layout.size);
+    printf("with legal masks and action picking: %.2fM steps/s\n",
+           steps / secs * 1e-6);
+
+    free(legal);
+    shared_buffer_close(&obs_buffer);
+    shared_buffer_unlink(OBS_SHM_NAME);
+    free(dones);
+    free(rewards);
+    free(actions);
+    vecenv_free(&env);
+    return 0;
+}
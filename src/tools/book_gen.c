@@ -0,0 +1,182 @@
+// builds an opening book with the search engine. the first turn is covered
+// for every deal, later turns for the positions that come up in games
+// played by the search from the first seeds, one turn at a time so every
+// layer of games can already play the turns before it from the book
+//
+// usage: book_gen <book> [turns] [games] [threads]
+
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "book.h"
+#include "parallel.h"
+#include "policy.h"
+#include "search.h"
+#include "timing.h"
+
+typedef struct BookGenCtx {
+    BookEntry* entries;  // the positions to search, or the turn starts
+    uint64_t entries_n;
+    int turn;  // of the games to play
+    _Atomic uint64_t next;
+    _Atomic uint64_t nodes_n;
+} BookGenCtx;
+
+static void search_thread(void* arg, int thread_index, int threads_n) {
+    (void)thread_index;
+    (void)threads_n;
+    BookGenCtx* ctx = arg;
+    for (;;) {
+        uint64_t i = atomic_fetch_add(&ctx->next, 1);
+        if (i >= ctx->entries_n) break;
+
+        BookEntry* entry = &ctx->entries[i];
+        GameState state = book_key_state(entry->occupied, entry->held);
+        SearchResult result;
+        search_turn(&state, &result);
+        entry->moves_n = result.moves_n;
+        for (int m = 0; m < result.moves_n; ++m) {
+            entry->moves[m] = result.moves[m];
+        }
+        atomic_fetch_add(&ctx->nodes_n, result.nodes_n);
+    }
+}
+
+// plays game i up to the start of ctx->turn and keys the position there,
+// games that end before it leave moves_n at HELD_BLOCKS_N + 1
+static void play_thread(void* arg, int thread_index, int threads_n) {
+    (void)thread_index;
+    (void)threads_n;
+    BookGenCtx* ctx = arg;
+    for (;;) {
+        uint64_t i = atomic_fetch_add(&ctx->next, 1);
+        if (i >= ctx->entries_n) break;
+
+        BookEntry* entry = &ctx->entries[i];
+        *entry = (BookEntry){.moves_n = HELD_BLOCKS_N + 1};
+        GameState state = make_gamestate(i);
+        Rng rng = make_rng(i);
+        bool alive = true;
+        for (int turn = 0; turn < ctx->turn && alive; ++turn) {
+            alive = play_turn(POLICY_SEARCH, &state, &rng, NULL, NULL);
+        }
+        BookKey key;
+        if (alive && book_key(&state, &key)) {
+            *entry = (BookEntry){.occupied = key.occupied, .held = key.held};
+        }
+    }
+}
+
+// every deal on the empty field
+static uint64_t get_first_turns(BookEntry* entries) {
+    int codes_n = get_shapes_n() * 4;
+    uint64_t n = 0;
+    GameState state = make_gamestate(0);
+    for (int a = 0; a < codes_n; ++a) {
+        for (int b = 0; b < codes_n; ++b) {
+            for (int c = 0; c < codes_n; ++c) {
+                int codes[HELD_BLOCKS_N] = {a, b, c};
+                for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+                    state.held_blocks[slot] = make_block(
+                        CELL_ITEM_BLUE, codes[slot] / 4, codes[slot] % 4);
+                }
+                BookKey key;
+                book_key(&state, &key);
+                entries[n++] =
+                    (BookEntry){.occupied = key.occupied, .held = key.held};
+            }
+        }
+    }
+    return n;
+}
+
+// drops the games that ended and the positions already in the book
+static uint64_t drop_known(BookEntry* entries, uint64_t entries_n,
+                           const OpeningBook* book) {
+    uint64_t n = 0;
+    for (uint64_t i = 0; i < entries_n; ++i) {
+        if (entries[i].moves_n > HELD_BLOCKS_N) continue;
+        if (book_find(book, entries[i].occupied, entries[i].held)) continue;
+        entries[n++] = entries[i];
+    }
+    return n;
+}
+
+static void search_entries(BookGenCtx* ctx, int threads_n, int turn) {
+    atomic_store(&ctx->next, 0);
+    atomic_store(&ctx->nodes_n, 0);
+    double start = get_time_seconds();
+    if (!parallel_run(threads_n, search_thread, ctx)) {
+        search_thread(ctx, 0, 1);
+    }
+    double secs = get_time_seconds() - start;
+    printf("turn %d: %llu positions searched in %.2fs, %.0f nodes/position\n",
+           turn + 1, (unsigned long long)ctx->entries_n, secs,
+           ctx->entries_n ? (double)atomic_load(&ctx->nodes_n) /
+                                ctx->entries_n
+                          : 0.0);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <book> [turns] [games] [threads]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    int turns_n = argc > 2 ? atoi(argv[2]) : 1;
+    uint64_t games_n = argc > 3 ? strtoull(argv[3], NULL, 10) : 10000;
+    int threads_n = argc > 4 ? atoi(argv[4]) : parallel_default_threads();
+    if (threads_n < 1) threads_n = 1;
+    if (turns_n < 1) turns_n = 1;
+
+    uint64_t codes_n = get_shapes_n() * 4;
+    uint64_t first_n = codes_n * codes_n * codes_n;
+    uint64_t cap = first_n + games_n * (turns_n - 1);
+    BookEntry* entries = malloc(sizeof(*entries) * cap);
+    BookEntry* layer = malloc(sizeof(*layer) * (games_n ? games_n : 1));
+    if (!entries || !layer) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    BookGenCtx ctx = {.entries = entries};
+    ctx.entries_n = book_sort_entries(entries, get_first_turns(entries));
+    search_entries(&ctx, threads_n, 0);
+    uint64_t entries_n = ctx.entries_n;
+
+    // the book so far, searched positions are sorted already
+    OpeningBook book = {.entries = entries, .entries_n = entries_n};
+    set_policy_book(&book);
+    for (int turn = 1; turn < turns_n; ++turn) {
+        ctx = (BookGenCtx){.entries = layer, .entries_n = games_n,
+                           .turn = turn};
+        if (!parallel_run(threads_n, play_thread, &ctx)) {
+            play_thread(&ctx, 0, 1);
+        }
+
+        ctx.entries_n = book_sort_entries(layer, games_n);
+        ctx.entries_n = drop_known(layer, ctx.entries_n, &book);
+        search_entries(&ctx, threads_n, turn);
+
+        for (uint64_t i = 0; i < ctx.entries_n; ++i) {
+            entries[entries_n++] = layer[i];
+        }
+        entries_n = book_sort_entries(entries, entries_n);
+        book.entries_n = entries_n;
+    }
+    set_policy_book(NULL);
+
+    if (!book_write(argv[1], entries, entries_n)) {
+        fprintf(stderr, "failed to write %s\n", argv[1]);
+        return 1;
+    }
+    printf("%llu positions, %.1f KiB\n", (unsigned long long)entries_n,
+           (sizeof(BookHeader) + sizeof(*entries) * entries_n) / 1024.0);
+    free(layer);
+    free(entries);
+    return 0;
+}
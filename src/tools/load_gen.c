@@ -0,0 +1,249 @@
+// drives a running serve with clients that each play many sessions, every
+// session one request in flight, and reports the request rate and latency
+// percentiles
+//
+// usage: load_gen <socket path> [clients] [sessions per client] [seconds]
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "block.h"
+#include "parallel.h"
+#include "rng.h"
+#include "server.h"
+#include "stats.h"
+#include "timing.h"
+
+// a client writes one request per session before it reads any reply, the
+// socket buffers have to hold them
+#define LOAD_GEN_SESSIONS_MAX 1024
+// every this many requests of a session is a get state instead of a move
+#define LOAD_GEN_GET_EVERY 8
+
+typedef struct LoadGenCtx {
+    const char* path;
+    int sessions_n;
+    double seconds;
+    LatencyHistogram* histograms;  // one per client
+    uint64_t* games_n;             // finished per client
+    uint64_t* errors_n;            // unexpected replies per client
+    _Atomic bool failed;
+} LoadGenCtx;
+
+typedef struct ClientSession {
+    ServerReply last;  // the latest state
+    uint64_t requests_n;
+} ClientSession;
+
+static int connect_to(const char* path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) return -1;
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    while (size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+// a random legal move of the session, false if it has none
+static bool pick_move(const ServerReply* state, Rng* rng,
+                      ServerRequest* request_out) {
+    Board occupied = 0;
+    for (int i = 0; i < CELL_COLORS_N; ++i) occupied |= state->field[i];
+    Board legal[HELD_BLOCKS_N] = {0};
+    int moves_n = 0;
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        Block block = unpack_block(state->held_blocks[slot]);
+        if (block.item == CELL_ITEM_EMPTY) continue;
+        legal[slot] = get_legal_origins(occupied, get_block_mask(&block));
+        moves_n += board_popcount(legal[slot]);
+    }
+    if (moves_n == 0) return false;
+
+    int pick = rng_range(rng, moves_n);
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        int slot_moves_n = board_popcount(legal[slot]);
+        if (pick >= slot_moves_n) {
+            pick -= slot_moves_n;
+            continue;
+        }
+        Board moves = legal[slot];
+        for (int i = 0; i < pick; ++i) moves &= moves - 1;
+        request_out->kind = SERVER_REQUEST_PLACE;
+        request_out->slot = slot;
+        request_out->cell = __builtin_ctzll(moves);
+        break;
+    }
+    return true;
+}
+
+// the next request of a session: a new game once the last one is over,
+// otherwise a move or now and then a get state
+static ServerRequest next_request(ClientSession* session, Rng* rng,
+                                  uint64_t seed) {
+    ServerRequest request = {.session = session->last.session, .seed = seed};
+    if (session->last.kind == SERVER_REQUEST_END_GAME) {
+        request.kind = SERVER_REQUEST_NEW_GAME;
+    } else if (session->last.game_over) {
+        request.kind = SERVER_REQUEST_END_GAME;
+    } else if (session->requests_n % LOAD_GEN_GET_EVERY == 0 ||
+               !pick_move(&session->last, rng, &request)) {
+        request.kind = SERVER_REQUEST_GET_STATE;
+    }
+    session->requests_n++;
+    return request;
+}
+
+static void client_thread(void* arg, int client, int clients_n) {
+    (void)clients_n;
+    LoadGenCtx* ctx = arg;
+    int sessions_n = ctx->sessions_n;
+    int fd = connect_to(ctx->path);
+    ClientSession* sessions = calloc(sessions_n, sizeof(*sessions));
+    ServerRequest* requests = malloc(sizeof(*requests) * sessions_n);
+    ServerReply* replies = malloc(sizeof(*replies) * sessions_n);
+    if (fd < 0 || !sessions || !requests || !replies) {
+        atomic_store(&ctx->failed, true);
+        goto done;
+    }
+
+    LatencyHistogram* histogram = &ctx->histograms[client];
+    Rng rng = make_rng((uint64_t)client << 32);
+    uint64_t next_seed = (uint64_t)client << 32;
+    // every session starts as if its previous game just ended
+    for (int i = 0; i < sessions_n; ++i) {
+        sessions[i].last.kind = SERVER_REQUEST_END_GAME;
+    }
+
+    double end = get_time_seconds() + ctx->seconds;
+    while (get_time_seconds() < end) {
+        for (int i = 0; i < sessions_n; ++i) {
+            requests[i] = next_request(&sessions[i], &rng, next_seed++);
+        }
+        double sent = get_time_seconds();
+        if (!write_all(fd, requests, sizeof(*requests) * sessions_n)) {
+            atomic_store(&ctx->failed, true);
+            break;
+        }
+
+        // every reply is timed from the write to the read it completed in
+        size_t size = sizeof(*replies) * sessions_n;
+        size_t read_n = 0;
+        while (read_n < size) {
+            ssize_t n = read(fd, (uint8_t*)replies + read_n, size - read_n);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            uint64_t nanoseconds = (get_time_seconds() - sent) * 1e9;
+            size_t done_n = read_n / sizeof(*replies);
+            read_n += n;
+            for (size_t i = done_n; i < read_n / sizeof(*replies); ++i) {
+                latency_histogram_add(histogram, nanoseconds);
+            }
+        }
+        if (read_n < size) {
+            atomic_store(&ctx->failed, true);
+            break;
+        }
+
+        for (int i = 0; i < sessions_n; ++i) {
+            if (replies[i].status != SERVER_STATUS_OK) {
+                ctx->errors_n[client]++;
+                continue;
+            }
+            if (replies[i].kind == SERVER_REQUEST_END_GAME) {
+                ctx->games_n[client]++;
+            }
+            sessions[i].last = replies[i];
+        }
+    }
+
+done:
+    if (fd >= 0) close(fd);
+    free(sessions);
+    free(requests);
+    free(replies);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "usage: %s <socket path> [clients] [sessions per client] "
+                "[seconds]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+    int clients_n = argc > 2 ? atoi(argv[2]) : 4;
+    LoadGenCtx ctx = {
+        .path = argv[1],
+        .sessions_n = argc > 3 ? atoi(argv[3]) : 64,
+        .seconds = argc > 4 ? atof(argv[4]) : 5,
+    };
+    if (clients_n < 1) clients_n = 1;
+    if (ctx.sessions_n < 1) ctx.sessions_n = 1;
+    if (ctx.sessions_n > LOAD_GEN_SESSIONS_MAX) {
+        ctx.sessions_n = LOAD_GEN_SESSIONS_MAX;
+    }
+    ctx.histograms = calloc(clients_n, sizeof(*ctx.histograms));
+    ctx.games_n = calloc(clients_n, sizeof(*ctx.games_n));
+    ctx.errors_n = calloc(clients_n, sizeof(*ctx.errors_n));
+    if (!ctx.histograms || !ctx.games_n || !ctx.errors_n) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    double start = get_time_seconds();
+    if (!parallel_run(clients_n, client_thread, &ctx)) {
+        fprintf(stderr, "failed to start %d clients\n", clients_n);
+        return 1;
+    }
+    double secs = get_time_seconds() - start;
+    if (atomic_load(&ctx.failed)) {
+        fprintf(stderr, "lost the connection to %s\n", argv[1]);
+        return 1;
+    }
+
+    LatencyHistogram total = {0};
+    uint64_t games_n = 0;
+    uint64_t errors_n = 0;
+    for (int i = 0; i < clients_n; ++i) {
+        latency_histogram_merge(&total, &ctx.histograms[i]);
+        games_n += ctx.games_n[i];
+        errors_n += ctx.errors_n[i];
+    }
+    printf("%d clients x %d sessions, %llu requests in %.2fs "
+           "(%.0f requests/s), %llu games, %llu errors\n",
+           clients_n, ctx.sessions_n, (unsigned long long)total.n, secs,
+           total.n / secs, (unsigned long long)games_n,
+           (unsigned long long)errors_n);
+    printf("latency p50 %.1fus, p99 %.1fus, p99.9 %.1fus, max %.1fus\n",
+           latency_histogram_quantile(&total, 0.5) * 1e-3,
+           latency_histogram_quantile(&total, 0.99) * 1e-3,
+           latency_histogram_quantile(&total, 0.999) * 1e-3,
+           total.max * 1e-3);
+    free(ctx.histograms);
+    free(ctx.games_n);
+    free(ctx.errors_n);
+    return 0;
+}
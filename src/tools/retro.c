@@ -0,0 +1,97 @@
+// solves a small field exactly and exports the survival chance of every
+// reachable turn start under perfect play. the horizon grows a turn at a
+// time until the values stop changing or max turns is reached
+//
+// usage: retro <size> <out> [max turns] [threads] [table bits] [ram MiB]
+//              [spill dir]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "block.h"
+#include "retro.h"
+#include "timing.h"
+
+#define RETRO_CONVERGED 1e-6
+
+static void print_stats(const RetroSolver* solver) {
+    static const char* phase_names[RETRO_PHASES_N] = {
+        "turn starts", "one block placed", "two blocks placed"};
+    RetroStats stats;
+    retro_get_stats(solver, &stats);
+    for (int phase = 0; phase < RETRO_PHASES_N; ++phase) {
+        printf("  %-18s %12llu boards %10.1f MiB %s\n", phase_names[phase],
+               (unsigned long long)stats.boards_n[phase],
+               stats.table_bytes[phase] / (1024.0 * 1024.0),
+               stats.on_disk[phase] ? "on disk" : "in memory");
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr,
+                "usage: %s <size> <out> [max turns] [threads] [table bits] "
+                "[ram MiB] [spill dir]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    int size = atoi(argv[1]);
+    int max_turns_n = argc > 3 ? atoi(argv[3]) : 20;
+    RetroParams params = make_retro_params(size);
+    if (argc > 4) params.threads_n = atoi(argv[4]);
+    if (argc > 5) params.table_bits = atoi(argv[5]);
+    if (argc > 6) params.ram_budget = strtoull(argv[6], NULL, 10) << 20;
+    if (argc > 7) params.spill_dir = argv[7];
+    if (params.threads_n < 1) params.threads_n = 1;
+
+    RetroSolver* solver = retro_solver_new(&params);
+    if (!solver) {
+        fprintf(stderr, "failed to make the tables, sizes go from %d to %d\n",
+                RETRO_SIZE_MIN, RETRO_SIZE_MAX);
+        return 1;
+    }
+
+    double start = get_time_seconds();
+    if (!retro_enumerate(solver)) {
+        fprintf(stderr, "a table overflowed, raise the table bits\n");
+        retro_solver_free(solver);
+        return 1;
+    }
+    double secs = get_time_seconds() - start;
+    RetroStats stats;
+    retro_get_stats(solver, &stats);
+    uint64_t boards_n = 0;
+    for (int phase = 0; phase < RETRO_PHASES_N; ++phase) {
+        boards_n += stats.boards_n[phase];
+    }
+    printf("%dx%d field, %d threads, enumerated in %.2fs (%.0f states/s)\n",
+           size, size, params.threads_n, secs, boards_n / secs);
+    print_stats(solver);
+
+    printf("\n turns  empty field  largest change   states/s\n");
+    for (int turn = 0; turn < max_turns_n; ++turn) {
+        double turn_start = get_time_seconds();
+        double change = retro_iterate(solver);
+        if (change < 0) {
+            fprintf(stderr, "out of memory\n");
+            retro_solver_free(solver);
+            return 1;
+        }
+        double turn_secs = get_time_seconds() - turn_start;
+        printf("%6d %12.6f %15.2e %10.0f\n", turn + 1, retro_value(solver, 0),
+               change, boards_n / turn_secs);
+        if (change < RETRO_CONVERGED) break;
+    }
+    printf("%.2fs in total\n", get_time_seconds() - start);
+
+    bool ok = retro_export(solver, argv[2]);
+    retro_solver_free(solver);
+    if (!ok) {
+        fprintf(stderr, "failed to write %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+// keeps a leaderboard log
+//
+// usage: scores add <log> <replay archive> [capacity]
+//        scores top <log> [k] [from rank] [capacity]
+//        scores compact <log> [capacity]
+//        scores bench <log> [games] [capacity]
+//
+// add logs every game of a replay archive with its offset in it. bench
+// adds random games to a fresh log while a reader thread polls the top
+
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "block.h"
+#include "parallel.h"
+#include "replay.h"
+#include "rng.h"
+#include "scores.h"
+#include "stats.h"
+#include "timing.h"
+
+#define SCORES_CAPACITY (1 << 20)
+#define PAGE_MAX 1000
+
+typedef struct BenchCtx {
+    ScoreStore* store;
+    uint64_t games_n;
+    double add_seconds;
+    _Atomic bool done;
+    uint64_t reads_n;
+    LatencyHistogram read_latency;  // nanoseconds
+} BenchCtx;
+
+static int add_archive(ScoreStore* store, const char* path) {
+    ReplayArchive archive;
+    if (!replay_archive_open(&archive, path)) {
+        fprintf(stderr, "failed to open %s\n", path);
+        return 1;
+    }
+    int64_t now = (int64_t)time(NULL);
+    double start = get_time_seconds();
+    for (uint64_t i = 0; i < archive.games_n; ++i) {
+        const ReplayIndexEntry* entry = replay_game(&archive, i);
+        scores_add(store, entry->score, entry->seed, entry->offset, now);
+    }
+    double secs = get_time_seconds() - start;
+    printf("added %llu games in %.3fs\n", (unsigned long long)archive.games_n,
+           secs);
+    replay_archive_close(&archive);
+    return scores_flush(store) ? 0 : 1;
+}
+
+static void print_records(const ScoreRecord* records, uint32_t n,
+                          uint64_t rank) {
+    for (uint32_t i = 0; i < n; ++i) {
+        const ScoreRecord* record = &records[i];
+        printf("%6llu %8d  seed %016llx", (unsigned long long)(rank + i),
+               record->score, (unsigned long long)record->seed);
+        if (record->replay_offset != SCORES_NO_REPLAY) {
+            printf("  replay @%llu",
+                   (unsigned long long)record->replay_offset);
+        }
+        time_t timestamp = (time_t)record->timestamp;
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&timestamp));
+        printf("  %s\n", date);
+    }
+}
+
+static void bench_thread(void* arg, int thread_index, int threads_n) {
+    (void)threads_n;
+    BenchCtx* ctx = arg;
+    ScoreRecord top[SCORES_TOP_MAX];
+    if (thread_index > 0) {
+        // the reader, it never takes the writers' lock
+        while (!atomic_load(&ctx->done)) {
+            double start = get_time_seconds();
+            scores_read_top(ctx->store, top, 10);
+            latency_histogram_add(&ctx->read_latency,
+                                  (get_time_seconds() - start) * 1e9);
+            ctx->reads_n++;
+        }
+        return;
+    }
+    Rng rng = make_rng((uint64_t)time(NULL));
+    double start = get_time_seconds();
+    for (uint64_t i = 0; i < ctx->games_n; ++i) {
+        // roughly how scores of random play spread
+        int32_t score = (int32_t)(rng_next(&rng) % 4096) *
+                        (int32_t)(1 + rng_next(&rng) % 16);
+        scores_add(ctx->store, score, rng_next(&rng), SCORES_NO_REPLAY,
+                   (int64_t)time(NULL));
+    }
+    ctx->add_seconds = get_time_seconds() - start;
+    atomic_store(&ctx->done, true);
+}
+
+static int bench(const char* path, uint64_t games_n, uint32_t capacity) {
+    remove(path);
+    ScoreStore* store = malloc(sizeof(*store));
+    BenchCtx* ctx = calloc(1, sizeof(*ctx));
+    if (!store || !ctx || !scores_open(store, path, capacity)) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return 1;
+    }
+    ctx->store = store;
+    ctx->games_n = games_n;
+    // the reader has to run alongside the writer
+    if (!parallel_run(2, bench_thread, ctx)) {
+        fprintf(stderr, "failed to start the reader\n");
+        return 1;
+    }
+    printf("%llu games in %.3fs (%.0f ns/add), %u indexed\n",
+           (unsigned long long)games_n, ctx->add_seconds,
+           ctx->add_seconds * 1e9 / games_n, scores_read_entries_n(store));
+    printf("%llu top 10 reads meanwhile, p50 %llu ns, p99 %llu ns\n",
+           (unsigned long long)ctx->reads_n,
+           (unsigned long long)latency_histogram_quantile(&ctx->read_latency,
+                                                          0.5),
+           (unsigned long long)latency_histogram_quantile(&ctx->read_latency,
+                                                          0.99));
+
+    ScoreRecord page[PAGE_MAX];
+    double start = get_time_seconds();
+    uint32_t page_n = scores_get_page(store, capacity / 2 + 1, page, PAGE_MAX);
+    printf("%u games from rank %u in %.1f us\n", page_n, capacity / 2 + 1,
+           (get_time_seconds() - start) * 1e6);
+
+    start = get_time_seconds();
+    bool flushed = scores_flush(store);
+    printf("flushed in %.1f ms\n", (get_time_seconds() - start) * 1e3);
+    if (scores_should_compact(store)) {
+        start = get_time_seconds();
+        bool compacted = scores_compact(store);
+        printf("%s in %.1f ms\n",
+               compacted ? "compacted" : "failed to compact",
+               (get_time_seconds() - start) * 1e3);
+    }
+    scores_close(store);
+
+    start = get_time_seconds();
+    if (!scores_open(store, path, capacity)) return 1;
+    printf("reopened %u games in %.1f ms\n", scores_read_entries_n(store),
+           (get_time_seconds() - start) * 1e3);
+    scores_close(store);
+    free(store);
+    free(ctx);
+    return flushed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr,
+                "usage: %s add <log> <replay archive> [capacity]\n"
+                "       %s top <log> [k] [from rank] [capacity]\n"
+                "       %s compact <log> [capacity]\n"
+                "       %s bench <log> [games] [capacity]\n",
+                argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    const char* command = argv[1];
+    const char* path = argv[2];
+    // logs and archives only open under the shape set of their games
+    if (!init_block_masks()) return 1;
+
+    if (strcmp(command, "bench") == 0) {
+        uint64_t games_n = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+        int capacity = argc > 4 ? atoi(argv[4]) : SCORES_CAPACITY;
+        if (games_n < 1 || capacity < 1) return 1;
+        return bench(path, games_n, capacity);
+    }
+
+    int capacity_arg = strcmp(command, "add") == 0   ? 4
+                       : strcmp(command, "top") == 0 ? 5
+                                                     : 3;
+    int capacity =
+        argc > capacity_arg ? atoi(argv[capacity_arg]) : SCORES_CAPACITY;
+    if (capacity < 1) return 1;
+    ScoreStore* store = malloc(sizeof(*store));
+    if (!store || !scores_open(store, path, capacity)) {
+        fprintf(stderr, "failed to open %s\n", path);
+        return 1;
+    }
+    if (store->truncated_bytes > 0) {
+        printf("cut %llu bytes of a torn record off the log\n",
+               (unsigned long long)store->truncated_bytes);
+    }
+
+    int result = 0;
+    if (strcmp(command, "add") == 0 && argc > 3) {
+        result = add_archive(store, argv[3]);
+    } else if (strcmp(command, "top") == 0) {
+        int k = argc > 3 ? atoi(argv[3]) : 10;
+        long long rank = argc > 4 ? atoll(argv[4]) : 1;
+        if (k < 1 || k > PAGE_MAX || rank < 1) {
+            fprintf(stderr, "k must be from 1 to %d, the rank at least 1\n",
+                    PAGE_MAX);
+            result = 1;
+        } else {
+            ScoreRecord page[PAGE_MAX];
+            uint32_t n = scores_get_page(store, rank, page, k);
+            print_records(page, n, rank);
+            printf("%u games indexed, %llu in the log\n",
+                   scores_read_entries_n(store),
+                   (unsigned long long)store->records_n);
+        }
+    } else if (strcmp(command, "compact") == 0) {
+        uint64_t records_n = store->records_n;
+        if (scores_compact(store)) {
+            printf("%llu records compacted to %llu\n",
+                   (unsigned long long)records_n,
+                   (unsigned long long)store->records_n);
+        } else {
+            fprintf(stderr, "failed to compact %s\n", path);
+            result = 1;
+        }
+    } else {
+        fprintf(stderr, "unknown command %s\n", command);
+        result = 1;
+    }
+    scores_close(store);
+    free(store);
+    return result;
+}
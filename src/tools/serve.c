@@ -0,0 +1,130 @@
+// serves game sessions on a unix domain socket until interrupted, printing
+// the request rate every second
+//
+// usage: serve <socket path> [loops] [scores log]
+//
+// with a scores log every ended session goes on its leaderboard. the loops
+// queue ended games, this thread adds them every tenth of a second and
+// flushes the log every second, compacting it when it's worth it. metrics
+// are exported to the file named by RM_METRICS_FILE if it's set
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "block.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "scores.h"
+#include "server.h"
+#include "timing.h"
+
+#define SCORES_CAPACITY (1 << 20)
+#define DRAIN_INTERVAL 100000  // microseconds
+#define DRAINS_PER_REPORT 10
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_signal(int signal) {
+    (void)signal;
+    interrupted = 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <socket path> [loops] [scores log]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+    int loops_n = argc > 2 ? atoi(argv[2]) : parallel_default_threads();
+    if (loops_n < 1) loops_n = 1;
+    if (loops_n > SERVER_LOOPS_MAX) loops_n = SERVER_LOOPS_MAX;
+
+    Server server;
+    if (!server_open(&server, argv[1], loops_n)) {
+        fprintf(stderr, "failed to serve on %s: %s\n", argv[1],
+                strerror(errno));
+        return 1;
+    }
+    ScoreStore* scores = NULL;
+    if (argc > 3) {
+        scores = malloc(sizeof(*scores));
+        if (!scores || !scores_open(scores, argv[3], SCORES_CAPACITY)) {
+            fprintf(stderr, "failed to open %s\n", argv[3]);
+            server_close(&server);
+            return 1;
+        }
+        server.scores = scores;
+    }
+    struct sigaction action = {.sa_handler = on_signal};
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    if (!server_start(&server)) {
+        fprintf(stderr, "failed to start the loops\n");
+        server_close(&server);
+        return 1;
+    }
+    MetricsExporter metrics_exporter;
+    bool exporting = metrics_exporter_start_from_env(&metrics_exporter);
+    printf("serving on %s with %d loops\n", argv[1], loops_n);
+    fflush(stdout);
+
+    double start = get_time_seconds();
+    double last_time = start;
+    uint64_t last_requests_n = 0;
+    int drains_n = 0;
+    while (!interrupted) {
+        // a signal cuts the sleep short
+        usleep(DRAIN_INTERVAL);
+        server_drain_scores(&server);
+        if (++drains_n < DRAINS_PER_REPORT) continue;
+        drains_n = 0;
+
+        ServerStats stats = get_server_stats(&server);
+        double now = get_time_seconds();
+        if (stats.requests_n != last_requests_n) {
+            printf("%.0f requests/s, %u connections, %u sessions\n",
+                   (stats.requests_n - last_requests_n) / (now - last_time),
+                   stats.connections_n, stats.sessions_n);
+            fflush(stdout);
+        }
+        last_requests_n = stats.requests_n;
+        last_time = now;
+        if (scores) {
+            if (!scores_flush(scores)) {
+                fprintf(stderr, "failed to write %s\n", argv[3]);
+            }
+            if (scores_should_compact(scores)) scores_compact(scores);
+        }
+    }
+
+    server_stop(&server);
+    server_join(&server);
+    server_drain_scores(&server);
+    ServerStats stats = get_server_stats(&server);
+    double secs = get_time_seconds() - start;
+    printf("%llu requests in %.1fs (%.0f requests/s)\n",
+           (unsigned long long)stats.requests_n, secs,
+           stats.requests_n / secs);
+    if (stats.games_dropped_n > 0) {
+        printf("%llu games missed the leaderboard\n",
+               (unsigned long long)stats.games_dropped_n);
+    }
+    server_close(&server);
+    if (exporting) metrics_exporter_stop(&metrics_exporter);
+    if (scores) {
+        ScoreRecord best;
+        if (scores_read_top(scores, &best, 1) == 1) {
+            printf("%u games on the leaderboard, the best scored %d\n",
+                   scores_read_entries_n(scores), best.score);
+        }
+        scores_close(scores);
+        free(scores);
+    }
+    return 0;
+}
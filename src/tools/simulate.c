@@ -0,0 +1,232 @@
+// plays games headlessly on all cores and writes them to a replay archive
+//
+// usage: simulate <archive> <games> [threads] [first seed] [random|search]
+//                 [opening book]
+//
+// the policy may also be plugin:<path>[:<args>], which plays the games of a
+// thread in lockstep batches. metrics are exported to the file named by
+// RM_METRICS_FILE if it's set
+
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "plugin.h"
+#include "policy.h"
+#include "replay.h"
+#include "rng.h"
+#include "timing.h"
+
+// games a thread claims at once for a plugin, all decided in one call
+#define SIMULATE_PLUGIN_BATCH 64
+
+typedef struct SimulateCtx {
+    ReplayWriter writer;
+    uint64_t games_n;
+    uint64_t first_seed;
+    PolicyKind policy;
+    PolicyPlugin* plugin;  // plays instead of policy if not NULL
+    _Atomic uint64_t next_game;
+    _Atomic bool failed;
+} SimulateCtx;
+
+typedef struct MoveLog {
+    Move* moves;
+    uint32_t moves_n;
+    uint32_t cap;
+    bool failed;
+} MoveLog;
+
+static void log_move(void* arg, uint32_t game, Move move) {
+    MoveLog* log = &((MoveLog*)arg)[game];
+    if (log->moves_n == log->cap) {
+        uint32_t cap = log->cap ? log->cap * 2 : 64;
+        Move* moves = realloc(log->moves, sizeof(*moves) * cap);
+        if (!moves) {
+            log->failed = true;
+            return;
+        }
+        log->moves = moves;
+        log->cap = cap;
+    }
+    log->moves[log->moves_n++] = move;
+}
+
+static void simulate_plugin_games(SimulateCtx* ctx, ReplaySegment* segment,
+                                  int thread_index) {
+    void* instance = policy_plugin_create(
+        ctx->plugin, ctx->first_seed ^ (uint64_t)thread_index << 32);
+    if (!instance) {
+        atomic_store(&ctx->failed, true);
+        return;
+    }
+    GameState states[SIMULATE_PLUGIN_BATCH];
+    uint64_t seeds[SIMULATE_PLUGIN_BATCH];
+    MoveLog logs[SIMULATE_PLUGIN_BATCH] = {0};
+
+    while (!atomic_load(&ctx->failed)) {
+        uint64_t first =
+            atomic_fetch_add(&ctx->next_game, SIMULATE_PLUGIN_BATCH);
+        if (first >= ctx->games_n) break;
+        uint32_t games_n = SIMULATE_PLUGIN_BATCH;
+        if (games_n > ctx->games_n - first) games_n = ctx->games_n - first;
+
+        for (uint32_t i = 0; i < games_n; ++i) {
+            seeds[i] = ctx->first_seed + first + i;
+            states[i] = make_gamestate(seeds[i]);
+            logs[i].moves_n = 0;
+        }
+        bool ok = policy_plugin_play(ctx->plugin, instance, states, seeds,
+                                     games_n, log_move, logs);
+        for (uint32_t i = 0; ok && i < games_n; ++i) {
+            ok = !logs[i].failed &&
+                 replay_segment_append(segment, seeds[i], states[i].points,
+                                       logs[i].moves, logs[i].moves_n);
+            metrics_count(METRIC_PLACEMENTS, logs[i].moves_n);
+        }
+        metrics_count(METRIC_GAMES_STARTED, games_n);
+        metrics_count(METRIC_GAMES_FINISHED, games_n);
+        if (!ok) atomic_store(&ctx->failed, true);
+    }
+
+    for (int i = 0; i < SIMULATE_PLUGIN_BATCH; ++i) free(logs[i].moves);
+    policy_plugin_destroy(ctx->plugin, instance);
+}
+
+static void simulate_thread(void* arg, int thread_index, int threads_n) {
+    (void)threads_n;
+    SimulateCtx* ctx = arg;
+    ReplaySegment* segment = replay_writer_segment(&ctx->writer);
+    if (!segment) {
+        atomic_store(&ctx->failed, true);
+        return;
+    }
+    if (ctx->plugin) {
+        simulate_plugin_games(ctx, segment, thread_index);
+        return;
+    }
+
+    Rng policy_rng = make_rng(ctx->first_seed ^ (uint64_t)thread_index << 32);
+    size_t log_cap = 256;
+    Move* log = malloc(sizeof(*log) * log_cap);
+    if (!log) {
+        atomic_store(&ctx->failed, true);
+        return;
+    }
+
+    for (;;) {
+        uint64_t game = atomic_fetch_add(&ctx->next_game, 1);
+        if (game >= ctx->games_n) break;
+
+        uint64_t seed = ctx->first_seed + game;
+        GameState state = make_gamestate(seed);
+        uint32_t log_n = 0;
+        bool grown = true;
+        for (;;) {
+            if (log_n + HELD_BLOCKS_N > log_cap) {
+                Move* grown_log = realloc(log, sizeof(*log) * log_cap * 2);
+                if (!grown_log) {
+                    grown = false;
+                    break;
+                }
+                log = grown_log;
+                log_cap *= 2;
+            }
+            int moves_n;
+            bool alive = play_turn(ctx->policy, &state, &policy_rng,
+                                   &log[log_n], &moves_n);
+            log_n += moves_n;
+            if (!alive) break;
+        }
+        if (!grown) {
+            atomic_store(&ctx->failed, true);
+            break;
+        }
+
+        // counted once per game rather than on every move
+        metrics_count(METRIC_GAMES_STARTED, 1);
+        metrics_count(METRIC_GAMES_FINISHED, 1);
+        metrics_count(METRIC_PLACEMENTS, log_n);
+
+        if (!replay_segment_append(segment, seed, state.points, log, log_n)) {
+            atomic_store(&ctx->failed, true);
+            break;
+        }
+    }
+    free(log);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr,
+                "usage: %s <archive> <games> [threads] [first seed] "
+                "[random|search|plugin:<path>[:<args>]] [opening book]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    SimulateCtx ctx = {
+        .games_n = strtoull(argv[2], NULL, 10),
+        .first_seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 0,
+    };
+    PolicyPlugin plugin = {0};
+    if (argc > 5 && is_plugin_spec(argv[5])) {
+        char error[256];
+        if (!policy_plugin_open(&plugin, argv[5], error, sizeof(error))) {
+            fprintf(stderr, "%s\n", error);
+            return 1;
+        }
+        ctx.plugin = &plugin;
+    } else if (argc > 5 && !parse_policy(argv[5], &ctx.policy)) {
+        fprintf(stderr, "unknown policy %s\n", argv[5]);
+        return 1;
+    }
+    int threads_n = argc > 3 ? atoi(argv[3]) : parallel_default_threads();
+    if (threads_n < 1) threads_n = 1;
+
+    OpeningBook book = {0};
+    if (argc > 6) {
+        if (!book_open(&book, argv[6])) {
+            fprintf(stderr, "failed to open %s\n", argv[6]);
+            return 1;
+        }
+        set_policy_book(&book);
+    }
+
+    if (!replay_writer_open(&ctx.writer, argv[1])) {
+        fprintf(stderr, "failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    MetricsExporter metrics_exporter;
+    bool exporting = metrics_exporter_start_from_env(&metrics_exporter);
+    double start = get_time_seconds();
+    if (!parallel_run(threads_n, simulate_thread, &ctx)) {
+        simulate_thread(&ctx, 0, 1);
+    }
+    bool ok = replay_writer_close(&ctx.writer) && !atomic_load(&ctx.failed);
+    double secs = get_time_seconds() - start;
+    book_close(&book);
+    if (exporting) metrics_exporter_stop(&metrics_exporter);
+
+    if (!ok) {
+        fprintf(stderr, "failed to write %s\n", argv[1]);
+        return 1;
+    }
+    printf("%llu games on %d threads in %.3fs (%.0f games/s)\n",
+           (unsigned long long)ctx.games_n, threads_n, secs,
+           ctx.games_n / secs);
+    if (ctx.plugin) {
+        char stats[512];
+        format_plugin_stats(&plugin, stats, sizeof(stats));
+        printf("%s\n", stats);
+        policy_plugin_close(&plugin);
+    }
+    return 0;
+}
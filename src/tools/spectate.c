@@ -0,0 +1,170 @@
+// publishes random games to a spectator stream, or follows one with many
+// viewers
+//
+// usage: spectate publish <name> [games] [moves/s] [seconds] [keyframe every]
+//        spectate watch <name> [viewers] [seconds]
+//
+// name is a shared memory name like /rm_spectate. 0 moves/s publishes as
+// fast as it can, keyframe every counts the moves of each game
+
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "block.h"
+#include "game.h"
+#include "parallel.h"
+#include "rng.h"
+#include "spectate.h"
+#include "timing.h"
+
+#define SPECTATE_CAPACITY (1u << 20)
+
+typedef struct WatchCtx {
+    const char* name;
+    double seconds;
+    _Atomic uint64_t records_n;
+    _Atomic uint64_t resyncs_n;
+    _Atomic uint64_t diverged_n;
+    _Atomic int failed_n;
+} WatchCtx;
+
+static void sleep_seconds(double seconds) {
+    struct timespec ts = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9),
+    };
+    nanosleep(&ts, NULL);
+}
+
+static int publish(const char* name, uint32_t games_n, double moves_per_sec,
+                   double seconds, uint32_t keyframe_every) {
+    SpectatePublisher publisher;
+    if (!spectate_publisher_open(&publisher, name, games_n, SPECTATE_CAPACITY,
+                                 keyframe_every)) {
+        fprintf(stderr, "failed to create %s\n", name);
+        return 1;
+    }
+    GameState* games = malloc(sizeof(*games) * games_n);
+    if (!games) return 1;
+    Rng rng = make_rng((uint64_t)time(NULL));
+    for (uint32_t i = 0; i < games_n; ++i) {
+        games[i] = make_gamestate(rng_next(&rng));
+        spectate_publish_game(&publisher, i, &games[i]);
+    }
+
+    double start = get_time_seconds();
+    double now = start;
+    uint64_t moves_n = 0;
+    Move moves[MAX_MOVES_N];
+    while (now - start < seconds) {
+        uint32_t game = moves_n % games_n;
+        int moves_n_legal = get_legal_moves(&games[game], moves);
+        if (moves_n_legal == 0) {
+            games[game] = make_gamestate(rng_next(&rng));
+            spectate_publish_game(&publisher, game, &games[game]);
+        } else {
+            Move move = moves[rng_range(&rng, moves_n_legal)];
+            PlacementUndo undo;
+            apply_move(&games[game], move, &undo);
+            spectate_publish_move(&publisher, game, &games[game], move, &undo);
+        }
+        moves_n++;
+
+        now = get_time_seconds();
+        if (moves_per_sec > 0) {
+            double ahead = moves_n / moves_per_sec - (now - start);
+            if (ahead > 0.001) sleep_seconds(ahead);
+        }
+    }
+
+    double secs = get_time_seconds() - start;
+    printf("%llu moves of %u games in %.1fs (%.0f moves/s)\n",
+           (unsigned long long)publisher.moves_n, games_n, secs,
+           publisher.moves_n / secs);
+    // what a full state per move would have cost: a snapshot record
+    double move_bytes = (double)publisher.move_bytes / publisher.moves_n;
+    double keyframe_bytes =
+        (double)publisher.keyframe_bytes / publisher.keyframes_n;
+    printf("%.1f bytes/move, %llu keyframes of %.0f bytes, "
+           "%.1f bytes/move in all\n",
+           move_bytes, (unsigned long long)publisher.keyframes_n,
+           keyframe_bytes,
+           (double)(publisher.move_bytes + publisher.keyframe_bytes) /
+               publisher.moves_n);
+    free(games);
+    spectate_publisher_close(&publisher);
+    return 0;
+}
+
+static void watch_thread(void* arg, int thread_index, int threads_n) {
+    (void)thread_index;
+    (void)threads_n;
+    WatchCtx* ctx = arg;
+    SpectateSubscriber subscriber;
+    if (!spectate_subscriber_open(&subscriber, ctx->name)) {
+        atomic_fetch_add(&ctx->failed_n, 1);
+        return;
+    }
+    double end = get_time_seconds() + ctx->seconds;
+    while (get_time_seconds() < end) {
+        if (spectate_poll(&subscriber) == 0) sleep_seconds(0.001);
+    }
+    atomic_fetch_add(&ctx->records_n, subscriber.records_n);
+    atomic_fetch_add(&ctx->resyncs_n, subscriber.resyncs_n);
+    atomic_fetch_add(&ctx->diverged_n, subscriber.diverged_n);
+    spectate_subscriber_close(&subscriber);
+}
+
+static int watch(const char* name, int viewers_n, double seconds) {
+    WatchCtx ctx = {.name = name, .seconds = seconds};
+    if (!parallel_run(viewers_n, watch_thread, &ctx)) {
+        fprintf(stderr, "failed to start %d viewers\n", viewers_n);
+        return 1;
+    }
+    if (atomic_load(&ctx.failed_n) > 0) {
+        fprintf(stderr, "failed to open %s\n", name);
+        return 1;
+    }
+    printf("%d viewers, %.0f records each, %.1f resyncs each, "
+           "%llu diverged\n",
+           viewers_n, (double)atomic_load(&ctx.records_n) / viewers_n,
+           (double)atomic_load(&ctx.resyncs_n) / viewers_n,
+           (unsigned long long)atomic_load(&ctx.diverged_n));
+    return atomic_load(&ctx.diverged_n) > 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 ||
+        (strcmp(argv[1], "publish") != 0 && strcmp(argv[1], "watch") != 0)) {
+        fprintf(stderr,
+                "usage: %s publish <name> [games] [moves/s] [seconds] "
+                "[keyframe every]\n"
+                "       %s watch <name> [viewers] [seconds]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    if (strcmp(argv[1], "publish") == 0) {
+        int games_n = argc > 3 ? atoi(argv[3]) : 16;
+        if (games_n < 1 || games_n > SPECTATE_GAMES_MAX) {
+            fprintf(stderr, "games must be from 1 to %d\n",
+                    SPECTATE_GAMES_MAX);
+            return 1;
+        }
+        double moves_per_sec = argc > 4 ? atof(argv[4]) : 1000;
+        double seconds = argc > 5 ? atof(argv[5]) : 10;
+        int keyframe_every = argc > 6 ? atoi(argv[6]) : 256;
+        if (keyframe_every < 1) keyframe_every = 1;
+        return publish(argv[2], games_n, moves_per_sec, seconds,
+                       keyframe_every);
+    }
+
+    int viewers_n = argc > 3 ? atoi(argv[3]) : 100;
+    if (viewers_n < 1) viewers_n = 1;
+    return watch(argv[2], viewers_n, argc > 4 ? atof(argv[4]) : 5);
+}
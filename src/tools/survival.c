@@ -0,0 +1,127 @@
+// estimates how likely a policy is to survive the next turns from the turn
+// starts of archived games, and compares that with how many turns the
+// archived games actually lasted from there
+//
+// usage: survival <archive> [turns] [positions] [threads] [half width]
+//                 [random|search]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+#include "replay.h"
+#include "survival.h"
+#include "timing.h"
+
+// the turns a game lasted from a position, more than turns_n count as one
+#define TURNS_LEFT_N 64
+
+// the start of every turn of the archived games, in order, until positions_n
+static int collect_positions(const ReplayArchive* archive, GameState* states,
+                             int* turns_left, int positions_n) {
+    int n = 0;
+    for (uint64_t game = 0; game < archive->games_n && n < positions_n;
+         ++game) {
+        const ReplayIndexEntry* entry = replay_game(archive, game);
+        const Move* moves = replay_game_moves(archive, entry);
+        if (!moves) continue;
+
+        int first = n;
+        GameState state = make_gamestate(entry->seed);
+        for (uint32_t i = 0; i <= entry->moves_n && n < positions_n; ++i) {
+            if (state.blocks_placed == 0) states[n++] = state;
+            if (i == entry->moves_n) break;
+            if (apply_move(&state, moves[i], NULL) < 0) {
+                n = first;
+                break;
+            }
+        }
+        for (int i = first; i < n; ++i) {
+            turns_left[i] = n - 1 - i;
+        }
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "usage: %s <archive> [turns] [positions] [threads] "
+                "[half width] [random|search]\n",
+                argv[0]);
+        return 1;
+    }
+    if (!init_block_masks()) return 1;
+
+    int turns_n = argc > 2 ? atoi(argv[2]) : 3;
+    int positions_n = argc > 3 ? atoi(argv[3]) : 1000;
+    PolicyKind policy = POLICY_RANDOM;
+    if (argc > 6 && !parse_policy(argv[6], &policy)) {
+        fprintf(stderr, "unknown policy %s\n", argv[6]);
+        return 1;
+    }
+    SurvivalParams params = make_survival_params(policy, turns_n);
+    if (argc > 4) params.threads_n = atoi(argv[4]);
+    if (params.threads_n < 1) params.threads_n = 1;
+    if (argc > 5) params.half_width = atof(argv[5]);
+    if (turns_n < 1 || positions_n < 1) {
+        fprintf(stderr, "turns and positions must be positive\n");
+        return 1;
+    }
+
+    ReplayArchive archive;
+    if (!replay_archive_open(&archive, argv[1])) {
+        fprintf(stderr, "failed to open %s\n", argv[1]);
+        return 1;
+    }
+    GameState* states = malloc(sizeof(*states) * positions_n);
+    int* turns_left = malloc(sizeof(*turns_left) * positions_n);
+    SurvivalEstimate* estimates = malloc(sizeof(*estimates) * positions_n);
+    if (!states || !turns_left || !estimates) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    positions_n = collect_positions(&archive, states, turns_left, positions_n);
+    replay_archive_close(&archive);
+
+    double start = get_time_seconds();
+    estimate_survival_batch(states, positions_n, &params, estimates);
+    double secs = get_time_seconds() - start;
+
+    uint64_t rollouts_n = 0;
+    uint64_t groups_n[TURNS_LEFT_N] = {0};
+    double groups_p[TURNS_LEFT_N] = {0};
+    double widest = 0;
+    for (int i = 0; i < positions_n; ++i) {
+        rollouts_n += estimates[i].rollouts_n;
+        double width = (estimates[i].high - estimates[i].low) / 2;
+        if (width > widest) widest = width;
+        int group = turns_left[i];
+        if (group > turns_n) group = turns_n + 1;
+        if (group >= TURNS_LEFT_N) group = TURNS_LEFT_N - 1;
+        groups_n[group]++;
+        groups_p[group] += estimates[i].probability;
+    }
+
+    printf("%d positions, %d turns, %s policy, %d threads\n", positions_n,
+           turns_n, policy == POLICY_SEARCH ? "search" : "random",
+           params.threads_n);
+    printf("%.2f s, %.0f positions/s, %.0f rollouts/s, %.1f rollouts/position, "
+           "widest interval +-%.4f\n",
+           secs, positions_n / secs, rollouts_n / secs,
+           positions_n ? (double)rollouts_n / positions_n : 0.0, widest);
+
+    printf("\nmean survival by turns the archived game lasted:\n");
+    for (int i = 0; i < TURNS_LEFT_N; ++i) {
+        if (!groups_n[i]) continue;
+        printf("  %3d%s %8llu positions  p %.4f\n", i,
+               i > turns_n ? "+" : " ", (unsigned long long)groups_n[i],
+               groups_p[i] / groups_n[i]);
+    }
+
+    free(estimates);
+    free(turns_left);
+    free(states);
+    return 0;
+}
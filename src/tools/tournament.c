@@ -0,0 +1,132 @@
+// plays policies against each other on the same seeds on all cores and
+// reports the paired score differences, stopping once every difference is
+// clear
+//
+// usage: tournament <policy,policy,...> [max games] [threads] [first seed]
+//                   [min games] [stop z] [opening book]
+//
+// a policy is random, search or plugin:<path>[:<args>]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block.h"
+#include "book.h"
+#include "timing.h"
+#include "tournament.h"
+
+static PolicyPlugin plugins[TOURNAMENT_POLICIES_MAX];
+
+// 0 if a policy is unknown or a plugin doesn't load
+static int parse_policies(char* list, TournamentParams* params,
+                          const char** names_out) {
+    int policies_n = 0;
+    for (char* name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        if (policies_n == TOURNAMENT_POLICIES_MAX) return 0;
+        if (is_plugin_spec(name)) {
+            PolicyPlugin* plugin = &plugins[policies_n];
+            char error[256];
+            if (!policy_plugin_open(plugin, name, error, sizeof(error))) {
+                fprintf(stderr, "%s\n", error);
+                return 0;
+            }
+            params->plugins[policies_n] = plugin;
+            names_out[policies_n++] = plugin->api->name;
+            continue;
+        }
+        if (!parse_policy(name, &params->policies[policies_n])) return 0;
+        names_out[policies_n++] = name;
+    }
+    return policies_n;
+}
+
+static void print_result(const TournamentResult* result, const char** names,
+                         int policies_n) {
+    printf("\n %-8s %12s %24s\n", "policy", "mean score", "95% interval");
+    for (int i = 0; i < policies_n; ++i) {
+        const RunningStats* scores = &result->scores[i];
+        double margin = STATS_Z_95 * running_stats_error(scores);
+        printf(" %-8s %12.1f   [%9.1f, %9.1f]\n", names[i], scores->mean,
+               scores->mean - margin, scores->mean + margin);
+    }
+
+    printf("\n %-17s %10s %22s %7s %7s %7s %18s\n", "pair", "mean diff",
+           "95% interval", "wins", "ties", "losses", "win rate");
+    for (int a = 0; a < policies_n; ++a) {
+        for (int b = a + 1; b < policies_n; ++b) {
+            const PairResult* pair = &result->pairs[a][b];
+            double low, high, win_low, win_high;
+            get_pair_interval(pair, STATS_Z_95, &low, &high);
+            get_win_interval(pair, STATS_Z_95, &win_low, &win_high);
+            uint64_t losses_n = pair->diff.n - pair->wins_n - pair->ties_n;
+            printf(" %-8s %-8s %10.1f  [%8.1f, %8.1f] %6.1f%% %6.1f%% %6.1f%%"
+                   "   [%5.1f%%, %5.1f%%]\n",
+                   names[a], names[b], pair->diff.mean, low, high,
+                   100.0 * pair->wins_n / pair->diff.n,
+                   100.0 * pair->ties_n / pair->diff.n,
+                   100.0 * losses_n / pair->diff.n, 100 * win_low,
+                   100 * win_high);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (!init_block_masks()) return 1;
+    TournamentParams params = make_tournament_params(NULL, 0);
+    const char* names[TOURNAMENT_POLICIES_MAX];
+    params.policies_n = argc > 1 ? parse_policies(argv[1], &params, names) : 0;
+    int policies_n = params.policies_n;
+    if (policies_n < 2) {
+        fprintf(stderr,
+                "usage: %s <policy,policy,...> [max games] [threads] "
+                "[first seed] [min games] [stop z] [opening book]\n"
+                "with 2 to %d policies out of random, search and "
+                "plugin:<path>[:<args>]\n",
+                argv[0], TOURNAMENT_POLICIES_MAX);
+        return 1;
+    }
+    if (argc > 2) params.max_games_n = strtoull(argv[2], NULL, 10);
+    if (argc > 3) params.threads_n = atoi(argv[3]);
+    if (argc > 4) params.first_seed = strtoull(argv[4], NULL, 10);
+    if (argc > 5) params.min_games_n = strtoull(argv[5], NULL, 10);
+    if (argc > 6) params.stop_z = atof(argv[6]);
+    if (params.threads_n < 1) params.threads_n = 1;
+
+    OpeningBook book = {0};
+    if (argc > 7) {
+        if (!book_open(&book, argv[7])) {
+            fprintf(stderr, "failed to open %s\n", argv[7]);
+            return 1;
+        }
+        set_policy_book(&book);
+    }
+
+    TournamentResult result;
+    double start = get_time_seconds();
+    bool ok = run_tournament(&params, &result);
+    double secs = get_time_seconds() - start;
+    book_close(&book);
+    if (!ok) {
+        fprintf(stderr, "out of memory or a plugin failed\n");
+        return 1;
+    }
+
+    printf("%llu seeds from %llu, %d policies, %d threads, %.2fs "
+           "(%.0f games/s)%s\n",
+           (unsigned long long)result.games_n,
+           (unsigned long long)params.first_seed, policies_n, params.threads_n,
+           secs, result.games_n * policies_n / secs,
+           result.stopped_early ? ", stopped early" : "");
+    print_result(&result, names, policies_n);
+
+    for (int i = 0; i < policies_n; ++i) {
+        if (!params.plugins[i]) continue;
+        char stats[512];
+        format_plugin_stats(params.plugins[i], stats, sizeof(stats));
+        printf("%s\n", stats);
+        policy_plugin_close(params.plugins[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "tournament.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "game.h"
+#include "parallel.h"
+
+// seeds a thread plays with every policy before it claims more, also the
+// batch a plugin decides on at once
+#define TOURNAMENT_CHUNK_GAMES 32
+
+typedef struct TournamentCtx {
+    const TournamentParams* params;
+    TournamentResult* result;
+    int32_t* scores;  // policies_n per game
+    _Atomic uint8_t* chunks_done;
+    uint64_t chunks_n;
+    _Atomic uint64_t next_chunk;
+    // held by the thread merging finished chunks into the result
+    _Atomic bool merging;
+    uint64_t merged_n;  // chunks merged, only touched while merging
+    _Atomic bool stop;
+    _Atomic bool failed;
+} TournamentCtx;
+
+TournamentParams make_tournament_params(const PolicyKind* policies,
+                                        int policies_n) {
+    TournamentParams params = {
+        .policies_n = policies_n,
+        .first_seed = 0,
+        .min_games_n = 200,
+        .max_games_n = 100000,
+        .stop_z = 3.29,
+        .threads_n = parallel_default_threads(),
+    };
+    for (int i = 0; i < policies_n; ++i) params.policies[i] = policies[i];
+    return params;
+}
+
+static int32_t play_game(PolicyKind policy, int policy_index, uint64_t seed) {
+    GameState state = make_gamestate(seed);
+    // the choices of a random policy depend on the game and the policy only,
+    // so the results don't depend on the threads
+    Rng rng = make_rng(seed ^ (uint64_t)(policy_index + 1) << 48);
+    while (play_turn(policy, &state, &rng, NULL, NULL)) {
+    }
+    return state.points;
+}
+
+// the instance is seeded by the chunk, so the results don't depend on the
+// threads either
+static bool play_plugin_games(PolicyPlugin* plugin, int policy_index,
+                              uint64_t first_seed, uint64_t games_n,
+                              int32_t* scores, int policies_n) {
+    GameState states[TOURNAMENT_CHUNK_GAMES];
+    uint64_t seeds[TOURNAMENT_CHUNK_GAMES];
+    for (uint64_t i = 0; i < games_n; ++i) {
+        seeds[i] = first_seed + i;
+        states[i] = make_gamestate(seeds[i]);
+    }
+    void* instance = policy_plugin_create(
+        plugin, first_seed ^ (uint64_t)(policy_index + 1) << 48);
+    if (!instance) return false;
+    bool ok = policy_plugin_play(plugin, instance, states, seeds, games_n,
+                                 NULL, NULL);
+    policy_plugin_destroy(plugin, instance);
+    for (uint64_t i = 0; i < games_n; ++i) {
+        scores[i * policies_n + policy_index] = states[i].points;
+    }
+    return ok;
+}
+
+static void add_game(TournamentResult* result, const int32_t* scores,
+                     int policies_n) {
+    result->games_n++;
+    for (int a = 0; a < policies_n; ++a) {
+        running_stats_add(&result->scores[a], scores[a]);
+        for (int b = a + 1; b < policies_n; ++b) {
+            PairResult* pair = &result->pairs[a][b];
+            running_stats_add(&pair->diff, scores[a] - scores[b]);
+            pair->wins_n += scores[a] > scores[b];
+            pair->ties_n += scores[a] == scores[b];
+        }
+    }
+}
+
+static bool all_pairs_decided(const TournamentParams* params,
+                              const TournamentResult* result) {
+    for (int a = 0; a < params->policies_n; ++a) {
+        for (int b = a + 1; b < params->policies_n; ++b) {
+            const RunningStats* diff = &result->pairs[a][b].diff;
+            double error = running_stats_error(diff);
+            if (diff->mean == 0 || fabs(diff->mean) < params->stop_z * error) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// merges the finished chunks that directly follow the merged ones. a thread
+// that finds another one merging leaves its chunk to that one or the next
+static void merge_chunks(TournamentCtx* ctx) {
+    if (atomic_exchange(&ctx->merging, true)) return;
+    const TournamentParams* params = ctx->params;
+    while (!atomic_load(&ctx->stop) && ctx->merged_n < ctx->chunks_n &&
+           atomic_load(&ctx->chunks_done[ctx->merged_n])) {
+        uint64_t first = ctx->merged_n * TOURNAMENT_CHUNK_GAMES;
+        uint64_t last = first + TOURNAMENT_CHUNK_GAMES;
+        if (last > params->max_games_n) last = params->max_games_n;
+        for (uint64_t game = first; game < last; ++game) {
+            add_game(ctx->result, &ctx->scores[game * params->policies_n],
+                     params->policies_n);
+        }
+        ctx->merged_n++;
+
+        if (params->stop_z > 0 &&
+            ctx->result->games_n >= params->min_games_n &&
+            all_pairs_decided(params, ctx->result)) {
+            ctx->result->stopped_early = ctx->merged_n < ctx->chunks_n;
+            atomic_store(&ctx->stop, true);
+        }
+    }
+    atomic_store(&ctx->merging, false);
+}
+
+static void tournament_thread(void* arg, int thread_index, int threads_n) {
+    (void)thread_index;
+    (void)threads_n;
+    TournamentCtx* ctx = arg;
+    const TournamentParams* params = ctx->params;
+    while (!atomic_load(&ctx->stop)) {
+        uint64_t chunk = atomic_fetch_add(&ctx->next_chunk, 1);
+        if (chunk >= ctx->chunks_n) break;
+
+        uint64_t first = chunk * TOURNAMENT_CHUNK_GAMES;
+        uint64_t last = first + TOURNAMENT_CHUNK_GAMES;
+        if (last > params->max_games_n) last = params->max_games_n;
+        int policies_n = params->policies_n;
+        for (int i = 0; i < policies_n; ++i) {
+            if (params->plugins[i]) {
+                if (!play_plugin_games(params->plugins[i], i,
+                                       params->first_seed + first, last - first,
+                                       &ctx->scores[first * policies_n],
+                                       policies_n)) {
+                    atomic_store(&ctx->failed, true);
+                    atomic_store(&ctx->stop, true);
+                    return;
+                }
+                continue;
+            }
+            for (uint64_t game = first; game < last; ++game) {
+                ctx->scores[game * policies_n + i] = play_game(
+                    params->policies[i], i, params->first_seed + game);
+            }
+        }
+        atomic_store(&ctx->chunks_done[chunk], 1);
+        merge_chunks(ctx);
+    }
+}
+
+bool run_tournament(const TournamentParams* params,
+                    TournamentResult* result_out) {
+    *result_out = (TournamentResult){0};
+    uint64_t chunks_n = (params->max_games_n + TOURNAMENT_CHUNK_GAMES - 1) /
+                        TOURNAMENT_CHUNK_GAMES;
+    TournamentCtx ctx = {
+        .params = params,
+        .result = result_out,
+        .scores = malloc(sizeof(int32_t) * params->max_games_n *
+                         params->policies_n),
+        .chunks_done = calloc(chunks_n, sizeof(uint8_t)),
+        .chunks_n = chunks_n,
+    };
+    if ((!ctx.scores || !ctx.chunks_done) && chunks_n > 0) {
+        free(ctx.scores);
+        free((void*)ctx.chunks_done);
+        return false;
+    }
+
+    int threads_n = params->threads_n > 0 ? params->threads_n : 1;
+    if ((uint64_t)threads_n > chunks_n) threads_n = chunks_n;
+    if (threads_n > 0 && !parallel_run(threads_n, tournament_thread, &ctx)) {
+        tournament_thread(&ctx, 0, 1);
+    }
+    // whatever was left behind by threads that found another one merging
+    merge_chunks(&ctx);
+
+    free(ctx.scores);
+    free((void*)ctx.chunks_done);
+    return !atomic_load(&ctx.failed);
+}
+
+void get_pair_interval(const PairResult* pair, double z, double* low_out,
+                       double* high_out) {
+    double margin = z * running_stats_error(&pair->diff);
+    *low_out = pair->diff.mean - margin;
+    *high_out = pair->diff.mean + margin;
+}
+
+void get_win_interval(const PairResult* pair, double z, double* low_out,
+                      double* high_out) {
+    get_wilson_interval(pair->wins_n, pair->diff.n - pair->ties_n, z, low_out,
+                        high_out);
+}
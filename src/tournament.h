@@ -0,0 +1,71 @@
+#if !defined(TOURNAMENT_H)
+#define TOURNAMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "plugin.h"
+#include "policy.h"
+#include "stats.h"
+
+// compares policies on the same games. every seed from first_seed on is
+// played once by each policy, and the seed alone decides the blocks dealt,
+// so the policies face identical block streams and the paired score
+// differences are free of the deal noise that dominates single scores.
+//
+// seeds are handed out to the threads in chunks and merged into the
+// statistics in seed order, so stopping early never favours the games that
+// happened to finish first.
+
+#define TOURNAMENT_POLICIES_MAX 8
+
+typedef struct TournamentParams {
+    PolicyKind policies[TOURNAMENT_POLICIES_MAX];
+    // a plugin plays instead of the builtin policy where it isn't NULL,
+    // every chunk of seeds in one batch
+    PolicyPlugin* plugins[TOURNAMENT_POLICIES_MAX];
+    int policies_n;
+    uint64_t first_seed;
+    uint64_t min_games_n;
+    uint64_t max_games_n;
+    // stops once the difference of every pair is at least this many
+    // standard errors away from 0. the statistics are looked at over and
+    // over, so it's well above the 1.96 of a single look. 0 always plays
+    // max_games_n
+    double stop_z;
+    int threads_n;
+} TournamentParams;
+
+typedef struct PairResult {
+    RunningStats diff;  // score of the first policy minus the second
+    uint64_t wins_n;    // games the first policy scored more in
+    uint64_t ties_n;
+} PairResult;
+
+typedef struct TournamentResult {
+    uint64_t games_n;  // seeds played by every policy
+    bool stopped_early;
+    RunningStats scores[TOURNAMENT_POLICIES_MAX];
+    // pairs[a][b] for a < b
+    PairResult pairs[TOURNAMENT_POLICIES_MAX][TOURNAMENT_POLICIES_MAX];
+} TournamentResult;
+
+// default params for policies_n policies: at least 200 and at most 100000
+// games on every core, stopping at 3.29 standard errors (p < 0.001)
+TournamentParams make_tournament_params(const PolicyKind* policies,
+                                        int policies_n);
+
+// plays the tournament, false if it ran out of memory or a plugin couldn't
+// make an instance
+bool run_tournament(const TournamentParams* params,
+                    TournamentResult* result_out);
+
+// interval of the mean score difference of a pair
+void get_pair_interval(const PairResult* pair, double z, double* low_out,
+                       double* high_out);
+// wilson interval of the share of the games with a winner that the first
+// policy of the pair won
+void get_win_interval(const PairResult* pair, double z, double* low_out,
+                      double* high_out);
+
+#endif  // TOURNAMENT_H
@@ -0,0 +1,49 @@
+#include "undo.h"
+
+static inline int wrap_index(int i) {
+    return (i + UNDO_HISTORY_N) % UNDO_HISTORY_N;
+}
+
+void undo_history_clear(UndoHistory* history) {
+    history->head = 0;
+    history->undo_n = 0;
+    history->redo_n = 0;
+}
+
+int undo_history_apply(UndoHistory* history, WideState* state, Move move) {
+    int lines_cleared =
+        wide_apply_move(state, move, &history->undos[history->head]);
+    if (lines_cleared < 0) return lines_cleared;
+
+    history->moves[history->head] = move;
+    history->head = wrap_index(history->head + 1);
+    if (history->undo_n < UNDO_HISTORY_N) history->undo_n++;
+    history->redo_n = 0;
+    return lines_cleared;
+}
+
+bool undo_history_undo(UndoHistory* history, WideState* state) {
+    if (history->undo_n == 0) return false;
+
+    history->head = wrap_index(history->head - 1);
+    wide_unmake_move(state, &history->undos[history->head]);
+    history->undo_n--;
+    history->redo_n++;
+    return true;
+}
+
+bool undo_history_redo(UndoHistory* history, WideState* state) {
+    if (history->redo_n == 0) return false;
+
+    // the rng was rewound by the undo, so the move refills the held blocks
+    // exactly like it did the first time
+    Move move = history->moves[history->head];
+    if (wide_apply_move(state, move, &history->undos[history->head]) < 0) {
+        history->redo_n = 0;
+        return false;
+    }
+    history->head = wrap_index(history->head + 1);
+    history->undo_n++;
+    history->redo_n--;
+    return true;
+}
@@ -0,0 +1,27 @@
+#if !defined(UNDO_H)
+#define UNDO_H
+
+#include <stdbool.h>
+
+#include "wide.h"
+
+#define UNDO_HISTORY_N 64
+
+// fixed ring of placements that can be undone and redone, the oldest entry
+// is dropped once it is full. it works on the wide game the gui plays, its
+// records share their TurnUndo with the PlacementUndo the search unmakes
+typedef struct UndoHistory {
+    WidePlacementUndo undos[UNDO_HISTORY_N];
+    Move moves[UNDO_HISTORY_N];
+    int head;  // where the next placement goes
+    int undo_n;
+    int redo_n;
+} UndoHistory;
+
+void undo_history_clear(UndoHistory* history);
+// applies the move and records it, dropping everything that could be redone
+int undo_history_apply(UndoHistory* history, WideState* state, Move move);
+bool undo_history_undo(UndoHistory* history, WideState* state);
+bool undo_history_redo(UndoHistory* history, WideState* state);
+
+#endif  // UNDO_H
@@ -0,0 +1,220 @@
+#include "vecenv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+
+bool vecenv_init(VecEnv* env, int envs_n, uint64_t seed) {
+    *env = (VecEnv){
+        .envs_n = envs_n,
+        .boards = calloc(envs_n, sizeof(Board)),
+        .color_boards = calloc(envs_n * CELL_COLORS_N, sizeof(Board)),
+        .held_blocks = calloc(envs_n * HELD_BLOCKS_N, sizeof(PackedBlock)),
+        .points = calloc(envs_n, sizeof(int32_t)),
+        .combos = calloc(envs_n, sizeof(int32_t)),
+        .blocks_placed = calloc(envs_n, sizeof(uint8_t)),
+        .cleared_in_turn = calloc(envs_n, sizeof(uint8_t)),
+        .done = calloc(envs_n, sizeof(uint8_t)),
+        .gens = calloc(envs_n, sizeof(BlockGen)),
+        .prefill = calloc(envs_n * VECENV_PREFILL_BLOCKS, sizeof(PackedBlock)),
+        .prefill_n = calloc(envs_n, sizeof(uint16_t)),
+        .prefill_next = calloc(envs_n, sizeof(uint16_t)),
+        .seed_rngs = calloc(envs_n, sizeof(Rng)),
+        .seeds = calloc(envs_n, sizeof(uint64_t)),
+        .placed = calloc(envs_n, sizeof(Board)),
+        .legal = calloc(envs_n, sizeof(uint8_t)),
+        .lines_cleared = calloc(envs_n, sizeof(uint8_t)),
+        .game_over = calloc(envs_n, sizeof(uint8_t)),
+        .deal_mode = DEAL_MODE_RANDOM,
+        .obs_layout = make_obs_layout(VECENV_DEFAULT_OBS),
+    };
+    if (!env->boards || !env->color_boards || !env->held_blocks ||
+        !env->points || !env->combos || !env->blocks_placed ||
+        !env->cleared_in_turn || !env->done || !env->gens ||
+        !env->prefill || !env->prefill_n || !env->prefill_next ||
+        !env->seed_rngs || !env->seeds || !env->placed || !env->legal ||
+        !env->lines_cleared || !env->game_over) {
+        vecenv_free(env);
+        return false;
+    }
+
+    Rng seeder = make_rng(seed);
+    for (int i = 0; i < envs_n; ++i) {
+        env->seed_rngs[i] = make_rng(rng_next(&seeder));
+    }
+    vecenv_reset(env, NULL);
+    return true;
+}
+
+void vecenv_free(VecEnv* env) {
+    free(env->boards);
+    free(env->color_boards);
+    free(env->held_blocks);
+    free(env->points);
+    free(env->combos);
+    free(env->blocks_placed);
+    free(env->cleared_in_turn);
+    free(env->done);
+    free(env->gens);
+    free(env->prefill);
+    free(env->prefill_n);
+    free(env->prefill_next);
+    free(env->seed_rngs);
+    free(env->seeds);
+    free(env->placed);
+    free(env->legal);
+    free(env->lines_cleared);
+    free(env->game_over);
+    *env = (VecEnv){0};
+}
+
+void vecenv_set_obs_layout(VecEnv* env, unsigned sections) {
+    env->obs_layout = make_obs_layout(sections);
+}
+
+void vecenv_set_deal_mode(VecEnv* env, DealMode mode) {
+    env->deal_mode = mode;
+}
+
+static void deal_env_blocks(VecEnv* env, int i) {
+    PackedBlock* prefill = &env->prefill[i * VECENV_PREFILL_BLOCKS];
+    if (env->prefill_next[i] == env->prefill_n[i]) {
+        int blocks_n = env->prefill_n[i] * 2;
+        if (blocks_n < HELD_BLOCKS_N * 2) blocks_n = HELD_BLOCKS_N * 2;
+        if (blocks_n > VECENV_PREFILL_BLOCKS) blocks_n = VECENV_PREFILL_BLOCKS;
+        block_gen_fill(&env->gens[i], prefill, blocks_n);
+        env->prefill_n[i] = blocks_n;
+        env->prefill_next[i] = 0;
+    }
+    memcpy(&env->held_blocks[i * HELD_BLOCKS_N],
+           &prefill[env->prefill_next[i]], HELD_BLOCKS_N);
+    env->prefill_next[i] += HELD_BLOCKS_N;
+    env->blocks_placed[i] = 0;
+    env->cleared_in_turn[i] = false;
+}
+
+void vecenv_reset_env(VecEnv* env, int i, uint64_t seed) {
+    env->seeds[i] = seed;
+    env->gens[i] = make_block_gen(seed, env->deal_mode);
+    env->prefill_n[i] = 0;
+    env->prefill_next[i] = 0;
+    env->boards[i] = 0;
+    memset(&env->color_boards[i * CELL_COLORS_N], 0,
+           sizeof(Board) * CELL_COLORS_N);
+    env->points[i] = 0;
+    env->combos[i] = 1;
+    env->done[i] = false;
+    deal_env_blocks(env, i);
+}
+
+void vecenv_reset(VecEnv* env, uint8_t* obs_out) {
+    for (int i = 0; i < env->envs_n; ++i) {
+        vecenv_reset_env(env, i, rng_next(&env->seed_rngs[i]));
+    }
+    if (obs_out) vecenv_observe(env, obs_out);
+}
+
+static inline Board get_env_legal_origins(Board board, PackedBlock packed) {
+    if ((packed & 3) == CELL_ITEM_EMPTY) return 0;
+    Block block = unpack_block(packed);
+    return get_legal_origins(board, get_block_mask(&block));
+}
+
+// the rules of make_move followed by deal_random_blocks, split into passes
+// over all games so the board operations run through the batch kernels
+void vecenv_step(VecEnv* env, const int32_t* actions, float* rewards_out,
+                 uint8_t* dones_out, uint8_t* obs_out) {
+    int envs_n = env->envs_n;
+
+    // the placed cells of every action, none for actions out of range, on
+    // an empty slot or with the block sticking out of the field
+    for (int i = 0; i < envs_n; ++i) {
+        int32_t action = actions[i];
+        Board placed = 0;
+        if (action >= 0 && action < VECENV_ACTIONS_N) {
+            int slot = action / (FIELD_SIZE * FIELD_SIZE);
+            int cell = action % (FIELD_SIZE * FIELD_SIZE);
+            PackedBlock packed = env->held_blocks[i * HELD_BLOCKS_N + slot];
+            Block block = unpack_block(packed);
+            if (block.item != CELL_ITEM_EMPTY) {
+                const BlockMask* mask = get_block_mask(&block);
+                if (board_test(mask->origins, cell)) {
+                    placed = mask->cells << cell;
+                }
+            }
+        }
+        env->placed[i] = placed;
+    }
+    batch_placement_free(env->boards, env->placed, env->legal, envs_n);
+
+    for (int i = 0; i < envs_n; ++i) {
+        if (!env->placed[i]) env->legal[i] = false;
+        if (!env->legal[i]) continue;
+        int slot = actions[i] / (FIELD_SIZE * FIELD_SIZE);
+        PackedBlock* packed = &env->held_blocks[i * HELD_BLOCKS_N + slot];
+        FieldCellItem item = unpack_block(*packed).item;
+        env->boards[i] |= env->placed[i];
+        env->color_boards[i * CELL_COLORS_N + item - 1] |= env->placed[i];
+        *packed = 0;
+        env->blocks_placed[i]++;
+    }
+    batch_clear_lines(env->boards, env->lines_cleared, envs_n);
+
+    for (int i = 0; i < envs_n; ++i) {
+        if (!env->legal[i]) continue;
+        if (env->lines_cleared[i]) {
+            // the colors are subsets of the occupied cells
+            Board* colors = &env->color_boards[i * CELL_COLORS_N];
+            for (int c = 0; c < CELL_COLORS_N; ++c) colors[c] &= env->boards[i];
+        }
+        int points = get_clear_points(env->lines_cleared[i], env->combos[i]);
+        bool cleared = points > 0;
+        bool turn_done = env->blocks_placed[i] == HELD_BLOCKS_N;
+        env->combos[i] = get_next_combo(env->combos[i], cleared,
+                                        env->cleared_in_turn[i], turn_done);
+        env->cleared_in_turn[i] |= cleared;
+        env->points[i] += points;
+        if (rewards_out) rewards_out[i] = points;
+        if (turn_done) deal_env_blocks(env, i);
+    }
+    batch_game_over(env->boards, env->held_blocks, env->game_over, envs_n);
+
+    for (int i = 0; i < envs_n; ++i) {
+        bool done = !env->legal[i] || env->game_over[i];
+        if (rewards_out && !env->legal[i]) rewards_out[i] = 0;
+        if (dones_out) dones_out[i] = done;
+        if (done) vecenv_reset_env(env, i, rng_next(&env->seed_rngs[i]));
+    }
+    if (obs_out) vecenv_observe(env, obs_out);
+}
+
+void vecenv_observe(const VecEnv* env, uint8_t* obs_out) {
+    for (int i = 0; i < env->envs_n; ++i) {
+        obs_write(&env->obs_layout, env->boards[i],
+                  &env->color_boards[i * CELL_COLORS_N],
+                  &env->held_blocks[i * HELD_BLOCKS_N],
+                  obs_out + (size_t)i * env->obs_layout.size);
+    }
+}
+
+void vecenv_legal_moves(const VecEnv* env, Board* legal_out) {
+    for (int i = 0; i < env->envs_n; ++i) {
+        const PackedBlock* held = &env->held_blocks[i * HELD_BLOCKS_N];
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            legal_out[i * HELD_BLOCKS_N + slot] =
+                get_env_legal_origins(env->boards[i], held[slot]);
+        }
+    }
+}
+
+void vecenv_legal_mask(const VecEnv* env, uint8_t* mask_out) {
+    for (int i = 0; i < env->envs_n; ++i) {
+        const PackedBlock* held = &env->held_blocks[i * HELD_BLOCKS_N];
+        uint8_t* mask = mask_out + (size_t)i * VECENV_ACTIONS_N;
+        for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+            obs_write_plane(get_env_legal_origins(env->boards[i], held[slot]),
+                            mask + slot * FIELD_SIZE * FIELD_SIZE);
+        }
+    }
+}
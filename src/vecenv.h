@@ -0,0 +1,90 @@
+#if !defined(VECENV_H)
+#define VECENV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batch.h"
+#include "bitboard.h"
+#include "block.h"
+#include "block_gen.h"
+#include "constants.h"
+#include "obs.h"
+#include "rng.h"
+
+// many games stepped together for reinforcement learning, stored as
+// structure of arrays.
+//
+// an action is slot * FIELD_SIZE * FIELD_SIZE + cell, the same placement as
+// a Move. an illegal action ends the game, use vecenv_legal_moves to mask
+// them out. finished games are reset right away, the observation written for
+// them is the first one of the new game.
+
+#define VECENV_ACTIONS_N (HELD_BLOCKS_N * FIELD_SIZE * FIELD_SIZE)
+
+// observations are laid out per game as env->obs_layout describes, one
+// game after the other. the default is the occupancy plane followed by the
+// held block codes
+#define VECENV_DEFAULT_OBS (OBS_OCCUPANCY | OBS_HELD_CODES)
+
+// the most blocks of a game drawn ahead at once, whole turns. most games
+// are short, so the first batch of a game is two turns and every following
+// one twice the last, up to this
+#define VECENV_PREFILL_BLOCKS (HELD_BLOCKS_N * 1024)
+
+typedef struct VecEnv {
+    int envs_n;
+    Board* boards;
+    Board* color_boards;  // CELL_COLORS_N per game, indexed by item - 1
+    PackedBlock* held_blocks;  // HELD_BLOCKS_N per game
+    int32_t* points;
+    int32_t* combos;
+    uint8_t* blocks_placed;
+    uint8_t* cleared_in_turn;
+    uint8_t* done;
+    BlockGen* gens;  // block stream of the current game
+    // VECENV_PREFILL_BLOCKS per game, the next blocks of its stream
+    PackedBlock* prefill;
+    uint16_t* prefill_n;     // blocks in the current batch
+    uint16_t* prefill_next;  // index of the next block to deal
+    Rng* seed_rngs;  // seeds of the following games
+    uint64_t* seeds;  // seed of the current game
+    DealMode deal_mode;
+    ObsLayout obs_layout;
+
+    // per step scratch space for the batch kernels
+    Board* placed;
+    uint8_t* legal;
+    uint8_t* lines_cleared;
+    uint8_t* game_over;
+} VecEnv;
+
+// every game gets its own seed stream derived from seed and its index.
+// init_batch_kernels must have been called
+bool vecenv_init(VecEnv* env, int envs_n, uint64_t seed);
+void vecenv_free(VecEnv* env);
+// sections is a set of ObsSection flags
+void vecenv_set_obs_layout(VecEnv* env, unsigned sections);
+// the games started afterwards deal this way, random by default
+void vecenv_set_deal_mode(VecEnv* env, DealMode mode);
+
+// starts game i over with the given seed
+void vecenv_reset_env(VecEnv* env, int i, uint64_t seed);
+// starts every game over, obs_out may be NULL
+void vecenv_reset(VecEnv* env, uint8_t* obs_out);
+
+// advances every game by one action. rewards_out gets the points earned,
+// dones_out is set for games that ended (and were reset). any of the output
+// buffers may be NULL. obs_out is written in place, it may well be shared
+// memory mapped by a trainer
+void vecenv_step(VecEnv* env, const int32_t* actions, float* rewards_out,
+                 uint8_t* dones_out, uint8_t* obs_out);
+
+// envs_n * obs_layout.size bytes
+void vecenv_observe(const VecEnv* env, uint8_t* obs_out);
+// legal top left corners of every held block, HELD_BLOCKS_N boards per game
+void vecenv_legal_moves(const VecEnv* env, Board* legal_out);
+// the same as one byte per action, VECENV_ACTIONS_N per game
+void vecenv_legal_mask(const VecEnv* env, uint8_t* mask_out);
+
+#endif  // VECENV_H
@@ -18,8 +18,8 @@ static inline int vector_field_index(Vector2 v) {
     return roundf(v.x) + roundf(v.y) * FIELD_SIZE;
 }
 
-static inline bool vector_in_field_bounds(Vector2 v) {
-    return v.x >= 0 && v.y >= 0 && v.x < FIELD_SIZE && v.y < FIELD_SIZE;
+static inline bool vector_in_sized_field_bounds(Vector2 v, int size) {
+    return v.x >= 0 && v.y >= 0 && v.x < size && v.y < size;
 }
 
 #endif // VECTOR_FNS_H
@@ -0,0 +1,335 @@
+#include "wide.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "raymath.h"
+#include "vector_fns.h"
+
+#define WIDE_WORDS 1
+#define WIDE_NAME(name) name##_64
+#include "wide_kernels.h"
+
+#define WIDE_WORDS 2
+#define WIDE_NAME(name) name##_128
+#include "wide_kernels.h"
+
+#define WIDE_WORDS 4
+#define WIDE_NAME(name) name##_256
+#include "wide_kernels.h"
+
+// 8x8 has the same cell order as a Board, so the bitboard line clears do
+static int clear_lines_8x8(const WideGeometry* geometry, WideBoard* field,
+                           WideBoard* cleared_out) {
+    (void)geometry;
+    Board boards[CELL_COLORS_N];
+    Board cleared[CELL_COLORS_N];
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        boards[color] = field[color].words[0];
+    }
+    int lines_cleared;
+    clear_field(boards, 1, &lines_cleared, cleared);
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        field[color].words[0] = boards[color];
+        if (cleared_out) cleared_out[color].words[0] = cleared[color];
+    }
+    return lines_cleared;
+}
+
+static const WideKernels kernels_8x8 = {
+    .cells_free = cells_free_64,
+    .clear_lines = clear_lines_8x8,
+};
+
+static WideGeometry geometries[FIELD_SIZE_MAX - FIELD_SIZE_MIN + 1];
+
+static inline void wide_set_cell(WideBoard* board, int index) {
+    board->words[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+static inline bool wide_test_cell(const WideBoard* board, int index) {
+    return (board->words[index / 64] >> (index % 64)) & 1;
+}
+
+static inline WideBoard wide_shift_left(const WideBoard* board, int n) {
+    WideBoard shifted = {0};
+    int words = n / 64;
+    int bits = n % 64;
+    for (int i = words; i < WIDE_WORDS_MAX; ++i) {
+        shifted.words[i] = board->words[i - words] << bits;
+        if (bits && i > words) {
+            shifted.words[i] |= board->words[i - words - 1] >> (64 - bits);
+        }
+    }
+    return shifted;
+}
+
+FieldRepr get_field_repr(int size) {
+    if (size * size <= 64) return FIELD_REPR_64;
+    if (size * size <= 128) return FIELD_REPR_128;
+    return FIELD_REPR_256;
+}
+
+void init_wide_geometries(void) {
+    static_assert(FIELD_SIZE_MAX * FIELD_SIZE_MAX <= 64 * WIDE_WORDS_MAX,
+                  "the largest field must fit into a WideBoard");
+    static_assert(FIELD_SIZE_MAX * FIELD_SIZE_MAX <= 256,
+                  "cell indices must fit into Move.cell");
+    for (int size = FIELD_SIZE_MIN; size <= FIELD_SIZE_MAX; ++size) {
+        WideGeometry* geometry = &geometries[size - FIELD_SIZE_MIN];
+        *geometry = (WideGeometry){
+            .size = size,
+            .repr = get_field_repr(size),
+        };
+        for (int line = 0; line < size; ++line) {
+            for (int i = 0; i < size; ++i) {
+                wide_set_cell(&geometry->rows[line], line * size + i);
+                wide_set_cell(&geometry->cols[line], i * size + line);
+            }
+        }
+        switch (geometry->repr) {
+            case FIELD_REPR_64:
+                geometry->kernels =
+                    size == FIELD_SIZE ? &kernels_8x8 : &kernels_64;
+                break;
+            case FIELD_REPR_128:
+                geometry->kernels = &kernels_128;
+                break;
+            case FIELD_REPR_256:
+                geometry->kernels = &kernels_256;
+                break;
+        }
+    }
+}
+
+const WideGeometry* get_wide_geometry(int size) {
+    if (size < FIELD_SIZE_MIN || size > FIELD_SIZE_MAX) return NULL;
+    const WideGeometry* geometry = &geometries[size - FIELD_SIZE_MIN];
+    assert(geometry->kernels && "init_wide_geometries wasn't called");
+    return geometry;
+}
+
+WideState make_wide_state(int size, uint64_t seed) {
+    WideState state = {
+        .geometry = get_wide_geometry(size),
+        .points = 0,
+        .combo = 1,
+        .blocks_placed = 0,
+        .block_selected = 0,
+        .cleared_in_turn = false,
+        .rng = make_rng(seed),
+    };
+    assert(state.geometry);
+    get_random_deal(&state.rng, state.held_blocks);
+    return state;
+}
+
+FieldCellItem get_wide_field_cell(const WideState* state, int index) {
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        if (wide_test_cell(&state->field[i], index)) return i + 1;
+    }
+    return CELL_ITEM_EMPTY;
+}
+
+bool get_narrow_state(const WideState* state, GameState* state_out) {
+    if (state->geometry->size != FIELD_SIZE) return false;
+    *state_out = (GameState){
+        .points = state->points,
+        .combo = state->combo,
+        .blocks_placed = state->blocks_placed,
+        .block_selected = state->block_selected,
+        .cleared_in_turn = state->cleared_in_turn,
+        .rng = state->rng,
+    };
+    for (int i = 0; i < CELL_COLORS_N; ++i) {
+        state_out->field[i] = state->field[i].words[0];
+    }
+    for (int i = 0; i < HELD_BLOCKS_N; ++i) {
+        state_out->held_blocks[i] = state->held_blocks[i];
+    }
+    return true;
+}
+
+WideBoard get_wide_occupied_cells(const WideState* state) {
+    WideBoard occupied = {0};
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        for (int i = 0; i < WIDE_WORDS_MAX; ++i) {
+            occupied.words[i] |= state->field[color].words[i];
+        }
+    }
+    return occupied;
+}
+
+bool get_wide_block_cells(const WideGeometry* geometry, const Block* block,
+                          int cell, WideBoard* cells_out) {
+    int size = geometry->size;
+    const BlockMask* mask = get_block_mask(block);
+    int x = cell % size;
+    int y = cell / size;
+    if (cell < 0 || x + mask->width > size || y + mask->height > size) {
+        return false;
+    }
+    *cells_out = (WideBoard){0};
+    for (int i = 0; i < mask->cells_n; ++i) {
+        int dx = mask->offsets[i] % FIELD_SIZE;
+        int dy = mask->offsets[i] / FIELD_SIZE;
+        wide_set_cell(cells_out, (y + dy) * size + x + dx);
+    }
+    return true;
+}
+
+static bool wide_cells_free(const WideState* state, const Block* block,
+                            int cell) {
+    WideBoard cells;
+    if (!get_wide_block_cells(state->geometry, block, cell, &cells)) {
+        return false;
+    }
+    WideBoard occupied = get_wide_occupied_cells(state);
+    return state->geometry->kernels->cells_free(&occupied, &cells);
+}
+
+Move get_wide_move(const WideState* state, const Block* block, int slot,
+                   Vector2 coords) {
+    Vector2 corner = Vector2Add(coords, get_block_corner_offset(block));
+    int size = state->geometry->size;
+    return (Move){
+        .slot = slot,
+        .cell = roundf(corner.x) + roundf(corner.y) * size,
+    };
+}
+
+bool wide_block_space_free(const WideState* state, Vector2 coords,
+                           const Block* block) {
+    int size = state->geometry->size;
+    Vector2 corner = Vector2Add(coords, get_block_corner_offset(block));
+    if (!vector_in_sized_field_bounds(Vector2Round(corner), size)) {
+        return false;
+    }
+    return wide_cells_free(state, block,
+                           get_wide_move(state, block, 0, coords).cell);
+}
+
+bool get_wide_fuzzy_block_placement(const WideState* state, Vector2 location,
+                                    Vector2 grid_clamped_location,
+                                    Vector2* fuzzy_location_out) {
+    const Block* held_block = &state->held_blocks[state->block_selected];
+    int size = state->geometry->size;
+    float half = size / 2.0f;
+
+    int starting_dx = location.x < half ? -1 : 1;
+    int ddx = location.x < half ? 1 : -1;
+
+    int starting_dy = location.y < half ? -1 : 1;
+    int ddy = location.y < half ? 1 : -1;
+
+    for (int dx = starting_dx; abs(dx - starting_dx) < 3; dx += ddx) {
+        for (int dy = starting_dy; abs(dy - starting_dy) < 3; dy += ddy) {
+            Vector2 new_location =
+                Vector2Add(grid_clamped_location, (Vector2){dx, dy});
+            if (vector_in_sized_field_bounds(new_location, size) &&
+                wide_block_space_free(state, new_location, held_block)) {
+                *fuzzy_location_out = new_location;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool wide_move_is_legal(const WideState* state, Move move) {
+    int size = state->geometry->size;
+    if (move.slot >= HELD_BLOCKS_N || move.cell >= size * size) return false;
+    const Block* block = &state->held_blocks[move.slot];
+    if (block->item == CELL_ITEM_EMPTY) return false;
+    return wide_cells_free(state, block, move.cell);
+}
+
+int wide_apply_move(WideState* state, Move move, WidePlacementUndo* undo_out) {
+    if (!wide_move_is_legal(state, move)) return -1;
+    state->block_selected = move.slot;
+
+    const Block* held_block = &state->held_blocks[move.slot];
+    WideBoard placed;
+    get_wide_block_cells(state->geometry, held_block, move.cell, &placed);
+    if (undo_out) {
+        *undo_out = (WidePlacementUndo){
+            .placed = placed,
+            .turn = {
+                .points = state->points,
+                .combo = state->combo,
+                .block = pack_block(held_block),
+                .slot = move.slot,
+                .blocks_placed = state->blocks_placed,
+                .block_selected = state->block_selected,
+                .cleared_in_turn = state->cleared_in_turn,
+                .rng = state->rng,
+            },
+        };
+    }
+    state->blocks_placed++;
+
+    WideBoard* color = &state->field[held_block->item - 1];
+    for (int i = 0; i < WIDE_WORDS_MAX; ++i) color->words[i] |= placed.words[i];
+    state->held_blocks[move.slot] = get_empty_block();
+
+    int lines_cleared = state->geometry->kernels->clear_lines(
+        state->geometry, state->field, undo_out ? undo_out->cleared : NULL);
+    bool turn_done = state->blocks_placed == HELD_BLOCKS_N;
+    score_placement(lines_cleared, state->geometry->size, turn_done,
+                    &state->points, &state->combo, &state->cleared_in_turn);
+
+    if (turn_done) {
+        get_random_deal(&state->rng, state->held_blocks);
+        state->blocks_placed = 0;
+        state->cleared_in_turn = false;
+        if (undo_out) undo_out->turn.dealt = true;
+    }
+    return lines_cleared;
+}
+
+void wide_unmake_move(WideState* state, const WidePlacementUndo* undo) {
+    Block block = undo_turn(&undo->turn, state->held_blocks, &state->rng,
+                            &state->points, &state->combo,
+                            &state->blocks_placed, &state->block_selected,
+                            &state->cleared_in_turn);
+    // the cleared cells can include the placed ones, so those go last
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        for (int i = 0; i < WIDE_WORDS_MAX; ++i) {
+            state->field[color].words[i] |= undo->cleared[color].words[i];
+        }
+    }
+    for (int i = 0; i < WIDE_WORDS_MAX; ++i) {
+        state->field[block.item - 1].words[i] &= ~undo->placed.words[i];
+    }
+}
+
+bool wide_is_game_over(const WideState* state) {
+    const WideGeometry* geometry = state->geometry;
+    WideBoard occupied = get_wide_occupied_cells(state);
+    for (int slot = 0; slot < HELD_BLOCKS_N; ++slot) {
+        const Block* block = &state->held_blocks[slot];
+        if (block->item == CELL_ITEM_EMPTY) continue;
+        // 8x8 has the cell order of a Board, so all corners go at once
+        if (geometry->size == FIELD_SIZE) {
+            if (get_legal_origins(occupied.words[0], get_block_mask(block))) {
+                return false;
+            }
+            continue;
+        }
+        // the cells at every other corner are the ones at the first
+        // shifted by the corner's index
+        int size = geometry->size;
+        const BlockMask* mask = get_block_mask(block);
+        WideBoard first;
+        if (!get_wide_block_cells(geometry, block, 0, &first)) continue;
+        for (int y = 0; y + mask->height <= size; ++y) {
+            for (int x = 0; x + mask->width <= size; ++x) {
+                WideBoard cells = wide_shift_left(&first, y * size + x);
+                if (geometry->kernels->cells_free(&occupied, &cells)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
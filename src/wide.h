@@ -0,0 +1,108 @@
+#if !defined(WIDE_H)
+#define WIDE_H
+
+#include <raylib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "block.h"
+#include "constants.h"
+#include "game.h"
+#include "rng.h"
+
+// the game on a field of any size from FIELD_SIZE_MIN to FIELD_SIZE_MAX,
+// picked at runtime. cells are numbered y * size + x and kept in as few 64
+// bit words as the size needs: one up to 8x8, two (128 bits) up to 11x11
+// and four (256 bits) up to 16x16. the geometry of a size picks the kernels
+// for its word count once, and 8x8 gets the plain bitboard ones. the rules
+// are the ones of GameState, scored by score_placement and dealt by
+// get_random_deal.
+//
+// only the gui plays other sizes so far. the search, vecenv, replays, the
+// server and the tools all keep the 8x8 GameState, their formats and
+// kernels assume one 64 bit board, and taking them wide is deferred.
+
+#define WIDE_WORDS_MAX 4
+
+typedef struct WideBoard {
+    uint64_t words[WIDE_WORDS_MAX];  // the unused words stay 0
+} WideBoard;
+
+typedef enum FieldRepr {
+    FIELD_REPR_64,
+    FIELD_REPR_128,
+    FIELD_REPR_256,
+} FieldRepr;
+
+typedef struct WideGeometry WideGeometry;
+
+typedef struct WideKernels {
+    bool (*cells_free)(const WideBoard* occupied, const WideBoard* cells);
+    // clears the full lines of the field, one board per color, and returns
+    // how many there were. cleared_out may be NULL
+    int (*clear_lines)(const WideGeometry* geometry, WideBoard* field,
+                       WideBoard* cleared_out);
+} WideKernels;
+
+struct WideGeometry {
+    int size;
+    FieldRepr repr;
+    WideBoard rows[FIELD_SIZE_MAX];
+    WideBoard cols[FIELD_SIZE_MAX];
+    const WideKernels* kernels;
+};
+
+// GameState with a wide field, moves are the same but with cell indices
+// of the wide field
+typedef struct WideState {
+    const WideGeometry* geometry;
+    WideBoard field[CELL_COLORS_N];
+    int points;
+    int combo;
+    int blocks_placed;
+    int block_selected;
+    Block held_blocks[HELD_BLOCKS_N];
+    bool cleared_in_turn;
+    Rng rng;
+} WideState;
+
+// PlacementUndo for a wide field, only the boards are wider
+typedef struct WidePlacementUndo {
+    WideBoard placed;
+    WideBoard cleared[CELL_COLORS_N];
+    TurnUndo turn;
+} WidePlacementUndo;
+
+FieldRepr get_field_repr(int size);
+// must be called once at startup, after init_block_masks
+void init_wide_geometries(void);
+// NULL for sizes out of range
+const WideGeometry* get_wide_geometry(int size);
+
+// the size must be in range
+WideState make_wide_state(int size, uint64_t seed);
+FieldCellItem get_wide_field_cell(const WideState* state, int index);
+WideBoard get_wide_occupied_cells(const WideState* state);
+// the same game as a GameState, false unless the field is 8x8
+bool get_narrow_state(const WideState* state, GameState* state_out);
+
+// the cells of the block with its top left corner at cell, false if it
+// doesn't fit into the field there
+bool get_wide_block_cells(const WideGeometry* geometry, const Block* block,
+                          int cell, WideBoard* cells_out);
+// whether the block fits into the free cells at the gui coordinates
+bool wide_block_space_free(const WideState* state, Vector2 coords,
+                           const Block* block);
+Move get_wide_move(const WideState* state, const Block* block, int slot,
+                   Vector2 coords);
+bool get_wide_fuzzy_block_placement(const WideState* state, Vector2 location,
+                                    Vector2 grid_clamped_location,
+                                    Vector2* fuzzy_location_out);
+
+bool wide_move_is_legal(const WideState* state, Move move);
+// apply_move and unmake_move on the wide field
+int wide_apply_move(WideState* state, Move move, WidePlacementUndo* undo_out);
+void wide_unmake_move(WideState* state, const WidePlacementUndo* undo);
+bool wide_is_game_over(const WideState* state);
+
+#endif  // WIDE_H
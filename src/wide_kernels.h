@@ -0,0 +1,70 @@
+// wide field kernels for one word count, included by wide.c once for every
+// FieldRepr with WIDE_WORDS and WIDE_NAME defined. no include guard on
+// purpose
+
+static bool WIDE_NAME(cells_free)(const WideBoard* occupied,
+                                  const WideBoard* cells) {
+    uint64_t overlap = 0;
+    for (int i = 0; i < WIDE_WORDS; ++i) {
+        overlap |= occupied->words[i] & cells->words[i];
+    }
+    return overlap == 0;
+}
+
+static bool WIDE_NAME(covers)(const WideBoard* board, const WideBoard* cells) {
+    uint64_t missing = 0;
+    for (int i = 0; i < WIDE_WORDS; ++i) {
+        missing |= cells->words[i] & ~board->words[i];
+    }
+    return missing == 0;
+}
+
+static int WIDE_NAME(clear_lines)(const WideGeometry* geometry,
+                                  WideBoard* field, WideBoard* cleared_out) {
+    WideBoard occupied = {0};
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        for (int i = 0; i < WIDE_WORDS; ++i) {
+            occupied.words[i] |= field[color].words[i];
+        }
+    }
+
+    // all full lines are found before any of them is cleared, so crossing
+    // lines both count
+    WideBoard cleared = {0};
+    int lines_cleared = 0;
+    for (int line = 0; line < geometry->size; ++line) {
+        const WideBoard* row = &geometry->rows[line];
+        const WideBoard* col = &geometry->cols[line];
+        if (WIDE_NAME(covers)(&occupied, row)) {
+            lines_cleared++;
+            for (int i = 0; i < WIDE_WORDS; ++i) {
+                cleared.words[i] |= row->words[i];
+            }
+        }
+        if (WIDE_NAME(covers)(&occupied, col)) {
+            lines_cleared++;
+            for (int i = 0; i < WIDE_WORDS; ++i) {
+                cleared.words[i] |= col->words[i];
+            }
+        }
+    }
+
+    for (int color = 0; color < CELL_COLORS_N; ++color) {
+        for (int i = 0; i < WIDE_WORDS; ++i) {
+            if (cleared_out) {
+                cleared_out[color].words[i] =
+                    field[color].words[i] & cleared.words[i];
+            }
+            field[color].words[i] &= ~cleared.words[i];
+        }
+    }
+    return lines_cleared;
+}
+
+static const WideKernels WIDE_NAME(kernels) = {
+    .cells_free = WIDE_NAME(cells_free),
+    .clear_lines = WIDE_NAME(clear_lines),
+};
+
+#undef WIDE_WORDS
+#undef WIDE_NAME